@@ -0,0 +1,40 @@
+# Writes a C++ source that embeds every SPIR-V file of SPIRV_DIR as an array
+# of 32-bit words. Word arrays have the alignment vkCreateShaderModule needs,
+# so the embedded code is handed to Vulkan without a copy.
+#
+# cmake -DSPIRV_DIR=<directory> -DOUTPUT=<file> -P embed_shaders.cmake
+
+file(GLOB _spirv_files "${SPIRV_DIR}/*.spv")
+list(SORT _spirv_files)
+
+set(_arrays "")
+set(_entries "")
+foreach(_spirv ${_spirv_files})
+  get_filename_component(_file_name ${_spirv} NAME)
+  string(MAKE_C_IDENTIFIER ${_file_name} _identifier)
+
+  # SPIR-V is a stream of little endian words
+  file(READ ${_spirv} _hex HEX)
+  string(REGEX REPLACE
+         "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])"
+         "0x\\4\\3\\2\\1," _words "${_hex}")
+
+  string(APPEND _arrays
+         "const std::uint32_t ${_identifier}[] = {${_words}};\n\n")
+  string(APPEND _entries
+         "    {\"shaders/${_file_name}\", ${_identifier}, "
+         "sizeof(${_identifier})},\n")
+endforeach()
+
+file(WRITE ${OUTPUT}
+     "// Generated by cmake/embed_shaders.cmake from the compiled shaders\n"
+     "#include \"vlkn_embedded_shaders.hpp\"\n\n"
+     "#include <cstdint>\n#include <iterator>\n\n"
+     "namespace vlkn {\n\nnamespace {\n\n"
+     "${_arrays}"
+     "} // namespace\n\n"
+     "const EmbeddedShader EMBEDDED_SHADERS[] = {\n"
+     "${_entries}"
+     "};\n\n"
+     "const std::size_t EMBEDDED_SHADER_COUNT = std::size(EMBEDDED_SHADERS);\n\n"
+     "} // namespace vlkn\n")
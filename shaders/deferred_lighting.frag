@@ -0,0 +1,46 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput inputAlbedo;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput inputNormal;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput inputDepth;
+
+layout (location = 0) out vec4 outColor;
+
+#include "lighting.glsl"
+
+layout(push_constant) uniform Push {
+  mat4 inverseProjection;
+} push;
+
+void main() {
+  float depth = subpassLoad(inputDepth).r;
+
+  // Nothing was drawn here, keep the clear color
+  if (depth >= 1.0) {
+    discard;
+  }
+
+  vec3 albedo = subpassLoad(inputAlbedo).rgb;
+  vec3 surfaceNormal = normalize(subpassLoad(inputNormal).xyz);
+
+  // Position from the depth buffer, Vulkan clip space has y pointing down
+  // just like gl_FragCoord
+  vec2 screenUV = gl_FragCoord.xy * ubo.clusterParams.xy;
+  vec4 positionView = push.inverseProjection * vec4(screenUV * 2.0 - 1.0, depth, 1.0);
+  positionView /= positionView.w;
+  vec3 fragPosWorld = (ubo.inverseView * vec4(positionView.xyz, 1.0)).xyz;
+
+  vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+  vec3 specularLight = vec3(0.0);
+
+  vec3 cameraPosWorld = ubo.inverseView[3].xyz;
+  vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
+
+  // Same cluster lookup as the forward shaders, the camera looks down -z
+  uvec2 lightRange = clusterLightRange(screenUV, -positionView.z);
+  addPointLights(lightRange, fragPosWorld, surfaceNormal, viewDirection,
+                 diffuseLight, specularLight);
+
+  outColor = vec4((diffuseLight + specularLight) * albedo, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+
+// Must match render_textured.vert bit for bit for the equal depth test
+invariant gl_Position;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+  mat4 projection;
+  mat4 view;
+  mat4 inverseView;
+  vec4 ambientLightColor;
+  uvec4 clusterCounts;
+  vec4 clusterParams;
+  uint lightsNum;
+} ubo;
+
+layout(push_constant) uniform Push {
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+} push;
+
+void main() {
+  vec4 positionWorld =  push.modelMatrix * vec4(position, 1.0);
+  gl_Position = ubo.projection * ubo.view * positionWorld;
+}
@@ -0,0 +1,28 @@
+#version 450
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragPosWorld;
+layout(location = 2) in vec3 fragNormalWorld;
+layout(location = 3) in vec2 fragUV;
+
+layout (location = 0) out vec4 outAlbedo;
+layout (location = 1) out vec4 outNormal;
+
+// Specialization constants, see ShaderConstant
+layout(constant_id = 1) const bool TEXTURED = true;
+layout(constant_id = 2) const uint TEXTURE_COUNT = 8;
+
+layout(set = 0, binding = 1) uniform sampler2D textures[TEXTURE_COUNT];
+
+layout(push_constant) uniform Push {
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+} push;
+
+void main() {
+  uint idx = uint(push.normalMatrix[3][3]);
+
+  vec4 texColor = TEXTURED ? texture(textures[idx], fragUV) : vec4(1.0);
+  outAlbedo = texColor * vec4(fragColor, 1.0);
+  outNormal = vec4(normalize(fragNormalWorld), 0.0);
+}
@@ -0,0 +1,138 @@
+// Clustered point lighting shared by the shaders that shade lit surfaces.
+// Declares the lighting resources of set 0, everything but the textures at
+// binding 1, which only the forward shaders use. Included with
+// GL_GOOGLE_include_directive, not compiled on its own.
+
+// Specialization constants, see ShaderConstant. The light loop has a
+// constant trip count, so small light buckets can be unrolled.
+layout(constant_id = 0) const uint MAX_CLUSTER_LIGHTS = 4096;
+layout(constant_id = 3) const float SPECULAR_EXPONENT = 512.0;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+  mat4 projection;
+  mat4 view;
+  mat4 inverseView;
+  vec4 ambientLightColor;
+  uvec4 clusterCounts;
+  vec4 clusterParams;
+  uint lightsNum;
+} ubo;
+
+// position.w is the range of the light, shadowIndex is -1 for lights
+// without shadows
+struct PointLight {
+  vec4 position;
+  vec4 color;
+  int shadowIndex;
+};
+
+layout(set = 0, binding = 2) readonly buffer PointLights {
+  PointLight pointLights[];
+};
+
+// Offset into lightIndices and light count of every cluster
+layout(set = 0, binding = 3) readonly buffer Clusters {
+  uvec2 clusters[];
+};
+
+layout(set = 0, binding = 4) readonly buffer LightIndices {
+  uint lightIndices[];
+};
+
+// Cube face matrices and atlas rectangles of every shadowed light
+struct ShadowData {
+  mat4 faceMatrices[6];
+  vec4 faceRects[6];
+};
+
+layout(set = 0, binding = 5) readonly buffer Shadows {
+  ShadowData shadows[];
+};
+
+layout(set = 0, binding = 6) uniform sampler2DShadow shadowAtlas;
+
+// Fraction of the light reaching the fragment, looked up in the face of the
+// light's cube the fragment lies in
+float pointShadow(int shadowIndex, vec3 lightPosition, vec3 fragPosWorld) {
+  if (shadowIndex < 0) {
+    return 1.0;
+  }
+
+  vec3 direction = fragPosWorld - lightPosition;
+  vec3 absDirection = abs(direction);
+  int face;
+  if (absDirection.x >= absDirection.y && absDirection.x >= absDirection.z) {
+    face = direction.x > 0.0 ? 0 : 1;
+  } else if (absDirection.y >= absDirection.z) {
+    face = direction.y > 0.0 ? 2 : 3;
+  } else {
+    face = direction.z > 0.0 ? 4 : 5;
+  }
+
+  vec4 rect = shadows[shadowIndex].faceRects[face];
+  // The face has not been rendered yet
+  if (rect.z <= 0.0) {
+    return 1.0;
+  }
+
+  vec4 clip = shadows[shadowIndex].faceMatrices[face] * vec4(fragPosWorld, 1.0);
+  vec3 ndc = clip.xyz / clip.w;
+
+  // Keep the 2x2 filter footprint inside the tile
+  vec2 halfTexel = 0.5 / vec2(textureSize(shadowAtlas, 0));
+  vec2 uv = clamp(rect.xy + (ndc.xy * 0.5 + 0.5) * rect.zw,
+                  rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+  return texture(shadowAtlas, vec3(uv, ndc.z));
+}
+
+// Offset into lightIndices and light count of the cluster holding the
+// fragment. Screen tile from the uv of the fragment in the render extent,
+// log depth slice from its positive view depth.
+uvec2 clusterLightRange(vec2 screenUV, float viewDepth) {
+  float slice = log(viewDepth) * ubo.clusterParams.z + ubo.clusterParams.w;
+  uvec3 cluster = uvec3(
+      vec3(screenUV * vec2(ubo.clusterCounts.xy), max(slice, 0.0)));
+  cluster = min(cluster, ubo.clusterCounts.xyz - 1);
+
+  uint clusterIndex =
+      (cluster.z * ubo.clusterCounts.y + cluster.y) * ubo.clusterCounts.x +
+      cluster.x;
+  return clusters[clusterIndex];
+}
+
+// Adds the Blinn-Phong diffuse and specular light of every light of the
+// cluster
+void addPointLights(uvec2 lightRange, vec3 fragPosWorld, vec3 surfaceNormal,
+                    vec3 viewDirection, inout vec3 diffuseLight,
+                    inout vec3 specularLight) {
+  for (uint i = 0; i < MAX_CLUSTER_LIGHTS; i++) {
+    if (i >= lightRange.y) {
+      break;
+    }
+    PointLight light = pointLights[lightIndices[lightRange.x + i]];
+
+    vec3 directionToLight = light.position.xyz - fragPosWorld;
+    vec3 normDirectionToLight = normalize(directionToLight);
+    float distanceSquared = dot(directionToLight, directionToLight);
+
+    // Inverse square falloff windowed to reach zero at the light's range
+    float rangeRatio = distanceSquared / (light.position.w * light.position.w);
+    float window = clamp(1.0 - rangeRatio * rangeRatio, 0.0, 1.0);
+    float attenuation = window * window / distanceSquared;
+    float cosAngleIncidence = max(dot(surfaceNormal, normDirectionToLight), 0.0);
+
+    float shadow =
+        pointShadow(light.shadowIndex, light.position.xyz, fragPosWorld);
+    vec3 lightContribution =
+        light.color.xyz * light.color.w * attenuation * shadow;
+
+    // diffuse
+    diffuseLight += lightContribution * cosAngleIncidence;
+
+    // specular
+    vec3 halfAngle = normalize(normDirectionToLight + viewDirection);
+    float blinnTerm = clamp(dot(surfaceNormal, halfAngle), 0.0, 1.0);
+    blinnTerm = pow(blinnTerm, SPECULAR_EXPONENT);
+    specularLight += lightContribution * blinnTerm;
+  }
+}
@@ -1,31 +1,33 @@
 #version 450
 
 layout (location = 0) in vec2 fragOffset;
-layout (location = 0) out vec4 outColor;
-
-struct PointLight {
-  vec4 position;
-  vec4 color;
-};
+layout (location = 1) in vec4 fragColor;
+layout (location = 0) out vec4 outAccum;
+layout (location = 1) out float outRevealage;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 projection;
   mat4 view;
   mat4 inverseView;
   vec4 ambientLightColor;
-  PointLight pointLights[16];
+  uvec4 clusterCounts;
+  vec4 clusterParams;
   uint lightsNum;
 } ubo;
 
 layout(set = 0, binding = 1) uniform sampler2D texSampler;
 
-layout (push_constant) uniform Push {
-  vec4 position;
-  vec4 color;
-} push;
-
 const float PI = 3.14;
 
+// Depth weight of weighted blended transparency, nearer fragments dominate
+// the average. The view depth is 1 / gl_FragCoord.w.
+float transparencyWeight(float alpha) {
+  float viewDepth = 1.0 / gl_FragCoord.w;
+  float weight = 10.0 / (1e-5 + pow(viewDepth / 5.0, 2.0) +
+                         pow(viewDepth / 200.0, 6.0));
+  return alpha * clamp(weight, 1e-2, 3e3);
+}
+
 void main() {
   float distance = dot(fragOffset, fragOffset);
 
@@ -35,5 +37,9 @@ void main() {
 
   float distanceCosine = 0.5 * (cos(sqrt(distance) * PI) + 0.5);
 
-  outColor = vec4(push.color.xyz * push.color.w + pow(distanceCosine, 8.0), distanceCosine);
+  vec3 color = fragColor.xyz * fragColor.w + pow(distanceCosine, 8.0);
+  float alpha = distanceCosine;
+
+  outAccum = vec4(color * alpha, alpha) * transparencyWeight(alpha);
+  outRevealage = alpha;
 }
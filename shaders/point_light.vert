@@ -9,32 +9,29 @@ const vec2 OFFSETS[6] = vec2[](
   vec2(1.0, 1.0)
 );
 
-layout (location = 0) out vec2 fragOffset;
+// Per instance, position.w is the billboard radius
+layout (location = 0) in vec4 position;
+layout (location = 1) in vec4 color;
 
-struct PointLight {
-  vec4 position;
-  vec4 color;
-};
+layout (location = 0) out vec2 fragOffset;
+layout (location = 1) out vec4 fragColor;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 projection;
   mat4 view;
   mat4 inverseView;
   vec4 ambientLightColor;
-  PointLight pointLights[16];
+  uvec4 clusterCounts;
+  vec4 clusterParams;
   uint lightsNum;
 } ubo;
 
-layout (push_constant) uniform Push {
-  vec4 position;
-  vec4 color;
-} push;
-
 void main() {
   fragOffset = OFFSETS[gl_VertexIndex];
+  fragColor = color;
+
+  vec4 lightPosInCamera = ubo.view * vec4(position.xyz, 1.0);
+  vec4 positionInCamera = lightPosInCamera + position.w * vec4(fragOffset, 0.0, 0.0);
 
-  vec4 lightPosInCamera = ubo.view * vec4(push.position.xyz, 1.0);
-  vec4 positionInCamera = lightPosInCamera + push.position.w * vec4(fragOffset, 0.0, 0.0);
-    
   gl_Position = ubo.projection * positionInCamera;
 }
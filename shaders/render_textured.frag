@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec3 fragPosWorld;
@@ -7,21 +8,13 @@ layout(location = 3) in vec2 fragUV;
 
 layout (location = 0) out vec4 outColor;
 
-struct PointLight {
-  vec4 position;
-  vec4 color;
-};
+#include "lighting.glsl"
 
-layout(set = 0, binding = 0) uniform GlobalUbo {
-  mat4 projection;
-  mat4 view;
-  mat4 inverseView;
-  vec4 ambientLightColor;
-  PointLight pointLights[16];
-  uint lightsNum;
-} ubo;
+// Specialization constants, see ShaderConstant
+layout(constant_id = 1) const bool TEXTURED = true;
+layout(constant_id = 2) const uint TEXTURE_COUNT = 8;
 
-layout(set = 0, binding = 1) uniform sampler2D textures[8];
+layout(set = 0, binding = 1) uniform sampler2D textures[TEXTURE_COUNT];
 
 layout(push_constant) uniform Push {
   mat4 modelMatrix;
@@ -36,29 +29,15 @@ void main() {
   vec3 cameraPosWorld = ubo.inverseView[3].xyz;
   vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
 
-  for (uint i = 0; i < ubo.lightsNum; i++) {
-    PointLight light = ubo.pointLights[i];
-
-    vec3 directionToLight = light.position.xyz - fragPosWorld;
-    vec3 normDirectionToLight = normalize(directionToLight);
-    float attenuation = 1.0 / dot(directionToLight, directionToLight);
-    float cosAngleIncidence = max(dot(surfaceNormal, normDirectionToLight), 0.0);
-
-    vec3 lightContribution = light.color.xyz * light.color.w * attenuation;
-
-    // diffuse
-    diffuseLight += lightContribution * cosAngleIncidence;
-
-    // specular
-    vec3 halfAngle = normalize(normDirectionToLight + viewDirection);
-    float blinnTerm = clamp(dot(surfaceNormal, halfAngle), 0.0, 1.0);
-    blinnTerm = pow(blinnTerm, 512.0);
-    specularLight += lightContribution * blinnTerm;
-  }
+  // The view depth is 1 / gl_FragCoord.w for a perspective projection
+  uvec2 lightRange = clusterLightRange(gl_FragCoord.xy * ubo.clusterParams.xy,
+                                       1.0 / gl_FragCoord.w);
+  addPointLights(lightRange, fragPosWorld, surfaceNormal, viewDirection,
+                 diffuseLight, specularLight);
 
   uint idx = uint(push.normalMatrix[3][3]);
 
-  vec4 texColor = texture(textures[idx], fragUV);
+  vec4 texColor = TEXTURED ? texture(textures[idx], fragUV) : vec4(1.0);
   vec4 shadingColor = vec4((diffuseLight + specularLight) * fragColor, 1.0);
 
   outColor = vec4(shadingColor * texColor);
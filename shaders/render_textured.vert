@@ -10,17 +10,16 @@ layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
 layout(location = 3) out vec2 fragUV;
 
-struct PointLight {
-  vec4 position;
-  vec4 color;
-};
+// Must match depth_prepass.vert bit for bit for the equal depth test
+invariant gl_Position;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 projection;
   mat4 view;
   mat4 inverseView;
   vec4 ambientLightColor;
-  PointLight pointLights[16];
+  uvec4 clusterCounts;
+  vec4 clusterParams;
   uint lightsNum;
 } ubo;
 
@@ -0,0 +1,57 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragPosWorld;
+layout(location = 2) in vec3 fragNormalWorld;
+layout(location = 3) in vec2 fragUV;
+
+layout (location = 0) out vec4 outAccum;
+layout (location = 1) out float outRevealage;
+
+#include "lighting.glsl"
+
+// Specialization constants, see ShaderConstant
+layout(constant_id = 1) const bool TEXTURED = true;
+layout(constant_id = 2) const uint TEXTURE_COUNT = 8;
+
+layout(set = 0, binding = 1) uniform sampler2D textures[TEXTURE_COUNT];
+
+layout(push_constant) uniform Push {
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+} push;
+
+// Depth weight of weighted blended transparency, nearer fragments dominate
+// the average. The view depth is 1 / gl_FragCoord.w.
+float transparencyWeight(float alpha) {
+  float viewDepth = 1.0 / gl_FragCoord.w;
+  float weight = 10.0 / (1e-5 + pow(viewDepth / 5.0, 2.0) +
+                         pow(viewDepth / 200.0, 6.0));
+  return alpha * clamp(weight, 1e-2, 3e3);
+}
+
+void main() {
+  vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+  vec3 specularLight = vec3(0.0);
+  vec3 surfaceNormal = normalize(fragNormalWorld);
+
+  vec3 cameraPosWorld = ubo.inverseView[3].xyz;
+  vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
+
+  // The view depth is 1 / gl_FragCoord.w for a perspective projection
+  uvec2 lightRange = clusterLightRange(gl_FragCoord.xy * ubo.clusterParams.xy,
+                                       1.0 / gl_FragCoord.w);
+  addPointLights(lightRange, fragPosWorld, surfaceNormal, viewDirection,
+                 diffuseLight, specularLight);
+
+  uint idx = uint(push.normalMatrix[3][3]);
+  float opacity = push.normalMatrix[3][2];
+
+  vec4 texColor = TEXTURED ? texture(textures[idx], fragUV) : vec4(1.0);
+  vec3 color = (diffuseLight + specularLight) * fragColor * texColor.rgb;
+  float alpha = clamp(texColor.a * opacity, 0.0, 1.0);
+
+  outAccum = vec4(color * alpha, alpha) * transparencyWeight(alpha);
+  outRevealage = alpha;
+}
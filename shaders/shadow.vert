@@ -0,0 +1,12 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+
+layout(push_constant) uniform Push {
+  mat4 faceViewProjection;
+  mat4 modelMatrix;
+} push;
+
+void main() {
+  gl_Position = push.faceViewProjection * push.modelMatrix * vec4(position, 1.0);
+}
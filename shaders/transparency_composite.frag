@@ -0,0 +1,27 @@
+#version 450
+
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput inputAccum;
+layout(input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput inputRevealage;
+
+layout (location = 0) out vec4 outColor;
+
+// Resolves weighted blended transparency over the shaded image, which is
+// blended with src alpha / one minus src alpha
+void main() {
+  float revealage = subpassLoad(inputRevealage).r;
+
+  // Nothing transparent covers the pixel
+  if (revealage >= 1.0) {
+    discard;
+  }
+
+  vec4 accum = subpassLoad(inputAccum);
+  // Keeps the average finite where the fp16 sums overflowed
+  if (isinf(max(max(abs(accum.r), abs(accum.g)), abs(accum.b)))) {
+    accum.rgb = vec3(accum.a);
+  }
+
+  vec3 averageColor = accum.rgb / max(accum.a, 1e-5);
+
+  outColor = vec4(averageColor, 1.0 - revealage);
+}
@@ -0,0 +1,49 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform sampler2D sceneImage;
+
+layout(push_constant) uniform Push {
+  // Scene image uv of the bottom right corner of the rendered region
+  vec2 uvScale;
+  vec2 texelSize;
+  float sharpness;
+} push;
+
+layout (location = 0) out vec4 outColor;
+
+// Only the top left region of the scene image was rendered, samples are
+// kept half a texel inside of it so the filter never reads stale pixels
+vec3 sampleScene(vec2 uv) {
+  vec2 halfTexel = 0.5 * push.texelSize;
+  return texture(sceneImage, clamp(uv, halfTexel, push.uvScale - halfTexel)).rgb;
+}
+
+// Bilinear upscale, followed by an unsharp mask over the cross neighbours
+// when sharpness is above zero. The sharpened colour is clamped to the
+// neighbourhood so edges do not ring.
+void main() {
+  vec2 screenUv = gl_FragCoord.xy * push.texelSize;
+  vec2 uv = screenUv * push.uvScale;
+
+  vec3 center = sampleScene(uv);
+
+  if (push.sharpness <= 0.0) {
+    outColor = vec4(center, 1.0);
+    return;
+  }
+
+  // Neighbours one rendered texel away
+  vec2 step = push.texelSize;
+  vec3 left = sampleScene(uv - vec2(step.x, 0.0));
+  vec3 right = sampleScene(uv + vec2(step.x, 0.0));
+  vec3 up = sampleScene(uv - vec2(0.0, step.y));
+  vec3 down = sampleScene(uv + vec2(0.0, step.y));
+
+  vec3 blurred = (left + right + up + down) * 0.25;
+  vec3 sharpened = center + (center - blurred) * push.sharpness;
+
+  vec3 minimum = min(center, min(min(left, right), min(up, down)));
+  vec3 maximum = max(center, max(max(left, right), max(up, down)));
+
+  outColor = vec4(clamp(sharpened, minimum, maximum), 1.0);
+}
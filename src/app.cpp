@@ -4,15 +4,19 @@
 // local
 #include "keyboard_movement_controller.hpp"
 #include "mouse_movement_controller.hpp"
+#include "systems/deferred_lighting_system.hpp"
 #include "systems/imgui_system.hpp"
 #include "systems/point_light_system.hpp"
 #include "systems/render_system.hpp"
+#include "systems/transparency_composite_system.hpp"
+#include "systems/upscale_system.hpp"
 #include "vlkn_buffer.hpp"
 #include "vlkn_camera.hpp"
+#include "vlkn_components.hpp"
 #include "vlkn_device.hpp"
-#include "vlkn_game_object.hpp"
 #include "vlkn_image.hpp"
 #include "vlkn_model.hpp"
+#include "vlkn_pipeline.hpp"
 #include "vlkn_renderer.hpp"
 
 // libs
@@ -30,6 +34,9 @@
 #include <vulkan/vulkan_core.h>
 
 // std
+#include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -40,26 +47,35 @@
 
 namespace vlkn {
 
-constexpr std::size_t TEXTURE_COUNT = 8;
+constexpr std::size_t POINT_LIGHT_COUNT = 16;
+constexpr std::size_t ANIMATED_LIGHT_COUNT = 64;
 
-App::App() {
-  globalPool = VlknDescriptorPool::Builder(vlknDevice)
-                   .setMaxSets(VlknSwapChain::MAX_FRAMES_IN_FLIGHT)
-                   .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                VlknSwapChain::MAX_FRAMES_IN_FLIGHT)
-                   .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                TEXTURE_COUNT * 2)
-                   .build();
+App::App(RenderPath renderPath, VkSampleCountFlagBits sampleCount,
+         bool dynamicRendering, uint32_t framesInFlight, bool lowLatency)
+    : vlknRenderer{vlknWindow,  vlknDevice,       renderPath,
+                   sampleCount, dynamicRendering, framesInFlight} {
+  framePacer.setLowLatency(lowLatency);
 
-  gameObjects.reserve(16);
-  loadGameObjects();
+  const uint32_t frameCount = vlknRenderer.getFramesInFlight();
+
+  globalPool =
+      VlknDescriptorPool::Builder(vlknDevice)
+          .setMaxSets(frameCount)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frameCount)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                       (TEXTURE_COUNT + 1) * frameCount)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * frameCount)
+          .build();
+
+  loadEntities();
 }
 
 App::~App() {}
 
 void App::run() {
-  std::vector<std::unique_ptr<VlknBuffer>> uboBuffers(
-      VlknSwapChain::MAX_FRAMES_IN_FLIGHT);
+  const std::uint32_t framesInFlight = vlknRenderer.getFramesInFlight();
+
+  std::vector<std::unique_ptr<VlknBuffer>> uboBuffers(framesInFlight);
 
   for (std::size_t i = 0; i < uboBuffers.size(); i++) {
     uboBuffers[i] = std::make_unique<VlknBuffer>(
@@ -89,13 +105,27 @@ void App::run() {
                       VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
           .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                       VK_SHADER_STAGE_FRAGMENT_BIT, TEXTURE_COUNT)
+          .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
           .build();
 
-  std::vector<VkDescriptorSet> globalDescriptorSets(
-      VlknSwapChain::MAX_FRAMES_IN_FLIGHT);
+  std::vector<VkDescriptorSet> globalDescriptorSets(framesInFlight);
 
   for (std::size_t i = 0; i < globalDescriptorSets.size(); i++) {
     auto bufferInfo = uboBuffers[i]->descriptorInfo();
+    auto lightsInfo = lightClusters.lightsDescriptorInfo(i);
+    auto clustersInfo = lightClusters.clustersDescriptorInfo(i);
+    auto lightIndicesInfo = lightClusters.lightIndicesDescriptorInfo(i);
+    auto shadowDataInfo = shadowAtlas.shadowDataDescriptorInfo(i);
+    auto shadowAtlasInfo = shadowAtlas.atlasDescriptorInfo();
 
     VlknDescriptorWriter descriptorWriter =
         VlknDescriptorWriter(*globalSetLayout, *globalPool);
@@ -105,28 +135,93 @@ void App::run() {
     descriptorWriter.writeImageArray(1, descriptorImageInfos.data(),
                                      descriptorImageInfos.size());
 
+    descriptorWriter.writeBuffer(2, &lightsInfo);
+    descriptorWriter.writeBuffer(3, &clustersInfo);
+    descriptorWriter.writeBuffer(4, &lightIndicesInfo);
+    descriptorWriter.writeBuffer(5, &shadowDataInfo);
+    descriptorWriter.writeImage(6, &shadowAtlasInfo);
+
     if (!descriptorWriter.build(globalDescriptorSets[i])) {
       throw std::runtime_error("failed to build the descriptor sets");
     }
   }
 
-  RenderSystem renderSystem{vlknDevice, vlknRenderer.getSwapChainRenderPass(),
-                            globalSetLayout->getDescriptorSetLayout()};
+  const bool deferred = vlknRenderer.getRenderPath() == RenderPath::Deferred;
+  const std::uint32_t lightingSubpass = vlknRenderer.getLightingSubpass();
+  const std::uint32_t transparentSubpass =
+      vlknRenderer.getTransparentSubpass();
+  const std::uint32_t compositeSubpass = vlknRenderer.getCompositeSubpass();
+
+  const VkSampleCountFlagBits sampleCount = vlknRenderer.getSampleCount();
+
+  // The render and point light systems build their pipelines on the
+  // pipeline builder's threads while the other systems are created here
+  const auto pipelinesStart = std::chrono::steady_clock::now();
+
+  RenderSystem renderSystem{vlknDevice,
+                            pipelineBuilder,
+                            vlknRenderer.getSwapChainRenderPass(),
+                            globalSetLayout->getDescriptorSetLayout(),
+                            vlknRenderer.getRenderPath(),
+                            transparentSubpass,
+                            sampleCount};
 
   PointLightSystem pointLightSystem{vlknDevice,
+                                    pipelineBuilder,
                                     vlknRenderer.getSwapChainRenderPass(),
-                                    globalSetLayout->getDescriptorSetLayout()};
+                                    transparentSubpass,
+                                    globalSetLayout->getDescriptorSetLayout(),
+                                    sampleCount,
+                                    framesInFlight};
+
+  TransparencyCompositeSystem transparencyCompositeSystem{vlknDevice,
+                                                          vlknRenderer};
+
+  UpscaleSystem upscaleSystem{vlknDevice, vlknRenderer};
+
+  // Drawn at native resolution after the upscale. ImGui keeps one set of
+  // buffers per image count and needs at least two.
+  const std::uint32_t imguiImageCount = std::max(framesInFlight, 2u);
+  ImGuiSystem imguiSystem{vlknDevice,
+                          vlknRenderer.getPresentRenderPass(),
+                          vlknRenderer.getSwapChainImageFormat(),
+                          0,
+                          VK_SAMPLE_COUNT_1_BIT,
+                          imguiImageCount,
+                          imguiImageCount};
+
+  std::unique_ptr<DeferredLightingSystem> deferredLightingSystem{};
+  if (deferred) {
+    deferredLightingSystem = std::make_unique<DeferredLightingSystem>(
+        vlknDevice, vlknRenderer, globalSetLayout->getDescriptorSetLayout());
+  }
 
-  ImGuiSystem imguiSystem{vlknDevice, vlknRenderer.getSwapChainRenderPass(),
-                          VlknSwapChain::MAX_FRAMES_IN_FLIGHT,
-                          VlknSwapChain::MAX_FRAMES_IN_FLIGHT};
+  pipelineBuilder.waitIdle();
+  const std::chrono::duration<double, std::milli> pipelinesTime =
+      std::chrono::steady_clock::now() - pipelinesStart;
+
+  // Every pipeline exists by now. Comparing a cold start with a warm one
+  // shows what the pipeline cache saves, the driver time summed over all
+  // threads against the wall time what building in parallel saves.
+  std::cout << "pipelines: " << VlknPipeline::getCreatedCount()
+            << " created in " << pipelinesTime.count() << " ms on "
+            << pipelineBuilder.getThreadCount() << " threads, "
+            << VlknPipeline::getCreationTime() << " ms in the driver, "
+            << vlknDevice.getLoadedPipelineCacheSize()
+            << " bytes of pipeline cache loaded" << std::endl;
+  std::cout << "shader modules: "
+            << vlknDevice.shaderModuleCache().getCreatedCount()
+            << " created, " << vlknDevice.shaderModuleCache().getReusedCount()
+            << " reused" << std::endl;
 
   VlknCamera camera{};
-  VlknGameObject viewerObject = VlknGameObject::createGameObject();
-  viewerObject.transform.translation = {0.0f, -1.0f, -2.0f};
+  std::vector<PointLight> pointLights{};
+  std::vector<Entity> pointLightEntities{};
+  TransformComponent viewerTransform{};
+  viewerTransform.setTranslation({0.0f, -1.0f, -2.0f});
 
-  KeyboardMovementController keyboardController{viewerObject};
-  MouseMovementController mouseController{viewerObject};
+  KeyboardMovementController keyboardController{viewerTransform};
+  MouseMovementController mouseController{viewerTransform};
 
   float lastTime = static_cast<float>(glfwGetTime());
   float nowTime = 0.0f;
@@ -136,7 +231,14 @@ void App::run() {
 
   float aspectRatio = vlknRenderer.getAspectRatio();
 
+  imguiSystem.setLowLatency(framePacer.isLowLatency());
+
   while (!vlknWindow.shouldClose() && !keyboardController.shouldClose()) {
+    // In low latency mode the wait for the frame happens here rather than
+    // in beginFrame, so the input below is as fresh as possible
+    framePacer.setLowLatency(imguiSystem.isLowLatencyEnabled());
+    framePacer.waitForFrame();
+
     glfwPollEvents();
 
     nowTime = static_cast<float>(glfwGetTime());
@@ -154,47 +256,217 @@ void App::run() {
 
     mouseController.lookAround();
 
-    keyboardController.lookAt(gameObjects);
+    keyboardController.lookAt(registry);
 
-    camera.setViewYXZ(viewerObject.transform.translation,
-                      viewerObject.transform.rotation);
+    camera.setViewYXZ(viewerTransform.getTranslation(),
+                      viewerTransform.getRotation());
 
     camera.setPerspectiveProjection(mouseController.getFov(), aspectRatio, 0.1f,
                                     100.0f);
 
+    transformBatch.update(registry);
+    transformHierarchy.update(registry);
+
     if (auto commandBuffer = vlknRenderer.beginFrame()) {
       std::uint32_t frameIndex = vlknRenderer.getFrameIndex();
+
+      // Only frames that are drawn are culled
+      rasterizeOccluders(camera);
+
+      // Animations are evaluated at the predicted present time in low
+      // latency mode, so they match the moment the frame is seen
+      framePacer.beginFrame(nowTime);
+      const float frameTime =
+          framePacer.isLowLatency()
+              ? static_cast<float>(framePacer.getPredictedPresentTime())
+              : nowTime;
+
       FrameInfo frameInfo{
           .frameIndex = frameIndex,
           .frameDelta = deltaTime,
-          .frameTime = nowTime,
+          .frameTime = frameTime,
           .commandBuffer = commandBuffer,
           .camera = camera,
           .globalDescriptorSet = globalDescriptorSets[frameIndex],
-          .gameObjects = gameObjects,
+          .registry = registry,
+          .sceneBvh = sceneBvh,
+          .occlusionCuller = occlusionCuller,
+          .renderQueue = renderQueue,
       };
 
+      // The scale is picked before anything depends on the render extent
+      resolutionController.setEnabled(imguiSystem.isDynamicResolutionEnabled());
+      resolutionController.setBounds(
+          imguiSystem.getMinRenderScale(),
+          VlknResolutionController::DEFAULT_MAX_SCALE);
+      resolutionController.setTargetTime(imguiSystem.getTargetGpuTime());
+      resolutionController.beginFrame(commandBuffer, frameIndex);
+      vlknRenderer.setRenderScale(resolutionController.getScale());
+      const VkExtent2D renderExtent = vlknRenderer.getRenderExtent();
+
       // update stage
       GlobalUbo ubo{};
       ubo.projection = camera.getProjection();
       ubo.view = camera.getView();
       ubo.inverseView = camera.getInverseView();
 
-      pointLightSystem.update(frameInfo, imguiSystem.getPointLightColor(), ubo);
+      pointLightSystem.update(frameInfo, imguiSystem.getPointLightColor(),
+                              pointLights, pointLightEntities);
+
+      // Lights were just moved, so bounds are synced after the update stage.
+      // Shadow casters are found in the synced tree.
+      sceneBvh.update(registry);
+
+      shadowAtlas.update(frameIndex, camera, renderExtent, registry, sceneBvh,
+                         pointLights, pointLightEntities);
+      // GPU animated lights are appended after the shadow atlas, which only
+      // handles lights with a position on the CPU
+      lightAnimator.update(registry, imguiSystem.getPointLightColor(),
+                           pointLights);
+      lightClusters.update(frameIndex, camera, renderExtent, pointLights, ubo);
 
       uboBuffers[frameIndex]->writeToBuffer(&ubo);
       uboBuffers[frameIndex]->flush();
 
-      imguiSystem.update(viewerObject.transform.rotation);
+      imguiSystem.update(viewerTransform.getRotation(),
+                         resolutionController.getScale(),
+                         resolutionController.getGpuTime(),
+                         framePacer.getLatency(),
+                         framePacer.measuresPresent());
 
       // render stage
-      vlknRenderer.beginSwapChainRenderPass(commandBuffer);
-
+      renderQueue.clear();
+      renderSystem.setDepthPrepass(imguiSystem.isDepthPrepassEnabled());
+      renderSystem.setMaxClusterLights(lightClusters.getMaxClusterLights());
       renderSystem.renderGameObjects(frameInfo);
       pointLightSystem.render(frameInfo, imguiSystem.getPointLightColor());
-      imguiSystem.render(frameInfo);
+      pointLightSystem.renderInstances(
+          frameInfo, lightAnimator.getBillboardBuffer(frameIndex),
+          lightAnimator.getLightCount());
+      renderQueue.sort();
+
+      // Opaque packets are drawn in the geometry subpass, everything from
+      // the first transparent packet on is accumulated in the transparent
+      // subpass
+      const std::size_t geometryCount =
+          renderQueue.findPass(DrawPass::Transparent);
+      const std::size_t transparentCount = renderQueue.size() - geometryCount;
+      auto recordLighting = [&](VkCommandBuffer lightingBuffer) {
+        FrameInfo lightingInfo = frameInfo;
+        lightingInfo.commandBuffer = lightingBuffer;
+        deferredLightingSystem->render(lightingInfo);
+      };
+      auto recordTransparent = [&](VkCommandBuffer transparentBuffer) {
+        renderQueue.submit(transparentBuffer, geometryCount, transparentCount);
+      };
+      auto recordComposite = [&](VkCommandBuffer compositeBuffer) {
+        FrameInfo compositeInfo = frameInfo;
+        compositeInfo.commandBuffer = compositeBuffer;
+        transparencyCompositeSystem.render(compositeInfo);
+      };
+
+      auto recordScene = [&](VkCommandBuffer sceneBuffer) {
+        if (imguiSystem.isParallelRecordingEnabled()) {
+          commandRecorder.beginFrame();
+          commandRecorder.recordQueue(renderQueue, 0, geometryCount);
+          if (deferred) {
+            commandRecorder.setSubpass(lightingSubpass);
+            commandRecorder.recordOverlay(recordLighting);
+          }
+          commandRecorder.setSubpass(transparentSubpass);
+          commandRecorder.recordOverlay(recordTransparent);
+          commandRecorder.setSubpass(compositeSubpass);
+          commandRecorder.recordOverlay(recordComposite);
+
+          vlknRenderer.beginSwapChainRenderPass(
+              sceneBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+          commandRecorder.executeCommands(sceneBuffer,
+                                          VlknSwapChain::GEOMETRY_SUBPASS);
+          for (std::uint32_t subpass = VlknSwapChain::GEOMETRY_SUBPASS + 1;
+               subpass <= compositeSubpass; subpass++) {
+            vlknRenderer.nextSwapChainSubpass(
+                sceneBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            commandRecorder.executeCommands(sceneBuffer, subpass);
+          }
+        } else {
+          vlknRenderer.beginSwapChainRenderPass(sceneBuffer);
+
+          renderQueue.submit(sceneBuffer, 0, geometryCount);
+          if (deferred) {
+            vlknRenderer.nextSwapChainSubpass(sceneBuffer);
+            recordLighting(sceneBuffer);
+          }
+          vlknRenderer.nextSwapChainSubpass(sceneBuffer);
+          recordTransparent(sceneBuffer);
+          vlknRenderer.nextSwapChainSubpass(sceneBuffer);
+          recordComposite(sceneBuffer);
+        }
+
+        vlknRenderer.endSwapChainRenderPass(sceneBuffer);
+        resolutionController.endFrame(sceneBuffer, frameIndex);
+      };
+
+      // The frame's resources and the passes that use them, the render graph
+      // places the barriers and layout transitions between them
+      const int imageIndex = static_cast<int>(vlknRenderer.getImageIndex());
+      const RenderGraphBuffer lightBuffer = renderGraph.importBuffer(
+          lightClusters.lightsDescriptorInfo(frameIndex),
+          RenderGraphUsage::None);
+      const RenderGraphBuffer billboardBuffer = renderGraph.importBuffer(
+          VkDescriptorBufferInfo{lightAnimator.getBillboardBuffer(frameIndex),
+                                 0, VK_WHOLE_SIZE},
+          RenderGraphUsage::None);
+      const RenderGraphImage shadowImage = renderGraph.importImage(
+          shadowAtlas.getAtlasImage(), VK_IMAGE_ASPECT_DEPTH_BIT,
+          RenderGraphUsage::FragmentDepthSampled,
+          RenderGraphUsage::FragmentDepthSampled);
+      const RenderGraphImage sceneImage = renderGraph.importImage(
+          vlknRenderer.getSceneImage(imageIndex), VK_IMAGE_ASPECT_COLOR_BIT,
+          RenderGraphUsage::FragmentSampled, RenderGraphUsage::None, false);
+      const RenderGraphImage swapChainImage = renderGraph.importImage(
+          vlknRenderer.getSwapChainImage(imageIndex),
+          VK_IMAGE_ASPECT_COLOR_BIT, RenderGraphUsage::SwapChainAcquire,
+          RenderGraphUsage::Present, false);
+
+      // Animated lights and stale shadow faces are written before the scene
+      // reads them
+      if (lightAnimator.getLightCount() > 0) {
+        renderGraph.addPass()
+            .write(lightBuffer, RenderGraphUsage::ComputeStorage)
+            .write(billboardBuffer, RenderGraphUsage::ComputeStorage)
+            .setRecord([&](VkCommandBuffer passBuffer) {
+              lightAnimator.record(passBuffer, frameIndex, frameTime);
+            });
+      }
+      if (shadowAtlas.hasFaceUpdates()) {
+        renderGraph.addPass()
+            .write(shadowImage, RenderGraphUsage::DepthAttachment)
+            .setRecord([&](VkCommandBuffer passBuffer) {
+              shadowAtlas.record(passBuffer, registry);
+            });
+      }
+      renderGraph.addPass()
+          .read(lightBuffer, RenderGraphUsage::FragmentStorage)
+          .read(billboardBuffer, RenderGraphUsage::VertexAttribute)
+          .read(shadowImage, RenderGraphUsage::FragmentDepthSampled)
+          .write(sceneImage, RenderGraphUsage::ColorAttachment)
+          .setRecord(recordScene);
+      // The scene is upscaled into the swap chain image and the UI drawn over
+      // it at native resolution
+      renderGraph.addPass()
+          .read(sceneImage, RenderGraphUsage::FragmentSampled)
+          .write(swapChainImage, RenderGraphUsage::ColorAttachment)
+          .setRecord([&](VkCommandBuffer passBuffer) {
+            FrameInfo presentInfo = frameInfo;
+            presentInfo.commandBuffer = passBuffer;
+            vlknRenderer.beginPresentRenderPass(passBuffer);
+            upscaleSystem.render(presentInfo, imguiSystem.getSharpness());
+            imguiSystem.render(presentInfo);
+            vlknRenderer.endPresentRenderPass(passBuffer);
+          });
+
+      renderGraph.execute(commandBuffer, frameIndex);
 
-      vlknRenderer.endSwapChainRenderPass(commandBuffer);
       vlknRenderer.endFrame();
     }
   }
@@ -202,7 +474,22 @@ void App::run() {
   vkDeviceWaitIdle(vlknDevice.device());
 }
 
-void App::loadGameObjects() {
+void App::rasterizeOccluders(const VlknCamera &camera) {
+  occlusionCuller.beginFrame(camera.getProjection() * camera.getView());
+
+  registry.view<TransformComponent, ModelComponent, OccluderComponent>().each(
+      [&](Entity, TransformComponent &transform,
+          ModelComponent &modelComponent, OccluderComponent &) {
+        if (modelComponent.model != nullptr) {
+          occlusionCuller.addOccluder(
+              modelComponent.model->getOccluderMesh(), transform.mat4());
+        }
+      });
+
+  occlusionCuller.rasterizeOccluders();
+}
+
+void App::loadEntities() {
   std::shared_ptr<VlknModel> flatVaseModel =
       VlknModel::createModelFromFile(vlknDevice, "models/flat_vase.obj");
 
@@ -212,27 +499,37 @@ void App::loadGameObjects() {
   std::shared_ptr<VlknModel> floorModel =
       VlknModel::createModelFromFile(vlknDevice, "models/quad.obj");
 
-  VlknGameObject flatVase = VlknGameObject::createGameObject();
-  flatVase.model = flatVaseModel;
-  flatVase.transform.translation = {-1.0f, 0.0f, 0.0f};
-  flatVase.transform.scale = glm::vec3(3.0f, 2.0f, 3.0f);
-
-  gameObjects.emplace(flatVase.getId(), std::move(flatVase));
-
-  VlknGameObject smoothVase = VlknGameObject::createGameObject();
-  smoothVase.model = smoothVaseModel;
-  smoothVase.transform.translation = {1.0f, 0.0f, 0.0f};
-  smoothVase.transform.scale = glm::vec3(4.0f);
-
-  gameObjects.emplace(smoothVase.getId(), std::move(smoothVase));
-
-  VlknGameObject floor = VlknGameObject::createGameObject();
-  floor.model = floorModel;
-  floor.transform.translation = {0.0f, 0.0f, 0.0f};
-  floor.transform.scale = glm::vec3(16.0f, 1.0f, 16.0f);
-  floor.imgIdx = 1;
-
-  gameObjects.emplace(floor.getId(), std::move(floor));
+  Entity flatVase = registry.create();
+  TransformComponent &flatVaseTransform =
+      registry.emplace<TransformComponent>(flatVase);
+  flatVaseTransform.setTranslation({-1.0f, 0.0f, 0.0f});
+  flatVaseTransform.setScale(glm::vec3(3.0f, 2.0f, 3.0f));
+  registry.emplace<ModelComponent>(flatVase, flatVaseModel);
+  registry.emplace<OccluderComponent>(flatVase);
+
+  Entity smoothVase = registry.create();
+  TransformComponent &smoothVaseTransform =
+      registry.emplace<TransformComponent>(smoothVase);
+  smoothVaseTransform.setTranslation({1.0f, 0.0f, 0.0f});
+  smoothVaseTransform.setScale(glm::vec3(4.0f));
+  registry.emplace<ModelComponent>(smoothVase, smoothVaseModel);
+  registry.emplace<OccluderComponent>(smoothVase);
+
+  // A see-through vase in front of the other two, not an occluder
+  Entity glassVase = registry.create();
+  TransformComponent &glassVaseTransform =
+      registry.emplace<TransformComponent>(glassVase);
+  glassVaseTransform.setTranslation({0.0f, 0.0f, -1.5f});
+  glassVaseTransform.setScale(glm::vec3(3.0f));
+  registry.emplace<ModelComponent>(glassVase, smoothVaseModel, 0, 0.35f);
+
+  Entity floor = registry.create();
+  TransformComponent &floorTransform =
+      registry.emplace<TransformComponent>(floor);
+  floorTransform.setTranslation({0.0f, 0.0f, 0.0f});
+  floorTransform.setScale(glm::vec3(16.0f, 1.0f, 16.0f));
+  registry.emplace<ModelComponent>(floor, floorModel, 1);
+  registry.emplace<OccluderComponent>(floor);
 
   std::array<glm::vec3, 7> rainbowColors = {
       glm::vec3(1.0f, 0.0f, 0.0f), // Red
@@ -244,27 +541,55 @@ void App::loadGameObjects() {
       glm::vec3(0.9f, 0.0f, 0.9f)  // Violet
   };
 
-  for (std::size_t i = 0; i < MAX_LIGHTS; i++) {
-    VlknGameObject pointLight = VlknGameObject::makePointLight(0.1f);
-
+  for (std::size_t i = 0; i < POINT_LIGHT_COUNT; i++) {
     // Calculate the index for the rainbow colors
-    float t = static_cast<float>(i) / (MAX_LIGHTS - 1); // Normalize i to [0, 1]
+    float t = static_cast<float>(i) /
+              (POINT_LIGHT_COUNT - 1); // Normalize i to [0, 1]
     std::size_t colorIndex =
         static_cast<std::size_t>(t * (rainbowColors.size() - 1));
     std::size_t nextColorIndex = (colorIndex + 1) % rainbowColors.size();
 
     // Interpolate between the two colors
     float blendFactor = (t * (rainbowColors.size() - 1)) - colorIndex;
-    pointLight.color = glm::mix(rainbowColors[colorIndex],
-                                rainbowColors[nextColorIndex], blendFactor);
+    glm::vec3 color = glm::mix(rainbowColors[colorIndex],
+                               rainbowColors[nextColorIndex], blendFactor);
 
     glm::mat4 rotateLight =
-        glm::rotate(glm::mat4(1.0f), i * glm::two_pi<float>() / MAX_LIGHTS,
+        glm::rotate(glm::mat4(1.0f),
+                    i * glm::two_pi<float>() / POINT_LIGHT_COUNT,
                     {0.0f, -1.0f, 0.0f});
-    pointLight.transform.translation =
-        glm::vec3(rotateLight * glm::vec4(-1.0f, -2.0f, -1.0f, 1.0f));
 
-    gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+    // The billboard radius is stored in the x scale
+    Entity pointLight = registry.create();
+    TransformComponent &transform =
+        registry.emplace<TransformComponent>(pointLight);
+    transform.setTranslation(
+        glm::vec3(rotateLight * glm::vec4(-1.0f, -2.0f, -1.0f, 1.0f)));
+    transform.setScale({0.1f, 1.0f, 1.0f});
+    registry.emplace<PointLightComponent>(pointLight, 1.0f, color);
+  }
+
+  // A ring of small lights animated by the compute pass, without transforms
+  for (std::size_t i = 0; i < ANIMATED_LIGHT_COUNT; i++) {
+    const float t = static_cast<float>(i) / ANIMATED_LIGHT_COUNT;
+    const std::size_t colorIndex =
+        static_cast<std::size_t>(t * rainbowColors.size());
+
+    Entity light = registry.create();
+    registry.emplace<PointLightComponent>(light, 0.3f,
+                                          rainbowColors[colorIndex]);
+
+    LightAnimationComponent &animation =
+        registry.emplace<LightAnimationComponent>(light);
+    animation.orbitCenter = {0.0f, -0.5f, 0.0f};
+    animation.orbitOffset = {3.0f + 2.0f * glm::fract(t * 7.0f), 0.0f, 0.0f};
+    animation.orbitSpeed = 0.2f + 0.3f * glm::fract(t * 3.0f);
+    animation.phase = t * glm::two_pi<float>();
+    animation.waveAmplitude = 0.1f;
+    animation.waveFrequency = 2.0f;
+    animation.curvePeriod = 4.0f;
+    animation.intensityCurve = {1.0f, 0.8f, 0.4f, 0.2f, 0.4f, 0.8f, 1.0f, 1.0f};
+    animation.billboardRadius = 0.05f;
   }
 }
 
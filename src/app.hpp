@@ -1,10 +1,25 @@
 #pragma once
 
 // local
+#include "vlkn_bvh.hpp"
+#include "vlkn_command_recorder.hpp"
+#include "vlkn_components.hpp"
 #include "vlkn_descriptors.hpp"
 #include "vlkn_device.hpp"
-#include "vlkn_game_object.hpp"
+#include "vlkn_frame_pacer.hpp"
+#include "vlkn_light_animator.hpp"
+#include "vlkn_light_clusters.hpp"
+#include "vlkn_occlusion_culler.hpp"
+#include "vlkn_pipeline_builder.hpp"
+#include "vlkn_registry.hpp"
+#include "vlkn_render_graph.hpp"
+#include "vlkn_render_queue.hpp"
 #include "vlkn_renderer.hpp"
+#include "vlkn_resolution_controller.hpp"
+#include "vlkn_shadow_atlas.hpp"
+#include "vlkn_thread_pool.hpp"
+#include "vlkn_transform_batch.hpp"
+#include "vlkn_transform_hierarchy.hpp"
 #include "vlkn_window.hpp"
 
 // libs
@@ -24,7 +39,16 @@ public:
   static constexpr uint32_t WIDTH = 800;
   static constexpr uint32_t HEIGH = 800;
 
-  App();
+  // dynamicRendering draws the present and shadow passes with
+  // vkCmdBeginRendering when the device supports it. framesInFlight trades
+  // input latency for GPU utilisation, see VlknRenderer. lowLatency starts in
+  // the low latency pacing mode of VlknFramePacer, which can be toggled at
+  // runtime.
+  App(RenderPath renderPath = RenderPath::Forward,
+      VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT,
+      bool dynamicRendering = false,
+      uint32_t framesInFlight = VlknSwapChain::DEFAULT_FRAMES_IN_FLIGHT,
+      bool lowLatency = false);
   ~App();
 
   App(const App &) = delete;
@@ -33,15 +57,35 @@ public:
   void run();
 
 private:
-  void loadGameObjects();
+  void loadEntities();
+  void rasterizeOccluders(const VlknCamera &camera);
 
   VlknWindow vlknWindow{WIDTH, HEIGH, "vlkn"};
   VlknDevice vlknDevice{vlknWindow};
-  VlknRenderer vlknRenderer{vlknWindow, vlknDevice};
+  VlknRenderer vlknRenderer;
+  VlknFramePacer framePacer{vlknDevice, vlknRenderer};
 
   std::unique_ptr<VlknDescriptorPool> globalPool{};
 
-  VlknGameObject::Map gameObjects;
+  VlknThreadPool threadPool{};
+  VlknPipelineBuilder pipelineBuilder{};
+  VlknOcclusionCuller occlusionCuller{threadPool};
+  VlknRenderQueue renderQueue{};
+  // Every per-frame resource is sized by the renderer's frames in flight
+  VlknLightClusters lightClusters{vlknDevice,
+                                  vlknRenderer.getFramesInFlight()};
+  VlknLightAnimator lightAnimator{vlknDevice, vlknRenderer, lightClusters};
+  VlknShadowAtlas shadowAtlas{vlknDevice, vlknRenderer.getFramesInFlight(),
+                              vlknRenderer.usesDynamicRendering()};
+  VlknResolutionController resolutionController{
+      vlknDevice, vlknRenderer.getFramesInFlight()};
+  VlknRenderGraph renderGraph{vlknDevice, vlknRenderer.getFramesInFlight()};
+  VlknCommandRecorder commandRecorder{vlknDevice, vlknRenderer, threadPool};
+
+  VlknTransformBatch transformBatch{};
+  VlknTransformHierarchy transformHierarchy{};
+  VlknRegistry registry{};
+  VlknBvh sceneBvh{};
 };
 
 } // namespace vlkn
@@ -47,11 +47,11 @@ void KeyboardMovementController::keyboardCallback(GLFWwindow *const window,
 
 void KeyboardMovementController::move(const float step) {
   // Get the forward vector based on the current rotation
-  const glm::vec3 forwardDir = glm::rotate(viewerObject.transform.rotation,
-                                           glm::vec3(0.0f, 0.0f, -1.0f));
+  const glm::vec3 forwardDir = glm::rotate(
+      viewerTransform.getRotation(), glm::vec3(0.0f, 0.0f, -1.0f));
 
   // Get the up vector based on the current rotation
-  const glm::vec3 upDir = glm::rotate(viewerObject.transform.rotation,
+  const glm::vec3 upDir = glm::rotate(viewerTransform.getRotation(),
                                       glm::vec3(0.0f, -1.0f, 0.0f));
 
   // Right vector is the cross product of up and forward
@@ -93,32 +93,30 @@ void KeyboardMovementController::move(const float step) {
                      forwardDir); // Rotate around local Z-axis
 
   // Combine the viwer object rotation quaternion with the roll rotation
-  // quaternion
-  viewerObject.transform.rotation =
-      rollRotation * viewerObject.transform.rotation;
-
-  // Normalize the quaternion to avoid drift
-  viewerObject.transform.rotation =
-      glm::normalize(viewerObject.transform.rotation);
+  // quaternion and normalize it to avoid drift
+  viewerTransform.setRotation(
+      glm::normalize(rollRotation * viewerTransform.getRotation()));
 
   if (nonZeroVector(moveDir)) {
-    viewerObject.transform.translation +=
-        speed * step *
-        glm::normalize(moveDir); // Normalize the move vector to avoid sqrt(2)
-                                 // times faster movement when going diagonally
+    // Normalize the move vector to avoid sqrt(2) times faster movement when
+    // going diagonally
+    viewerTransform.setTranslation(
+        viewerTransform.getTranslation() +
+        speed * step * glm::normalize(moveDir));
   }
 }
 
 // lock camera on game objects
 // see docs/look_at_rotation_vector
-void KeyboardMovementController::lookAt(
-    const VlknGameObject::Map &gameObjects) {
+void KeyboardMovementController::lookAt(const VlknRegistry &registry) {
   glm::vec3 direction{};
   for (auto i = GLFW_KEY_1; i < GLFW_KEY_9; i++) {
-    const VlknGameObject::id_t id = i - GLFW_KEY_1;
-    if (keys[i] && gameObjects.find(id) != gameObjects.end()) {
-      direction = glm::normalize(gameObjects.at(id).transform.translation -
-                                 viewerObject.transform.translation);
+    const Entity entity = registry.entityAt(i - GLFW_KEY_1);
+    const TransformComponent *transform =
+        registry.tryGet<TransformComponent>(entity);
+    if (keys[i] && transform != nullptr) {
+      direction = glm::normalize(transform->getTranslation() -
+                                 viewerTransform.getTranslation());
       break;
     }
   }
@@ -131,7 +129,7 @@ void KeyboardMovementController::lookAt(
     glm::quat rotation = glm::quatLookAt(direction, upDir);
 
     // Set the viewer's rotation to the calculated quaternion
-    viewerObject.transform.rotation = glm::normalize(rotation);
+    viewerTransform.setRotation(glm::normalize(rotation));
   }
 }
 
@@ -1,7 +1,8 @@
 #pragma once
 
 // local
-#include "vlkn_game_object.hpp"
+#include "vlkn_components.hpp"
+#include "vlkn_registry.hpp"
 #include "vlkn_window.hpp"
 
 // std
@@ -27,14 +28,14 @@ public:
     closeApp = GLFW_KEY_ESCAPE,
   };
 
-  KeyboardMovementController(VlknGameObject &viewerObject)
-      : viewerObject(viewerObject) {}
+  KeyboardMovementController(TransformComponent &viewerTransform)
+      : viewerTransform(viewerTransform) {}
 
   void move(const float step);
 
   // lock camera on game objects
   // see docs/look_at_rotation_vector
-  void lookAt(const VlknGameObject::Map &gameObjects);
+  void lookAt(const VlknRegistry &registry);
 
   static void keyboardCallback(GLFWwindow *const window, const int key,
                                const int scancode, const int action,
@@ -45,7 +46,7 @@ public:
   static bool shouldClose() { return keys[closeApp]; }
 
 private:
-  VlknGameObject &viewerObject;
+  TransformComponent &viewerTransform;
   static std::unordered_map<uint32_t, bool> keys;
   static constexpr float speed{3.0f};
 };
@@ -1,11 +1,39 @@
 #include "app.hpp"
 
+#include <cstdint>
 #include <cstdlib>
 #include <exception>
 #include <iostream>
+#include <string_view>
 
-int main() {
-  vlkn::App app{};
+int main(int argc, char **argv) {
+  vlkn::RenderPath renderPath = vlkn::RenderPath::Forward;
+  VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
+  bool dynamicRendering = false;
+  std::uint32_t framesInFlight = vlkn::VlknSwapChain::DEFAULT_FRAMES_IN_FLIGHT;
+  bool lowLatency = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::string_view(argv[i]) == "--deferred") {
+      renderPath = vlkn::RenderPath::Deferred;
+    } else if (std::string_view(argv[i]) == "--msaa" && i + 1 < argc) {
+      // Clamped to the device limits by the swap chain
+      sampleCount = static_cast<VkSampleCountFlagBits>(
+          std::strtoul(argv[++i], nullptr, 10));
+    } else if (std::string_view(argv[i]) == "--dynamic-rendering") {
+      // Falls back to a render pass without Vulkan 1.3
+      dynamicRendering = true;
+    } else if (std::string_view(argv[i]) == "--frames-in-flight" &&
+               i + 1 < argc) {
+      // Clamped to 1 to 4 by the renderer
+      framesInFlight = static_cast<std::uint32_t>(
+          std::strtoul(argv[++i], nullptr, 10));
+    } else if (std::string_view(argv[i]) == "--low-latency") {
+      lowLatency = true;
+    }
+  }
+
+  vlkn::App app{renderPath, sampleCount, dynamicRendering, framesInFlight,
+                lowLatency};
 
   try {
     app.run();
@@ -17,11 +17,11 @@ namespace vlkn {
 void MouseMovementController::lookAround() {
   if (mouseOffsetX != 0.0f || mouseOffsetY != 0.0f) {
     // Get the forward vector based on the current rotation
-    const glm::vec3 forwardDir = glm::rotate(viewerObject.transform.rotation,
-                                             glm::vec3(0.0f, 0.0f, -1.0f));
+    const glm::vec3 forwardDir = glm::rotate(
+        viewerTransform.getRotation(), glm::vec3(0.0f, 0.0f, -1.0f));
 
     // Get the up vector based on the current rotation
-    const glm::vec3 upDir = glm::rotate(viewerObject.transform.rotation,
+    const glm::vec3 upDir = glm::rotate(viewerTransform.getRotation(),
                                         glm::vec3(0.0f, -1.0f, 0.0f));
 
     // Calculate the right vector based on the forward direction
@@ -35,13 +35,11 @@ void MouseMovementController::lookAround() {
         glm::angleAxis(mouseSensitivity * mouseOffsetY,
                        rightDir); // Rotate around local X-axis
 
-    // Combine the rotations (yaw first, then pitch)
-    viewerObject.transform.rotation =
-        yawRotation * pitchRotation * viewerObject.transform.rotation;
-
-    // Normalize the quaternion to avoid drift
-    viewerObject.transform.rotation =
-        glm::normalize(viewerObject.transform.rotation);
+    // Combine the rotations (yaw first, then pitch) and normalize the
+    // quaternion to avoid drift
+    viewerTransform.setRotation(
+        glm::normalize(yawRotation * pitchRotation *
+                       viewerTransform.getRotation()));
 
     // Reset mouse offsets
     mouseOffsetX = 0.0f;
@@ -1,15 +1,15 @@
 #pragma once
 
 // local
-#include "vlkn_game_object.hpp"
+#include "vlkn_components.hpp"
 #include "vlkn_window.hpp"
 
 namespace vlkn {
 
 class MouseMovementController {
 public:
-  MouseMovementController(VlknGameObject &viewerObject)
-      : viewerObject(viewerObject) {}
+  MouseMovementController(TransformComponent &viewerTransform)
+      : viewerTransform(viewerTransform) {}
 
   void lookAround();
 
@@ -26,7 +26,7 @@ public:
   }
 
 private:
-  VlknGameObject &viewerObject;
+  TransformComponent &viewerTransform;
 
   static float mouseSensitivity;
   static float scrollSensitivity;
@@ -0,0 +1,161 @@
+// header
+#include "deferred_lighting_system.hpp"
+
+// std
+#include <array>
+#include <cassert>
+#include <utility>
+
+namespace vlkn {
+
+struct DeferredLightingPushConstants {
+  glm::mat4 inverseProjection{1.0f};
+};
+
+DeferredLightingSystem::DeferredLightingSystem(
+    VlknDevice &device, VlknRenderer &renderer,
+    VkDescriptorSetLayout globalSetLayout)
+    : vlknDevice(device), vlknRenderer(renderer) {
+  createInputSetLayout();
+  createPipelineLayout(globalSetLayout);
+  createPipeline(vlknRenderer.getSwapChainRenderPass(),
+                 vlknRenderer.getLightingSubpass());
+}
+
+DeferredLightingSystem::~DeferredLightingSystem() {
+  vkDestroyPipelineLayout(vlknDevice.device(), pipelineLayout, nullptr);
+}
+
+void DeferredLightingSystem::createInputSetLayout() {
+  // Albedo, normal and depth, in the order of the lighting subpass' input
+  // attachments
+  inputSetLayout =
+      VlknDescriptorSetLayout::Builder(vlknDevice)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(2, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .build();
+}
+
+void DeferredLightingSystem::createPipelineLayout(
+    VkDescriptorSetLayout globalSetLayout) {
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(DeferredLightingPushConstants);
+
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+      globalSetLayout, inputSetLayout->getDescriptorSetLayout()};
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount =
+      static_cast<std::uint32_t>(descriptorSetLayouts.size());
+  pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(vlknDevice.device(), &pipelineLayoutInfo, nullptr,
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout");
+  }
+}
+
+void DeferredLightingSystem::createPipeline(VkRenderPass renderPass,
+                                            std::uint32_t subpass) {
+  assert(pipelineLayout != nullptr &&
+         "Cannot create pipeline before pipeline layout");
+
+  PipelineConfigInfo pipelineConfig{};
+  VlknPipeline::defaultPipelineConfigInfo(pipelineConfig);
+  pipelineConfig.bindingDescriptions.clear();
+  pipelineConfig.attributeDescriptions.clear();
+  // Covers every pixel once, background pixels are discarded by the shader
+  pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+  pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+  pipelineConfig.renderPass = renderPass;
+  pipelineConfig.subpass = subpass;
+  pipelineConfig.pipelineLayout = pipelineLayout;
+  // The G-buffer holds no per material shininess
+  VlknPipeline::addSpecializationConstant(
+      pipelineConfig,
+      static_cast<std::uint32_t>(ShaderConstant::SpecularExponent),
+      SPECULAR_EXPONENT);
+  vlknPipeline = std::make_unique<VlknPipeline>(
+      vlknDevice, "shaders/deferred_lighting.vert.spv",
+      "shaders/deferred_lighting.frag.spv", pipelineConfig);
+}
+
+void DeferredLightingSystem::writeInputSets() {
+  const std::uint32_t imageCount =
+      static_cast<std::uint32_t>(vlknRenderer.getSwapChainImageCount());
+
+  // Frames in flight may still bind the old sets, their pool is destroyed
+  // once those frames finished
+  if (inputPool != nullptr) {
+    vlknRenderer.deferDestruction(std::move(inputPool));
+  }
+  inputPool =
+      VlknDescriptorPool::Builder(vlknDevice)
+          .setMaxSets(imageCount)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3 * imageCount)
+          .build();
+
+  inputSets.resize(imageCount);
+
+  for (std::uint32_t i = 0; i < imageCount; i++) {
+    std::array<VkDescriptorImageInfo, 3> imageInfos{};
+    imageInfos[0].imageView = vlknRenderer.getAlbedoImageView(i);
+    imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[1].imageView = vlknRenderer.getNormalImageView(i);
+    imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[2].imageView = vlknRenderer.getDepthImageView(i);
+    imageInfos[2].imageLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    VlknDescriptorWriter descriptorWriter =
+        VlknDescriptorWriter(*inputSetLayout, *inputPool);
+
+    for (std::uint32_t binding = 0; binding < imageInfos.size(); binding++) {
+      descriptorWriter.writeImage(binding, &imageInfos[binding]);
+    }
+
+    if (!descriptorWriter.build(inputSets[i])) {
+      throw std::runtime_error("failed to build the input attachment sets");
+    }
+  }
+
+  inputSetsGeneration = vlknRenderer.getSwapChainGeneration();
+  inputSetsWritten = true;
+}
+
+void DeferredLightingSystem::render(const FrameInfo &frameInfo) {
+  if (!inputSetsWritten ||
+      inputSetsGeneration != vlknRenderer.getSwapChainGeneration()) {
+    writeInputSets();
+  }
+
+  vlknPipeline->bind(frameInfo.commandBuffer);
+
+  std::array<VkDescriptorSet, 2> descriptorSets = {
+      frameInfo.globalDescriptorSet, inputSets[vlknRenderer.getImageIndex()]};
+  vkCmdBindDescriptorSets(
+      frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+      0, static_cast<std::uint32_t>(descriptorSets.size()),
+      descriptorSets.data(), 0, nullptr);
+
+  DeferredLightingPushConstants push{};
+  push.inverseProjection = glm::inverse(frameInfo.camera.getProjection());
+  vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout,
+                     VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                     sizeof(DeferredLightingPushConstants), &push);
+
+  // Fullscreen triangle generated from the vertex index
+  vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+}
+
+} // namespace vlkn
@@ -0,0 +1,59 @@
+#pragma once
+
+// local
+#include "vlkn_descriptors.hpp"
+#include "vlkn_device.hpp"
+#include "vlkn_frame_info.hpp"
+#include "vlkn_pipeline.hpp"
+#include "vlkn_renderer.hpp"
+
+// libs
+// Vulkan
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vlkn {
+
+// Lighting subpass of the deferred render path. A fullscreen triangle reads
+// albedo, normal and depth of its own pixel as input attachments and shades
+// it with the lights of its cluster, so every pixel is lit exactly once no
+// matter how much geometry overlapped it.
+class DeferredLightingSystem {
+public:
+  DeferredLightingSystem(VlknDevice &device, VlknRenderer &renderer,
+                         VkDescriptorSetLayout globalSetLayout);
+  ~DeferredLightingSystem();
+
+  DeferredLightingSystem(const DeferredLightingSystem &) = delete;
+  DeferredLightingSystem &operator=(const DeferredLightingSystem &) = delete;
+
+  // Records the lighting draw, must be called in the lighting subpass
+  void render(const FrameInfo &frameInfo);
+
+private:
+  void createInputSetLayout();
+  void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+  void createPipeline(VkRenderPass renderPass, std::uint32_t subpass);
+  // The G-buffer is recreated with the swap chain, so the input attachment
+  // sets are rewritten whenever the swap chain generation changes
+  void writeInputSets();
+
+  VlknDevice &vlknDevice;
+  VlknRenderer &vlknRenderer;
+
+  std::unique_ptr<VlknDescriptorSetLayout> inputSetLayout;
+  std::unique_ptr<VlknDescriptorPool> inputPool;
+  // One set per swap chain image
+  std::vector<VkDescriptorSet> inputSets{};
+  std::uint32_t inputSetsGeneration = 0;
+  bool inputSetsWritten = false;
+
+  std::unique_ptr<VlknPipeline> vlknPipeline;
+  VkPipelineLayout pipelineLayout;
+};
+
+} // namespace vlkn
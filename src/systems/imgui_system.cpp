@@ -7,8 +7,10 @@
 namespace vlkn {
 
 ImGuiSystem::ImGuiSystem(VlknDevice &device, VkRenderPass renderPass,
+                         VkFormat colorFormat, std::uint32_t subpass,
+                         VkSampleCountFlagBits sampleCount,
                          std::uint32_t minImageCount, std::uint32_t imageCount)
-    : vlknDevice(device) {
+    : vlknDevice(device), colorAttachmentFormat(colorFormat) {
 
   descriptorPool =
       VlknDescriptorPool::Builder(vlknDevice)
@@ -31,13 +33,21 @@ ImGuiSystem::ImGuiSystem(VlknDevice &device, VkRenderPass renderPass,
   init_info.Device = vlknDevice.device();
   init_info.QueueFamily = vlknDevice.findPhysicalQueueFamilies().graphicsFamily;
   init_info.Queue = vlknDevice.graphicsQueue();
-  init_info.PipelineCache = VK_NULL_HANDLE;
+  init_info.PipelineCache = vlknDevice.pipelineCache();
   init_info.DescriptorPool = descriptorPool->getDescriptorPool();
   init_info.RenderPass = renderPass;
-  init_info.Subpass = 0;
+  init_info.Subpass = subpass;
+  if (renderPass == VK_NULL_HANDLE) {
+    init_info.UseDynamicRendering = true;
+    init_info.PipelineRenderingCreateInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    init_info.PipelineRenderingCreateInfo.colorAttachmentCount = 1;
+    init_info.PipelineRenderingCreateInfo.pColorAttachmentFormats =
+        &colorAttachmentFormat;
+  }
   init_info.MinImageCount = minImageCount;
   init_info.ImageCount = imageCount;
-  init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+  init_info.MSAASamples = sampleCount;
   init_info.Allocator = VK_NULL_HANDLE;
   init_info.CheckVkResultFn = nullptr;
   ImGui_ImplVulkan_Init(&init_info);
@@ -52,7 +62,8 @@ ImGuiSystem::~ImGuiSystem() {
   ImGui::DestroyContext();
 }
 
-void ImGuiSystem::update(const glm::quat &rotation) {
+void ImGuiSystem::update(const glm::quat &rotation, float renderScale,
+                         float gpuTime, float latency, bool latencyToPresent) {
   ImGui_ImplVulkan_NewFrame();
   ImGui_ImplGlfw_NewFrame();
   ImGui::NewFrame();
@@ -67,6 +78,21 @@ void ImGuiSystem::update(const glm::quat &rotation) {
               glm::degrees(eulerAngles.x), glm::degrees(eulerAngles.y),
               glm::degrees(eulerAngles.z));
 
+  ImGui::Text(latencyToPresent ? "Input to present latency %.2f ms"
+                               : "Input to GPU completion latency %.2f ms",
+              latency);
+  ImGui::Checkbox("Low latency pacing", &lowLatency);
+
+  ImGui::Checkbox("Parallel command recording", &parallelRecording);
+  ImGui::Checkbox("Depth pre-pass", &depthPrepass);
+
+  ImGui::Text("Render scale %.2f, scene GPU time %.3f ms", renderScale,
+              gpuTime);
+  ImGui::Checkbox("Dynamic resolution", &dynamicResolution);
+  ImGui::SliderFloat("Minimum render scale", &minRenderScale, 0.25f, 1.0f);
+  ImGui::SliderFloat("Scene GPU budget (ms)", &targetGpuTime, 1.0f, 33.0f);
+  ImGui::SliderFloat("Upscale sharpness", &sharpness, 0.0f, 1.0f);
+
   ImGui::ColorPicker4("Point light color", (float *)&pointLightColor);
   ImGui::End();
 }
@@ -2,10 +2,10 @@
 
 // local
 #include "vlkn_camera.hpp"
+#include "vlkn_components.hpp"
 #include "vlkn_descriptors.hpp"
 #include "vlkn_device.hpp"
 #include "vlkn_frame_info.hpp"
-#include "vlkn_game_object.hpp"
 #include "vlkn_pipeline.hpp"
 
 // libs
@@ -26,17 +26,33 @@ namespace vlkn {
 
 class ImGuiSystem {
 public:
-  ImGuiSystem(VlknDevice &device, VkRenderPass renderPass,
+  // A null render pass draws with dynamic rendering into a colour attachment
+  // of colorFormat, which is ignored otherwise
+  ImGuiSystem(VlknDevice &device, VkRenderPass renderPass, VkFormat colorFormat,
+              std::uint32_t subpass, VkSampleCountFlagBits sampleCount,
               std::uint32_t minImageCount, std::uint32_t imageCount);
   ~ImGuiSystem();
 
   ImGuiSystem(const ImGuiSystem &) = delete;
   ImGuiSystem &operator=(const ImGuiSystem &) = delete;
 
-  void update(const glm::quat &rotation);
+  // renderScale, gpuTime and latency are only displayed. latencyToPresent
+  // tells whether the latency ends at the present or at the end of the GPU
+  // work.
+  void update(const glm::quat &rotation, float renderScale, float gpuTime,
+              float latency, bool latencyToPresent);
 
   void render(const FrameInfo &frameInfo) const;
 
+  bool isParallelRecordingEnabled() const { return parallelRecording; }
+  bool isDepthPrepassEnabled() const { return depthPrepass; }
+  bool isDynamicResolutionEnabled() const { return dynamicResolution; }
+  float getMinRenderScale() const { return minRenderScale; }
+  float getTargetGpuTime() const { return targetGpuTime; }
+  float getSharpness() const { return sharpness; }
+  bool isLowLatencyEnabled() const { return lowLatency; }
+  void setLowLatency(bool enable) { lowLatency = enable; }
+
   glm::vec4 getPointLightColor() const {
     return glm::vec4(pointLightColor.x, pointLightColor.y, pointLightColor.z,
                      pointLightColor.w);
@@ -45,7 +61,16 @@ public:
 private:
   VlknDevice &vlknDevice;
   std::unique_ptr<VlknDescriptorPool> descriptorPool;
+  // Referenced by the init info while the backend creates its pipeline
+  VkFormat colorAttachmentFormat;
   ImVec4 pointLightColor{};
+  bool parallelRecording = true;
+  bool depthPrepass = false;
+  bool dynamicResolution = true;
+  float minRenderScale = 0.5f;
+  float targetGpuTime = 12.0f;
+  float sharpness = 0.5f;
+  bool lowLatency = false;
   ImGuiIO *imguiIO;
 };
 
@@ -1,38 +1,40 @@
 // header
 #include "point_light_system.hpp"
 
+// local
+#include "vlkn_swap_chain.hpp"
+
 // std
 #include <algorithm>
 #include <cassert>
-#include <map>
+#include <cstddef>
 
 namespace vlkn {
 
-struct PointLightPushConstants {
-  glm::vec4 position{};
-  glm::vec4 color{};
-};
-
-PointLightSystem::PointLightSystem(VlknDevice &device, VkRenderPass renderPass,
-                                   VkDescriptorSetLayout globalSetLayout)
+PointLightSystem::PointLightSystem(VlknDevice &device,
+                                   VlknPipelineBuilder &pipelineBuilder,
+                                   VkRenderPass renderPass,
+                                   std::uint32_t subpass,
+                                   VkDescriptorSetLayout globalSetLayout,
+                                   VkSampleCountFlagBits sampleCount,
+                                   std::uint32_t framesInFlight)
     : vlknDevice(device) {
   createPipelineLayout(globalSetLayout);
-  createPipeline(renderPass);
+  vlknPipeline = pipelineBuilder.build([=, this]() {
+    return createPipeline(renderPass, subpass, sampleCount);
+  });
+  createInstanceBuffers(framesInFlight);
 }
 
 PointLightSystem::~PointLightSystem() {
+  // A build still running uses the pipeline layout
+  vlknPipeline = VlknAsyncPipeline{};
   vkDestroyPipelineLayout(vlknDevice.device(), pipelineLayout, nullptr);
 }
 
 void PointLightSystem::createPipelineLayout(
     VkDescriptorSetLayout globalSetLayout) {
 
-  VkPushConstantRange pushConstantRange{};
-  pushConstantRange.stageFlags =
-      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-  pushConstantRange.offset = 0;
-  pushConstantRange.size = sizeof(PointLightPushConstants);
-
   std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
@@ -40,8 +42,8 @@ void PointLightSystem::createPipelineLayout(
   pipelineLayoutInfo.setLayoutCount =
       static_cast<std::uint32_t>(descriptorSetLayouts.size());
   pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-  pipelineLayoutInfo.pushConstantRangeCount = 1;
-  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  pipelineLayoutInfo.pushConstantRangeCount = 0;
+  pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
   if (vkCreatePipelineLayout(vlknDevice.device(), &pipelineLayoutInfo, nullptr,
                              &pipelineLayout) != VK_SUCCESS) {
@@ -49,90 +51,132 @@ void PointLightSystem::createPipelineLayout(
   }
 }
 
-void PointLightSystem::createPipeline(VkRenderPass renderPass) {
+std::unique_ptr<VlknPipeline>
+PointLightSystem::createPipeline(VkRenderPass renderPass,
+                                 std::uint32_t subpass,
+                                 VkSampleCountFlagBits sampleCount) {
   assert(pipelineLayout != nullptr &&
          "Cannot create pipeline before pipeline layout");
 
   PipelineConfigInfo pipelineConfig{};
   VlknPipeline::defaultPipelineConfigInfo(pipelineConfig);
-  VlknPipeline::enableAlphaBlending(pipelineConfig);
-  pipelineConfig.bindingDescriptions.clear();
-  pipelineConfig.attributeDescriptions.clear();
+  VlknPipeline::enableWeightedBlending(pipelineConfig);
+  pipelineConfig.multisampleInfo.rasterizationSamples = sampleCount;
+  // Corners come from the vertex index, the light from the instance
+  pipelineConfig.bindingDescriptions = {
+      {0, sizeof(BillboardInstance), VK_VERTEX_INPUT_RATE_INSTANCE}};
+  pipelineConfig.attributeDescriptions = {
+      {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT,
+       offsetof(BillboardInstance, position)},
+      {1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(BillboardInstance, color)},
+  };
   pipelineConfig.renderPass = renderPass;
+  pipelineConfig.subpass = subpass;
   pipelineConfig.pipelineLayout = pipelineLayout;
-  vlknPipeline = std::make_unique<VlknPipeline>(
+  return std::make_unique<VlknPipeline>(
       vlknDevice, "shaders/point_light.vert.spv",
       "shaders/point_light.frag.spv", pipelineConfig);
 }
 
+void PointLightSystem::createInstanceBuffers(std::uint32_t framesInFlight) {
+  instanceBuffers.resize(framesInFlight);
+  for (auto &buffer : instanceBuffers) {
+    buffer = std::make_unique<VlknBuffer>(
+        vlknDevice, sizeof(BillboardInstance), MAX_LIGHTS,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    buffer->map();
+  }
+}
+
 void PointLightSystem::update(const FrameInfo &frameInfo,
-                              const glm::vec4 pointLightColor, GlobalUbo &ubo) {
+                              const glm::vec4 pointLightColor,
+                              std::vector<PointLight> &lights,
+                              std::vector<Entity> &lightEntities) {
   glm::mat4 rotateLight =
       glm::rotate(glm::mat4(1.0f), frameInfo.frameDelta, {0.0f, -1.0f, 0.0f});
   float lightIntensity = 0.5f * glm::sin(frameInfo.frameTime) + 1.0f;
 
-  std::size_t lightIndex = 0;
-
-  for (auto &kv : frameInfo.gameObjects) {
-    auto &obj = kv.second;
-    if (obj.pointLight != nullptr) {
-      assert(lightIndex < MAX_LIGHTS && "Exceeded maximum point light count");
+  lights.clear();
+  lightEntities.clear();
 
-      obj.transform.translation =
-          glm::vec3(rotateLight * glm::vec4(obj.transform.translation, 1.0f));
+  frameInfo.registry.view<TransformComponent, PointLightComponent>().each(
+      [&](Entity entity, TransformComponent &transform,
+          PointLightComponent &pointLight) {
+        transform.setTranslation(glm::vec3(
+            rotateLight * glm::vec4(transform.getTranslation(), 1.0f)));
 
-      obj.pointLight->lightIntensity = lightIntensity;
+        pointLight.lightIntensity = lightIntensity;
 
-      ubo.pointLights[lightIndex].position =
-          glm::vec4(obj.transform.translation, 1.0f);
+        const glm::vec4 color =
+            glm::vec4(pointLight.color + glm::vec3(pointLightColor),
+                      pointLight.lightIntensity + pointLightColor.w);
 
-      ubo.pointLights[lightIndex].color =
-          glm::vec4(obj.color + glm::vec3(pointLightColor),
-                    obj.pointLight->lightIntensity + pointLightColor.w);
+        // Distance at which the brightest channel falls below LIGHT_CUTOFF
+        const float brightness = std::max({color.r, color.g, color.b, 0.0f}) *
+                                 std::max(color.w, 0.0f);
+        const float range = glm::sqrt(brightness / LIGHT_CUTOFF);
 
-      lightIndex++;
-    }
-  }
-
-  ubo.lightsNum = lightIndex;
+        lights.push_back(
+            PointLight{glm::vec4(transform.getTranslation(), range), color});
+        lightEntities.push_back(entity);
+      });
 }
 
 void PointLightSystem::render(const FrameInfo &frameInfo,
                               const glm::vec4 pointLightColor) {
-  std::map<float, VlknGameObject::id_t> sorted;
+  const Frustum frustum = Frustum::fromViewProjection(
+      frameInfo.camera.getProjection() * frameInfo.camera.getView());
+
+  // Written straight into the mapped buffer
+  VlknBuffer &instanceBuffer = *instanceBuffers[frameInfo.frameIndex];
+  auto *mapped =
+      static_cast<BillboardInstance *>(instanceBuffer.getMappedMemory());
+  std::uint32_t instanceCount = 0;
+
+  frameInfo.sceneBvh.queryFrustum(frustum, [&](Entity entity) {
+    const PointLightComponent *pointLight =
+        frameInfo.registry.tryGet<PointLightComponent>(entity);
+    if (pointLight == nullptr || instanceCount >= MAX_LIGHTS) {
+      return;
+    }
 
-  const glm::vec3 cameraPosition = frameInfo.camera.getPosition();
+    const TransformComponent &transform =
+        frameInfo.registry.get<TransformComponent>(entity);
 
-  for (auto &kv : frameInfo.gameObjects) {
-    auto &obj = kv.second;
-    if (obj.pointLight != nullptr) {
-      glm::vec3 offset = cameraPosition - obj.transform.translation;
-      float distanceSquared = glm::dot(offset, offset);
-      sorted[distanceSquared] = obj.getId();
-    }
-  }
+    BillboardInstance &instance = mapped[instanceCount++];
+    instance.position =
+        glm::vec4(transform.getTranslation(), transform.getScale().x);
+    instance.color = glm::vec4(pointLight->color + glm::vec3(pointLightColor),
+                               pointLight->lightIntensity + pointLightColor.w);
+  });
 
-  vlknPipeline->bind(frameInfo.commandBuffer);
+  if (instanceCount == 0) {
+    return;
+  }
 
-  vkCmdBindDescriptorSets(frameInfo.commandBuffer,
-                          VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
-                          &frameInfo.globalDescriptorSet, 0, nullptr);
+  instanceBuffer.flush();
+  renderInstances(frameInfo, instanceBuffer.getBuffer(), instanceCount);
+}
 
-  for (auto it = sorted.rbegin(); it != sorted.rend(); it++) {
-    auto &obj = frameInfo.gameObjects.at(it->second);
+void PointLightSystem::renderInstances(const FrameInfo &frameInfo,
+                                       VkBuffer instanceBuffer,
+                                       std::uint32_t instanceCount) {
+  if (instanceCount == 0) {
+    return;
+  }
 
-    PointLightPushConstants push{};
-    push.position = glm::vec4(obj.transform.translation, obj.transform.scale.x);
-    push.color = glm::vec4(obj.color + glm::vec3(pointLightColor),
-                           obj.pointLight->lightIntensity + pointLightColor.w);
+  VlknPipeline &pipeline = vlknPipeline.wait();
 
-    vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout,
-                       VK_SHADER_STAGE_VERTEX_BIT |
-                           VK_SHADER_STAGE_FRAGMENT_BIT,
-                       0, sizeof(PointLightPushConstants), &push);
+  DrawPacket packet{};
+  packet.sortKey = VlknRenderQueue::makeTransparentKey(pipeline.getId(), 0, 0);
+  packet.pipeline = &pipeline;
+  packet.pipelineLayout = pipelineLayout;
+  packet.descriptorSet = frameInfo.globalDescriptorSet;
+  packet.vertexCount = 6;
+  packet.instanceCount = instanceCount;
+  packet.instanceBuffer = instanceBuffer;
 
-    vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
-  }
+  frameInfo.renderQueue.push(packet);
 }
 
 } // namespace vlkn
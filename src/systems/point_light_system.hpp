@@ -1,11 +1,13 @@
 #pragma once
 
 // local
+#include "vlkn_buffer.hpp"
 #include "vlkn_camera.hpp"
+#include "vlkn_components.hpp"
 #include "vlkn_device.hpp"
 #include "vlkn_frame_info.hpp"
-#include "vlkn_game_object.hpp"
 #include "vlkn_pipeline.hpp"
+#include "vlkn_pipeline_builder.hpp"
 
 // libs
 // GLM
@@ -14,6 +16,7 @@
 #include <vulkan/vulkan_core.h>
 
 // std
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -21,24 +24,51 @@ namespace vlkn {
 
 class PointLightSystem {
 public:
-  PointLightSystem(VlknDevice &device, VkRenderPass renderPass,
-                   VkDescriptorSetLayout globalSetLayout);
+  // The pipeline is built on the builder's threads
+  PointLightSystem(VlknDevice &device, VlknPipelineBuilder &pipelineBuilder,
+                   VkRenderPass renderPass,
+                   std::uint32_t subpass,
+                   VkDescriptorSetLayout globalSetLayout,
+                   VkSampleCountFlagBits sampleCount,
+                   std::uint32_t framesInFlight);
   ~PointLightSystem();
 
   PointLightSystem(const PointLightSystem &) = delete;
   PointLightSystem &operator=(const PointLightSystem &) = delete;
 
+  // Animates the lights and collects them for VlknLightClusters, along with
+  // the entity of every light for VlknShadowAtlas
   void update(const FrameInfo &frameInfo, const glm::vec4 pointLightColor,
-              GlobalUbo &ubo);
+              std::vector<PointLight> &lights,
+              std::vector<Entity> &lightEntities);
+  // Writes the billboards in view into the instance buffer of the frame and
+  // pushes a single instanced draw for all of them. Billboards are blended
+  // order independently, so they are written in query order.
   void render(const FrameInfo &frameInfo, const glm::vec4 pointLightColor);
+  // Pushes one instanced draw of billboards written on the GPU, such as the
+  // ones of VlknLightAnimator
+  void renderInstances(const FrameInfo &frameInfo, VkBuffer instanceBuffer,
+                       std::uint32_t instanceCount);
 
 private:
+  // Per instance vertex attributes, position.w is the billboard radius
+  struct BillboardInstance {
+    glm::vec4 position{};
+    glm::vec4 color{};
+  };
+
   void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-  void createPipeline(VkRenderPass renderPass);
+  std::unique_ptr<VlknPipeline>
+  createPipeline(VkRenderPass renderPass, std::uint32_t subpass,
+                 VkSampleCountFlagBits sampleCount);
+  void createInstanceBuffers(std::uint32_t framesInFlight);
 
   VlknDevice &vlknDevice;
-  std::unique_ptr<VlknPipeline> vlknPipeline;
+  VlknAsyncPipeline vlknPipeline{};
   VkPipelineLayout pipelineLayout;
+
+  // One per frame in flight, MAX_LIGHTS instances each
+  std::vector<std::unique_ptr<VlknBuffer>> instanceBuffers{};
 };
 
 } // namespace vlkn
@@ -1,8 +1,15 @@
 // header
 #include "render_system.hpp"
 
+// local
+#include "vlkn_utils.hpp"
+
 // std
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <string>
+#include <utility>
 
 namespace vlkn {
 
@@ -11,14 +18,25 @@ struct PushConstantData {
   glm::mat4 normalMatrix{1.0f};
 };
 
-RenderSystem::RenderSystem(VlknDevice &device, VkRenderPass renderPass,
-                           VkDescriptorSetLayout globalSetLayout)
-    : vlknDevice(device) {
+RenderSystem::RenderSystem(VlknDevice &device,
+                           VlknPipelineBuilder &pipelineBuilder,
+                           VkRenderPass renderPass,
+                           VkDescriptorSetLayout globalSetLayout,
+                           RenderPath renderPath,
+                           std::uint32_t transparentSubpass,
+                           VkSampleCountFlagBits sampleCount)
+    : vlknDevice(device), pipelineBuilder(pipelineBuilder),
+      renderPass(renderPass),
+      deferred(renderPath == RenderPath::Deferred),
+      transparentSubpass(transparentSubpass), sampleCount(sampleCount) {
   createPipelineLayout(globalSetLayout);
-  createPipeline(renderPass);
+  createPipelines();
 }
 
 RenderSystem::~RenderSystem() {
+  // Builds still running use the pipeline layout
+  shadingPipelines.clear();
+  depthPrepassPipeline = VlknAsyncPipeline{};
   vkDestroyPipelineLayout(vlknDevice.device(), pipelineLayout, nullptr);
 }
 
@@ -46,46 +64,242 @@ void RenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
   }
 }
 
-void RenderSystem::createPipeline(VkRenderPass renderPass) {
+std::size_t RenderSystem::ShadingVariantHash::operator()(
+    const ShadingVariant &variant) const {
+  std::size_t seed = 0;
+  hashCombine(seed, variant.lightBucket, variant.textured, variant.alpha,
+              variant.depthEqual);
+  return seed;
+}
+
+void RenderSystem::setMaxClusterLights(std::uint32_t count) {
+  lightBucket = LIGHT_BUCKETS.back();
+  for (std::uint32_t bucket : LIGHT_BUCKETS) {
+    if (count <= bucket) {
+      lightBucket = bucket;
+      break;
+    }
+  }
+}
+
+void RenderSystem::createPipelines() {
   assert(pipelineLayout != nullptr &&
          "Cannot create pipeline before pipeline layout");
 
+  // The base variants are built up front, the rest on first use
+  for (const bool textured : {true, false}) {
+    for (const ShadingVariant &variant :
+         {ShadingVariant{.textured = textured},
+          ShadingVariant{.textured = textured, .depthEqual = true},
+          ShadingVariant{.textured = textured, .alpha = true}}) {
+      const ShadingVariant key = makeKey(variant);
+      shadingPipelines.emplace(key, pipelineBuilder.build([this, key]() {
+        return createShadingPipeline(key);
+      }));
+    }
+  }
+
+  depthPrepassPipeline = pipelineBuilder.build(
+      [this]() { return createDepthPrepassPipeline(); });
+}
+
+std::unique_ptr<VlknPipeline> RenderSystem::createDepthPrepassPipeline() {
   PipelineConfigInfo pipelineConfig{};
   VlknPipeline::defaultPipelineConfigInfo(pipelineConfig);
+  pipelineConfig.multisampleInfo.rasterizationSamples = sampleCount;
   pipelineConfig.renderPass = renderPass;
   pipelineConfig.pipelineLayout = pipelineLayout;
-  vlknPipeline = std::make_unique<VlknPipeline>(
-      vlknDevice, "shaders/render_textured.vert.spv",
-      "shaders/render_textured.frag.spv", pipelineConfig);
+  pipelineConfig.subpass = VlknSwapChain::GEOMETRY_SUBPASS;
+
+  // Only the position attribute at location 0 is fetched from the
+  // interleaved vertex buffer. Nothing is written to the color attachments,
+  // the G-buffer has two.
+  pipelineConfig.attributeDescriptions.resize(1);
+  std::array<VkPipelineColorBlendAttachmentState, 2> colorAttachments = {
+      pipelineConfig.colorBlendAttachment, pipelineConfig.colorBlendAttachment};
+  for (VkPipelineColorBlendAttachmentState &attachment : colorAttachments) {
+    attachment.colorWriteMask = 0;
+  }
+  pipelineConfig.colorBlendInfo.attachmentCount = deferred ? 2 : 1;
+  pipelineConfig.colorBlendInfo.pAttachments = colorAttachments.data();
+  return std::make_unique<VlknPipeline>(
+      vlknDevice, "shaders/depth_prepass.vert.spv",
+      "shaders/depth_prepass.frag.spv", pipelineConfig);
+}
+
+RenderSystem::ShadingVariant
+RenderSystem::makeKey(ShadingVariant variant) const {
+  // The G-buffer shader does not loop over the lights
+  if (deferred && !variant.alpha) {
+    variant.lightBucket = 0;
+  }
+  return variant;
+}
+
+VlknPipeline &
+RenderSystem::getShadingPipeline(const ShadingVariant &variant) {
+  const ShadingVariant key = makeKey(variant);
+
+  auto found = shadingPipelines.find(key);
+  if (found == shadingPipelines.end()) {
+    found = shadingPipelines
+                .emplace(key, pipelineBuilder.build([this, key]() {
+                  return createShadingPipeline(key);
+                }))
+                .first;
+  }
+
+  if (VlknPipeline *pipeline = found->second.get()) {
+    return *pipeline;
+  }
+
+  // The base variant handles any light count of the pass. Texturing changes
+  // the colour, so it is kept. Base variants are built with the system, so
+  // they are only ever waited for before the first frame.
+  const ShadingVariant baseKey =
+      makeKey({.textured = variant.textured,
+               .alpha = variant.alpha,
+               .depthEqual = variant.depthEqual});
+  if (key == baseKey) {
+    return found->second.wait();
+  }
+  return getShadingPipeline(baseKey);
+}
+
+std::unique_ptr<VlknPipeline>
+RenderSystem::createShadingPipeline(const ShadingVariant &variant) {
+  const std::string vertFilepath = "shaders/render_textured.vert.spv";
+  std::string fragFilepath = "shaders/render_textured.frag.spv";
+
+  PipelineConfigInfo pipelineConfig{};
+  VlknPipeline::defaultPipelineConfigInfo(pipelineConfig);
+  pipelineConfig.multisampleInfo.rasterizationSamples = sampleCount;
+  pipelineConfig.renderPass = renderPass;
+  pipelineConfig.pipelineLayout = pipelineLayout;
+  pipelineConfig.subpass = VlknSwapChain::GEOMETRY_SUBPASS;
+
+  // The G-buffer has albedo and normal attachments, neither of them blended
+  std::array<VkPipelineColorBlendAttachmentState, 2> colorAttachments = {
+      pipelineConfig.colorBlendAttachment, pipelineConfig.colorBlendAttachment};
+  pipelineConfig.colorBlendInfo.attachmentCount = deferred ? 2 : 1;
+  pipelineConfig.colorBlendInfo.pAttachments = colorAttachments.data();
+
+  if (variant.alpha) {
+    // Shaded like the forward path and accumulated into the transparency
+    // targets
+    fragFilepath = "shaders/render_transparent.frag.spv";
+    pipelineConfig.subpass = transparentSubpass;
+    VlknPipeline::enableWeightedBlending(pipelineConfig);
+  } else if (deferred) {
+    fragFilepath = "shaders/gbuffer.frag.spv";
+  }
+
+  if (variant.depthEqual) {
+    pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+    pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+  }
+
+  VlknPipeline::addSpecializationConstant(
+      pipelineConfig,
+      static_cast<std::uint32_t>(ShaderConstant::MaxClusterLights),
+      variant.lightBucket);
+  VlknPipeline::addSpecializationConstant(
+      pipelineConfig, static_cast<std::uint32_t>(ShaderConstant::Textured),
+      static_cast<VkBool32>(variant.textured));
+  VlknPipeline::addSpecializationConstant(
+      pipelineConfig, static_cast<std::uint32_t>(ShaderConstant::TextureCount),
+      static_cast<std::uint32_t>(TEXTURE_COUNT));
+  VlknPipeline::addSpecializationConstant(
+      pipelineConfig,
+      static_cast<std::uint32_t>(ShaderConstant::SpecularExponent),
+      SPECULAR_EXPONENT);
+
+  return std::make_unique<VlknPipeline>(vlknDevice, vertFilepath,
+                                        fragFilepath, pipelineConfig);
 }
 
 void RenderSystem::renderGameObjects(FrameInfo &frameInfo) {
-  vlknPipeline->bind(frameInfo.commandBuffer);
+  const glm::vec3 cameraPosition = frameInfo.camera.getPosition();
+  const Frustum frustum = Frustum::fromViewProjection(
+      frameInfo.camera.getProjection() * frameInfo.camera.getView());
+  VlknPipeline &prepassPipeline = depthPrepassPipeline.wait();
 
-  vkCmdBindDescriptorSets(frameInfo.commandBuffer,
-                          VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
-                          &frameInfo.globalDescriptorSet, 0, nullptr);
+  frameInfo.sceneBvh.queryFrustum(frustum, [&](Entity entity) {
+    ModelComponent *modelComponent =
+        frameInfo.registry.tryGet<ModelComponent>(entity);
+    if (modelComponent == nullptr || modelComponent->model == nullptr) {
+      return;
+    }
 
-  for (auto &kv : frameInfo.gameObjects) {
-    VlknGameObject &obj = kv.second;
+    TransformComponent &transform =
+        frameInfo.registry.get<TransformComponent>(entity);
+    const glm::mat4 &modelMatrix = transform.mat4();
 
-    if (obj.model == nullptr) {
-      continue;
+    if (!frameInfo.occlusionCuller.isVisible(
+            modelComponent->model->getBoundingBox(), modelMatrix)) {
+      return;
     }
 
+    // Models without a texture index are drawn with the vertex colour only
+    const bool textured = modelComponent->imgIdx >= 0;
+    const std::uint32_t material =
+        static_cast<std::uint32_t>(std::max(modelComponent->imgIdx, 0));
+
     PushConstantData push{};
-    push.modelMatrix = obj.transform.mat4();
-    push.normalMatrix = glm::mat4(obj.transform.normalMatrix());
-    push.normalMatrix[3][3] = obj.imgIdx;
+    push.modelMatrix = modelMatrix;
+    push.normalMatrix = glm::mat4(transform.normalMatrix());
+    push.normalMatrix[3][3] = static_cast<float>(material);
+    push.normalMatrix[3][2] = modelComponent->opacity;
 
-    vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout,
-                       VK_SHADER_STAGE_VERTEX_BIT |
-                           VK_SHADER_STAGE_FRAGMENT_BIT,
-                       0, sizeof(PushConstantData), &push);
+    if (modelComponent->opacity < 1.0f) {
+      VlknPipeline &transparentPipeline = getShadingPipeline(
+          {.lightBucket = lightBucket, .textured = textured, .alpha = true});
 
-    obj.model->bind(frameInfo.commandBuffer);
-    obj.model->draw(frameInfo.commandBuffer);
-  }
+      DrawPacket packet{};
+      packet.sortKey = VlknRenderQueue::makeTransparentKey(
+          transparentPipeline.getId(), material,
+          modelComponent->model->getId());
+      packet.pipeline = &transparentPipeline;
+      packet.pipelineLayout = pipelineLayout;
+      packet.descriptorSet = frameInfo.globalDescriptorSet;
+      packet.model = modelComponent->model.get();
+      packet.setPushConstants(VK_SHADER_STAGE_VERTEX_BIT |
+                                  VK_SHADER_STAGE_FRAGMENT_BIT,
+                              push);
+
+      frameInfo.renderQueue.push(packet);
+      return;
+    }
+
+    const glm::vec3 offset = cameraPosition - glm::vec3(modelMatrix[3]);
+    const float viewDistance = glm::length(offset);
+    VlknPipeline &shadingPipeline =
+        getShadingPipeline({.lightBucket = lightBucket,
+                            .textured = textured,
+                            .depthEqual = depthPrepass});
+
+    DrawPacket packet{};
+    packet.sortKey = VlknRenderQueue::makeOpaqueKey(
+        shadingPipeline.getId(), material, modelComponent->model->getId(),
+        viewDistance);
+    packet.pipeline = &shadingPipeline;
+    packet.pipelineLayout = pipelineLayout;
+    packet.descriptorSet = frameInfo.globalDescriptorSet;
+    packet.model = modelComponent->model.get();
+    packet.setPushConstants(VK_SHADER_STAGE_VERTEX_BIT |
+                                VK_SHADER_STAGE_FRAGMENT_BIT,
+                            push);
+
+    frameInfo.renderQueue.push(packet);
+
+    if (depthPrepass) {
+      packet.sortKey = VlknRenderQueue::makeDepthPrepassKey(
+          prepassPipeline.getId(), modelComponent->model->getId(),
+          viewDistance);
+      packet.pipeline = &prepassPipeline;
+      frameInfo.renderQueue.push(packet);
+    }
+  });
 }
 
 } // namespace vlkn
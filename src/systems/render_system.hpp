@@ -2,10 +2,12 @@
 
 // local
 #include "vlkn_camera.hpp"
+#include "vlkn_components.hpp"
 #include "vlkn_device.hpp"
 #include "vlkn_frame_info.hpp"
-#include "vlkn_game_object.hpp"
 #include "vlkn_pipeline.hpp"
+#include "vlkn_pipeline_builder.hpp"
+#include "vlkn_swap_chain.hpp"
 
 // libs
 // GLM
@@ -14,15 +16,39 @@
 #include <vulkan/vulkan_core.h>
 
 // std
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace vlkn {
 
+// Shading pipelines are variants of the same shaders, specialised through
+// specialization constants for the light count, texturing and transparency
+// of the draw. Variants are requested by key and created on first use on
+// the pipeline builder's threads; until a variant is ready its draws use
+// the base variant of their pass and texturing, which handles any light
+// count.
 class RenderSystem {
 public:
-  RenderSystem(VlknDevice &device, VkRenderPass renderPass,
-               VkDescriptorSetLayout globalSetLayout);
+  // Light loop bounds the shading shaders are specialised for. The smallest
+  // bucket holding the most lights of any cluster is used, so small light
+  // counts get a short loop the driver can unroll.
+  static constexpr std::array<std::uint32_t, 4> LIGHT_BUCKETS = {
+      8, 32, 128, static_cast<std::uint32_t>(MAX_LIGHTS)};
+
+  // On the deferred path opaque models are drawn into the G-buffer instead
+  // of being shaded. Transparent models are shaded in transparentSubpass on
+  // both paths.
+  // The base variants and the depth pre-pass pipeline are only being
+  // built when the constructor returns, see VlknPipelineBuilder::waitIdle
+  RenderSystem(VlknDevice &device, VlknPipelineBuilder &pipelineBuilder,
+               VkRenderPass renderPass,
+               VkDescriptorSetLayout globalSetLayout, RenderPath renderPath,
+               std::uint32_t transparentSubpass,
+               VkSampleCountFlagBits sampleCount);
   ~RenderSystem();
 
   RenderSystem(const RenderSystem &) = delete;
@@ -30,13 +56,59 @@ public:
 
   void renderGameObjects(FrameInfo &frameInfo);
 
+  // With the pre-pass every model is first drawn depth only, and then shaded
+  // with an equal depth test, so each pixel is shaded at most once
+  void setDepthPrepass(bool enabled) { depthPrepass = enabled; }
+  // Picks the light bucket, see VlknLightClusters::getMaxClusterLights
+  void setMaxClusterLights(std::uint32_t count);
+
+  std::size_t getVariantCount() const { return shadingPipelines.size(); }
+
 private:
+  struct ShadingVariant {
+    std::uint32_t lightBucket = LIGHT_BUCKETS.back();
+    bool textured = true;
+    // Forward shading into the weighted blended transparency targets
+    bool alpha = false;
+    // Tests for equal depth without writing it, after the depth pre-pass
+    bool depthEqual = false;
+
+    bool operator==(const ShadingVariant &other) const = default;
+  };
+
+  struct ShadingVariantHash {
+    std::size_t operator()(const ShadingVariant &variant) const;
+  };
+
   void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-  void createPipeline(VkRenderPass renderPass);
+  void createPipelines();
+  std::unique_ptr<VlknPipeline> createDepthPrepassPipeline();
+  // Runs on a builder thread, so it only reads members fixed at construction
+  std::unique_ptr<VlknPipeline>
+  createShadingPipeline(const ShadingVariant &variant);
+  // Clears the fields the shader of the variant's pass ignores, so they do
+  // not create duplicate pipelines
+  ShadingVariant makeKey(ShadingVariant variant) const;
+  // The variant if it is ready, its base variant otherwise
+  VlknPipeline &getShadingPipeline(const ShadingVariant &variant);
 
   VlknDevice &vlknDevice;
-  std::unique_ptr<VlknPipeline> vlknPipeline;
+  VlknPipelineBuilder &pipelineBuilder;
+  // Variants are created long after construction. The swap chain hands its
+  // render pass on when it is recreated, so the handle stays valid.
+  VkRenderPass renderPass;
+  bool deferred;
+  std::uint32_t transparentSubpass;
+  VkSampleCountFlagBits sampleCount;
+
+  std::unordered_map<ShadingVariant, VlknAsyncPipeline, ShadingVariantHash>
+      shadingPipelines{};
+  // Position only, writes depth and no color
+  VlknAsyncPipeline depthPrepassPipeline{};
   VkPipelineLayout pipelineLayout;
+
+  bool depthPrepass = false;
+  std::uint32_t lightBucket = LIGHT_BUCKETS.back();
 };
 
 } // namespace vlkn
@@ -0,0 +1,134 @@
+// header
+#include "transparency_composite_system.hpp"
+
+// std
+#include <array>
+#include <cassert>
+#include <utility>
+
+namespace vlkn {
+
+TransparencyCompositeSystem::TransparencyCompositeSystem(
+    VlknDevice &device, VlknRenderer &renderer)
+    : vlknDevice(device), vlknRenderer(renderer) {
+  createInputSetLayout();
+  createPipelineLayout();
+  createPipeline(vlknRenderer.getSwapChainRenderPass(),
+                 vlknRenderer.getCompositeSubpass());
+}
+
+TransparencyCompositeSystem::~TransparencyCompositeSystem() {
+  vkDestroyPipelineLayout(vlknDevice.device(), pipelineLayout, nullptr);
+}
+
+void TransparencyCompositeSystem::createInputSetLayout() {
+  // Accumulation and revealage, in the order of the composite subpass' input
+  // attachments
+  inputSetLayout =
+      VlknDescriptorSetLayout::Builder(vlknDevice)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .build();
+}
+
+void TransparencyCompositeSystem::createPipelineLayout() {
+  VkDescriptorSetLayout descriptorSetLayout =
+      inputSetLayout->getDescriptorSetLayout();
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 0;
+  pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+  if (vkCreatePipelineLayout(vlknDevice.device(), &pipelineLayoutInfo, nullptr,
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout");
+  }
+}
+
+void TransparencyCompositeSystem::createPipeline(VkRenderPass renderPass,
+                                                 std::uint32_t subpass) {
+  assert(pipelineLayout != nullptr &&
+         "Cannot create pipeline before pipeline layout");
+
+  PipelineConfigInfo pipelineConfig{};
+  VlknPipeline::defaultPipelineConfigInfo(pipelineConfig);
+  VlknPipeline::enableAlphaBlending(pipelineConfig);
+  // Shaded once per pixel from the resolved targets and blended over every
+  // sample
+  pipelineConfig.multisampleInfo.rasterizationSamples =
+      vlknRenderer.getSampleCount();
+  pipelineConfig.bindingDescriptions.clear();
+  pipelineConfig.attributeDescriptions.clear();
+  // The composite subpass has no depth attachment
+  pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+  pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+  pipelineConfig.renderPass = renderPass;
+  pipelineConfig.subpass = subpass;
+  pipelineConfig.pipelineLayout = pipelineLayout;
+  vlknPipeline = std::make_unique<VlknPipeline>(
+      vlknDevice, "shaders/deferred_lighting.vert.spv",
+      "shaders/transparency_composite.frag.spv", pipelineConfig);
+}
+
+void TransparencyCompositeSystem::writeInputSets() {
+  const std::uint32_t imageCount =
+      static_cast<std::uint32_t>(vlknRenderer.getSwapChainImageCount());
+
+  // Frames in flight may still bind the old sets, their pool is destroyed
+  // once those frames finished
+  if (inputPool != nullptr) {
+    vlknRenderer.deferDestruction(std::move(inputPool));
+  }
+  inputPool =
+      VlknDescriptorPool::Builder(vlknDevice)
+          .setMaxSets(imageCount)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 2 * imageCount)
+          .build();
+
+  inputSets.resize(imageCount);
+
+  for (std::uint32_t i = 0; i < imageCount; i++) {
+    std::array<VkDescriptorImageInfo, 2> imageInfos{};
+    imageInfos[0].imageView = vlknRenderer.getAccumImageView(i);
+    imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[1].imageView = vlknRenderer.getRevealageImageView(i);
+    imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VlknDescriptorWriter descriptorWriter =
+        VlknDescriptorWriter(*inputSetLayout, *inputPool);
+
+    for (std::uint32_t binding = 0; binding < imageInfos.size(); binding++) {
+      descriptorWriter.writeImage(binding, &imageInfos[binding]);
+    }
+
+    if (!descriptorWriter.build(inputSets[i])) {
+      throw std::runtime_error("failed to build the input attachment sets");
+    }
+  }
+
+  inputSetsGeneration = vlknRenderer.getSwapChainGeneration();
+  inputSetsWritten = true;
+}
+
+void TransparencyCompositeSystem::render(const FrameInfo &frameInfo) {
+  if (!inputSetsWritten ||
+      inputSetsGeneration != vlknRenderer.getSwapChainGeneration()) {
+    writeInputSets();
+  }
+
+  vlknPipeline->bind(frameInfo.commandBuffer);
+
+  vkCmdBindDescriptorSets(frameInfo.commandBuffer,
+                          VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                          &inputSets[vlknRenderer.getImageIndex()], 0, nullptr);
+
+  // Fullscreen triangle generated from the vertex index
+  vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+}
+
+} // namespace vlkn
@@ -0,0 +1,59 @@
+#pragma once
+
+// local
+#include "vlkn_descriptors.hpp"
+#include "vlkn_device.hpp"
+#include "vlkn_frame_info.hpp"
+#include "vlkn_pipeline.hpp"
+#include "vlkn_renderer.hpp"
+
+// libs
+// Vulkan
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vlkn {
+
+// Composite subpass of weighted blended order independent transparency. A
+// fullscreen triangle reads the accumulation and revealage targets of its
+// own pixel as input attachments and blends their weighted average colour
+// over the shaded image, so transparent draws never have to be sorted.
+class TransparencyCompositeSystem {
+public:
+  TransparencyCompositeSystem(VlknDevice &device, VlknRenderer &renderer);
+  ~TransparencyCompositeSystem();
+
+  TransparencyCompositeSystem(const TransparencyCompositeSystem &) = delete;
+  TransparencyCompositeSystem &
+  operator=(const TransparencyCompositeSystem &) = delete;
+
+  // Records the composite draw, must be called in the composite subpass
+  void render(const FrameInfo &frameInfo);
+
+private:
+  void createInputSetLayout();
+  void createPipelineLayout();
+  void createPipeline(VkRenderPass renderPass, std::uint32_t subpass);
+  // The targets are recreated with the swap chain, so the input attachment
+  // sets are rewritten whenever the swap chain generation changes
+  void writeInputSets();
+
+  VlknDevice &vlknDevice;
+  VlknRenderer &vlknRenderer;
+
+  std::unique_ptr<VlknDescriptorSetLayout> inputSetLayout;
+  std::unique_ptr<VlknDescriptorPool> inputPool;
+  // One set per swap chain image
+  std::vector<VkDescriptorSet> inputSets{};
+  std::uint32_t inputSetsGeneration = 0;
+  bool inputSetsWritten = false;
+
+  std::unique_ptr<VlknPipeline> vlknPipeline;
+  VkPipelineLayout pipelineLayout;
+};
+
+} // namespace vlkn
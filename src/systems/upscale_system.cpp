@@ -0,0 +1,184 @@
+// header
+#include "upscale_system.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+namespace vlkn {
+
+struct UpscalePushConstants {
+  // Scene image uv of the bottom right corner of the render extent
+  glm::vec2 uvScale{};
+  glm::vec2 texelSize{};
+  float sharpness = 0.0f;
+};
+
+UpscaleSystem::UpscaleSystem(VlknDevice &device, VlknRenderer &renderer)
+    : vlknDevice(device), vlknRenderer(renderer) {
+  createSampler();
+  createSceneSetLayout();
+  createPipelineLayout();
+  createPipeline(vlknRenderer.getPresentRenderPass());
+}
+
+UpscaleSystem::~UpscaleSystem() {
+  vkDestroyPipelineLayout(vlknDevice.device(), pipelineLayout, nullptr);
+  vkDestroySampler(vlknDevice.device(), sceneSampler, nullptr);
+}
+
+void UpscaleSystem::createSampler() {
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+  samplerInfo.anisotropyEnable = VK_FALSE;
+  samplerInfo.maxAnisotropy = 1.0f;
+
+  samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+  samplerInfo.compareEnable = VK_FALSE;
+  samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.mipLodBias = 0.0f;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = 0.0f;
+
+  if (vkCreateSampler(vlknDevice.device(), &samplerInfo, nullptr,
+                      &sceneSampler) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create scene sampler!");
+  }
+}
+
+void UpscaleSystem::createSceneSetLayout() {
+  sceneSetLayout =
+      VlknDescriptorSetLayout::Builder(vlknDevice)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .build();
+}
+
+void UpscaleSystem::createPipelineLayout() {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(UpscalePushConstants);
+
+  VkDescriptorSetLayout descriptorSetLayout =
+      sceneSetLayout->getDescriptorSetLayout();
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(vlknDevice.device(), &pipelineLayoutInfo, nullptr,
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout");
+  }
+}
+
+void UpscaleSystem::createPipeline(VkRenderPass renderPass) {
+  assert(pipelineLayout != nullptr &&
+         "Cannot create pipeline before pipeline layout");
+
+  PipelineConfigInfo pipelineConfig{};
+  VlknPipeline::defaultPipelineConfigInfo(pipelineConfig);
+  pipelineConfig.bindingDescriptions.clear();
+  pipelineConfig.attributeDescriptions.clear();
+  // The present render pass has no depth attachment
+  pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+  pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+  pipelineConfig.renderPass = renderPass;
+  pipelineConfig.colorAttachmentFormats = {
+      vlknRenderer.getSwapChainImageFormat()};
+  pipelineConfig.subpass = 0;
+  pipelineConfig.pipelineLayout = pipelineLayout;
+  vlknPipeline = std::make_unique<VlknPipeline>(
+      vlknDevice, "shaders/deferred_lighting.vert.spv",
+      "shaders/upscale.frag.spv", pipelineConfig);
+}
+
+void UpscaleSystem::writeSceneSets() {
+  const std::uint32_t imageCount =
+      static_cast<std::uint32_t>(vlknRenderer.getSwapChainImageCount());
+
+  // Frames in flight may still bind the old sets, their pool is destroyed
+  // once those frames finished
+  if (scenePool != nullptr) {
+    vlknRenderer.deferDestruction(std::move(scenePool));
+  }
+  scenePool = VlknDescriptorPool::Builder(vlknDevice)
+                  .setMaxSets(imageCount)
+                  .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                               imageCount)
+                  .build();
+
+  sceneSets.resize(imageCount);
+
+  for (std::uint32_t i = 0; i < imageCount; i++) {
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = sceneSampler;
+    imageInfo.imageView = vlknRenderer.getSceneImageView(i);
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VlknDescriptorWriter descriptorWriter =
+        VlknDescriptorWriter(*sceneSetLayout, *scenePool);
+
+    descriptorWriter.writeImage(0, &imageInfo);
+
+    if (!descriptorWriter.build(sceneSets[i])) {
+      throw std::runtime_error("failed to build the scene image sets");
+    }
+  }
+
+  sceneSetsGeneration = vlknRenderer.getSwapChainGeneration();
+  sceneSetsWritten = true;
+}
+
+void UpscaleSystem::render(const FrameInfo &frameInfo, float sharpness) {
+  if (!sceneSetsWritten ||
+      sceneSetsGeneration != vlknRenderer.getSwapChainGeneration()) {
+    writeSceneSets();
+  }
+
+  vlknPipeline->bind(frameInfo.commandBuffer);
+
+  vkCmdBindDescriptorSets(frameInfo.commandBuffer,
+                          VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                          &sceneSets[vlknRenderer.getImageIndex()], 0, nullptr);
+
+  const VkExtent2D fullExtent = vlknRenderer.getSwapChainExtent();
+  const VkExtent2D renderExtent = vlknRenderer.getRenderExtent();
+
+  UpscalePushConstants push{};
+  push.texelSize = 1.0f / glm::vec2(fullExtent.width, fullExtent.height);
+  push.uvScale =
+      glm::vec2(renderExtent.width, renderExtent.height) * push.texelSize;
+  push.sharpness = sharpness;
+
+  vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout,
+                     VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                     sizeof(UpscalePushConstants), &push);
+
+  // Fullscreen triangle generated from the vertex index
+  vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+}
+
+} // namespace vlkn
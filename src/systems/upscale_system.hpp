@@ -0,0 +1,63 @@
+#pragma once
+
+// local
+#include "vlkn_descriptors.hpp"
+#include "vlkn_device.hpp"
+#include "vlkn_frame_info.hpp"
+#include "vlkn_pipeline.hpp"
+#include "vlkn_renderer.hpp"
+
+// libs
+// Vulkan
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vlkn {
+
+// Upscales the render extent of the scene image to the whole swap chain
+// image in the present render pass. A fullscreen triangle samples the scene
+// bilinearly, optionally followed by a sharpening filter that recovers some
+// of the detail lost at lower render scales.
+class UpscaleSystem {
+public:
+  UpscaleSystem(VlknDevice &device, VlknRenderer &renderer);
+  ~UpscaleSystem();
+
+  UpscaleSystem(const UpscaleSystem &) = delete;
+  UpscaleSystem &operator=(const UpscaleSystem &) = delete;
+
+  // Records the upscale draw, must be called in the present render pass.
+  // A sharpness of 0 is plain bilinear filtering.
+  void render(const FrameInfo &frameInfo, float sharpness);
+
+private:
+  void createSampler();
+  void createSceneSetLayout();
+  void createPipelineLayout();
+  // A null render pass creates the pipeline for dynamic rendering
+  void createPipeline(VkRenderPass renderPass);
+  // The scene images are recreated with the swap chain, so the sets are
+  // rewritten whenever the swap chain generation changes
+  void writeSceneSets();
+
+  VlknDevice &vlknDevice;
+  VlknRenderer &vlknRenderer;
+
+  VkSampler sceneSampler = VK_NULL_HANDLE;
+
+  std::unique_ptr<VlknDescriptorSetLayout> sceneSetLayout;
+  std::unique_ptr<VlknDescriptorPool> scenePool;
+  // One set per swap chain image
+  std::vector<VkDescriptorSet> sceneSets{};
+  std::uint32_t sceneSetsGeneration = 0;
+  bool sceneSetsWritten = false;
+
+  std::unique_ptr<VlknPipeline> vlknPipeline;
+  VkPipelineLayout pipelineLayout;
+};
+
+} // namespace vlkn
@@ -0,0 +1,483 @@
+// header
+#include "vlkn_bvh.hpp"
+
+// local
+#include "vlkn_components.hpp"
+
+// std
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace vlkn {
+
+Aabb Aabb::transform(const VlknModel::BoundingBox &box,
+                     const glm::mat4 &modelMatrix) {
+  const glm::vec3 center = 0.5f * (box.min + box.max);
+  const glm::vec3 extent = 0.5f * (box.max - box.min);
+
+  // The extent of the rotated box is the absolute upper-left 3x3 part of the
+  // matrix applied to the model space extent
+  const glm::vec3 worldCenter = glm::vec3(modelMatrix * glm::vec4(center, 1));
+  glm::vec3 worldExtent{0.0f};
+  for (int column = 0; column < 3; column++) {
+    worldExtent += glm::abs(glm::vec3(modelMatrix[column])) * extent[column];
+  }
+
+  return Aabb{worldCenter - worldExtent, worldCenter + worldExtent};
+}
+
+Frustum Frustum::fromViewProjection(const glm::mat4 &viewProjection) {
+  auto row = [&](int index) {
+    return glm::vec4(viewProjection[0][index], viewProjection[1][index],
+                     viewProjection[2][index], viewProjection[3][index]);
+  };
+
+  Frustum frustum{};
+  frustum.planes[0] = row(3) + row(0); // left
+  frustum.planes[1] = row(3) - row(0); // right
+  frustum.planes[2] = row(3) + row(1); // bottom
+  frustum.planes[3] = row(3) - row(1); // top
+  frustum.planes[4] = row(2);          // near
+  frustum.planes[5] = row(3) - row(2); // far
+  return frustum;
+}
+
+bool Frustum::intersects(const Aabb &box) const {
+  for (const glm::vec4 &plane : planes) {
+    // Corner of the box furthest along the plane normal
+    const glm::vec3 corner{plane.x >= 0.0f ? box.max.x : box.min.x,
+                           plane.y >= 0.0f ? box.max.y : box.min.y,
+                           plane.z >= 0.0f ? box.max.z : box.min.z};
+
+    if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::uint32_t VlknBvh::insert(Entity entity, const Aabb &bounds) {
+  std::uint32_t leaf = createLeaf(entity, bounds);
+  reinsertsSinceRebuild++;
+
+  if (insertLeaf(leaf) > MAX_DEPTH / 2) {
+    rebuild();
+  }
+  return leaf;
+}
+
+void VlknBvh::remove(std::uint32_t proxy) {
+  assert(nodes[proxy].isLeaf() && "Proxy is not a leaf");
+
+  removeLeaf(proxy);
+  freeNode(proxy);
+  leafCount--;
+}
+
+bool VlknBvh::move(std::uint32_t proxy, const Aabb &bounds) {
+  assert(nodes[proxy].isLeaf() && "Proxy is not a leaf");
+
+  if (nodes[proxy].bounds.contains(bounds)) {
+    return false;
+  }
+
+  removeLeaf(proxy);
+  nodes[proxy].bounds = fatten(bounds);
+  reinsertsSinceRebuild++;
+
+  if (insertLeaf(proxy) > MAX_DEPTH / 2) {
+    rebuild();
+  }
+  return true;
+}
+
+void VlknBvh::rebuild() {
+  reinsertsSinceRebuild = 0;
+
+  // Collect the leaves and free every internal node for reuse by the build
+  buildLeaves.clear();
+  std::vector<std::uint32_t> stack = std::move(pendingLeaves);
+  pendingLeaves.clear();
+  if (root != NULL_NODE) {
+    stack.push_back(root);
+  }
+
+  while (!stack.empty()) {
+    std::uint32_t node = stack.back();
+    stack.pop_back();
+
+    if (nodes[node].isLeaf()) {
+      const Aabb &bounds = nodes[node].bounds;
+      buildLeaves.push_back(
+          BuildLeaf{bounds, 0.5f * (bounds.min + bounds.max), node});
+    } else {
+      stack.push_back(nodes[node].children[0]);
+      stack.push_back(nodes[node].children[1]);
+      freeNode(node);
+    }
+  }
+
+  if (buildLeaves.empty()) {
+    root = NULL_NODE;
+    return;
+  }
+
+  root = buildRange(0, static_cast<std::uint32_t>(buildLeaves.size()));
+  nodes[root].parent = NULL_NODE;
+}
+
+void VlknBvh::update(VlknRegistry &registry) {
+  updateStamp++;
+
+  registry.view<TransformComponent, ModelComponent>().each(
+      [&](Entity entity, TransformComponent &transform,
+          ModelComponent &modelComponent) {
+        if (modelComponent.model == nullptr) {
+          return;
+        }
+
+        const glm::mat4 &modelMatrix = transform.mat4();
+        if (needsSync(entity, transform.getVersion())) {
+          syncProxy(entity, transform.getVersion(),
+                    Aabb::transform(modelComponent.model->getBoundingBox(),
+                                    modelMatrix));
+        }
+      });
+
+  // Point light billboards are spheres with the x scale as their radius
+  registry.view<TransformComponent, PointLightComponent>().each(
+      [&](Entity entity, TransformComponent &transform,
+          PointLightComponent &) {
+        transform.mat4();
+        if (needsSync(entity, transform.getVersion())) {
+          const glm::vec3 &center = transform.getTranslation();
+          const glm::vec3 radius{transform.getScale().x};
+          syncProxy(entity, transform.getVersion(),
+                    Aabb{center - radius, center + radius});
+        }
+      });
+
+  // Entities that were destroyed or lost their components were not stamped
+  for (Proxy &proxy : proxies) {
+    if (proxy.node != NULL_NODE && proxy.stamp != updateStamp) {
+      remove(proxy.node);
+      proxy = Proxy{};
+    }
+  }
+
+  // A large batch of new leaves is cheaper to build than to insert one by one
+  reinsertsSinceRebuild += static_cast<std::uint32_t>(pendingLeaves.size());
+  if (reinsertsSinceRebuild > REBUILD_REINSERT_FRACTION * leafCount) {
+    rebuild();
+    return;
+  }
+
+  for (std::size_t i = 0; i < pendingLeaves.size(); i++) {
+    if (insertLeaf(pendingLeaves[i]) > MAX_DEPTH / 2) {
+      // The leaves not linked in yet are picked up by the rebuild
+      pendingLeaves.erase(pendingLeaves.begin(),
+                          pendingLeaves.begin() + i + 1);
+      rebuild();
+      return;
+    }
+  }
+  pendingLeaves.clear();
+}
+
+bool VlknBvh::rayEntry(const glm::vec3 &origin,
+                       const glm::vec3 &inverseDirection, const Aabb &bounds,
+                       float maxDistance, float &distance) {
+  const glm::vec3 t0 = (bounds.min - origin) * inverseDirection;
+  const glm::vec3 t1 = (bounds.max - origin) * inverseDirection;
+  const glm::vec3 tNear = glm::min(t0, t1);
+  const glm::vec3 tFar = glm::max(t0, t1);
+
+  const float enter = std::max({tNear.x, tNear.y, tNear.z, 0.0f});
+  const float exit = std::min({tFar.x, tFar.y, tFar.z});
+
+  if (enter > exit || enter > maxDistance) {
+    return false;
+  }
+
+  distance = enter;
+  return true;
+}
+
+Aabb VlknBvh::fatten(const Aabb &bounds) {
+  const glm::vec3 margin{FAT_MARGIN};
+  return Aabb{bounds.min - margin, bounds.max + margin};
+}
+
+std::uint32_t VlknBvh::allocateNode() {
+  if (freeList == NULL_NODE) {
+    nodes.emplace_back();
+    return static_cast<std::uint32_t>(nodes.size() - 1);
+  }
+
+  std::uint32_t node = freeList;
+  freeList = nodes[node].next;
+  nodes[node] = Node{};
+  return node;
+}
+
+std::uint32_t VlknBvh::createLeaf(Entity entity, const Aabb &bounds) {
+  std::uint32_t leaf = allocateNode();
+  nodes[leaf].bounds = fatten(bounds);
+  nodes[leaf].entity = entity;
+  leafCount++;
+  return leaf;
+}
+
+void VlknBvh::freeNode(std::uint32_t node) {
+  nodes[node] = Node{};
+  nodes[node].next = freeList;
+  freeList = node;
+}
+
+std::uint32_t VlknBvh::insertLeaf(std::uint32_t leaf) {
+  if (root == NULL_NODE) {
+    root = leaf;
+    nodes[leaf].parent = NULL_NODE;
+    return 0;
+  }
+
+  // Descend towards the sibling whose enlargement costs the least surface
+  // area, stopping once pairing with the current node is cheaper than going
+  // further down
+  const Aabb leafBounds = nodes[leaf].bounds;
+  std::uint32_t sibling = root;
+  std::uint32_t depth = 0;
+
+  while (!nodes[sibling].isLeaf()) {
+    const Node &node = nodes[sibling];
+
+    const float area = node.bounds.surfaceArea();
+    const float combinedArea =
+        Aabb::merge(node.bounds, leafBounds).surfaceArea();
+
+    const float pairCost = 2.0f * combinedArea;
+    // Every ancestor of the new parent grows by the same amount
+    const float inheritanceCost = 2.0f * (combinedArea - area);
+
+    auto descendCost = [&](std::uint32_t child) {
+      const Aabb &childBounds = nodes[child].bounds;
+      float cost =
+          Aabb::merge(childBounds, leafBounds).surfaceArea() + inheritanceCost;
+      if (!nodes[child].isLeaf()) {
+        cost -= childBounds.surfaceArea();
+      }
+      return cost;
+    };
+
+    const float cost0 = descendCost(node.children[0]);
+    const float cost1 = descendCost(node.children[1]);
+
+    if (pairCost < cost0 && pairCost < cost1) {
+      break;
+    }
+
+    sibling = cost0 < cost1 ? node.children[0] : node.children[1];
+    depth++;
+  }
+
+  const std::uint32_t oldParent = nodes[sibling].parent;
+  const std::uint32_t newParent = allocateNode();
+
+  nodes[newParent].parent = oldParent;
+  nodes[newParent].bounds = Aabb::merge(leafBounds, nodes[sibling].bounds);
+  nodes[newParent].children[0] = sibling;
+  nodes[newParent].children[1] = leaf;
+  nodes[sibling].parent = newParent;
+  nodes[leaf].parent = newParent;
+
+  if (oldParent == NULL_NODE) {
+    root = newParent;
+  } else {
+    Node &parent = nodes[oldParent];
+    parent.children[parent.children[0] == sibling ? 0 : 1] = newParent;
+    refitAncestors(oldParent);
+  }
+
+  return depth + 1;
+}
+
+void VlknBvh::removeLeaf(std::uint32_t leaf) {
+  if (leaf == root) {
+    root = NULL_NODE;
+    return;
+  }
+
+  const std::uint32_t parent = nodes[leaf].parent;
+  const std::uint32_t grandParent = nodes[parent].parent;
+  const std::uint32_t sibling = nodes[parent].children[0] == leaf
+                                    ? nodes[parent].children[1]
+                                    : nodes[parent].children[0];
+
+  nodes[sibling].parent = grandParent;
+  if (grandParent == NULL_NODE) {
+    root = sibling;
+  } else {
+    Node &node = nodes[grandParent];
+    node.children[node.children[0] == parent ? 0 : 1] = sibling;
+    refitAncestors(grandParent);
+  }
+
+  freeNode(parent);
+  nodes[leaf].parent = NULL_NODE;
+}
+
+void VlknBvh::refitAncestors(std::uint32_t node) {
+  while (node != NULL_NODE) {
+    Node &current = nodes[node];
+    current.bounds = Aabb::merge(nodes[current.children[0]].bounds,
+                                 nodes[current.children[1]].bounds);
+    node = current.parent;
+  }
+}
+
+std::uint32_t VlknBvh::buildRange(std::uint32_t begin, std::uint32_t end) {
+  if (end - begin == 1) {
+    return buildLeaves[begin].node;
+  }
+
+  Aabb centroidBounds{buildLeaves[begin].centroid,
+                      buildLeaves[begin].centroid};
+  for (std::uint32_t i = begin + 1; i < end; i++) {
+    const glm::vec3 &point = buildLeaves[i].centroid;
+    centroidBounds = Aabb::merge(centroidBounds, Aabb{point, point});
+  }
+
+  const glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+  int axis = 0;
+  if (extent.y > extent[axis]) {
+    axis = 1;
+  }
+  if (extent.z > extent[axis]) {
+    axis = 2;
+  }
+
+  std::uint32_t middle = begin + (end - begin) / 2;
+  bool split = false;
+
+  if (extent[axis] > 0.0f) {
+    struct Bin {
+      Aabb bounds{};
+      std::uint32_t count = 0;
+    };
+    std::array<Bin, SAH_BINS> bins{};
+
+    const float binScale = SAH_BINS / extent[axis];
+    auto binOf = [&](const BuildLeaf &leaf) {
+      const float offset = leaf.centroid[axis] - centroidBounds.min[axis];
+      return std::min(static_cast<std::uint32_t>(offset * binScale),
+                      SAH_BINS - 1);
+    };
+
+    for (std::uint32_t i = begin; i < end; i++) {
+      Bin &bin = bins[binOf(buildLeaves[i])];
+      const Aabb &bounds = buildLeaves[i].bounds;
+      bin.bounds = bin.count == 0 ? bounds : Aabb::merge(bin.bounds, bounds);
+      bin.count++;
+    }
+
+    // Cost of everything right of each split plane, swept from the right
+    std::array<float, SAH_BINS> rightCosts{};
+    Bin right{};
+    for (std::uint32_t plane = SAH_BINS - 1; plane > 0; plane--) {
+      const Bin &bin = bins[plane];
+      if (bin.count > 0) {
+        right.bounds = right.count == 0 ? bin.bounds
+                                        : Aabb::merge(right.bounds, bin.bounds);
+        right.count += bin.count;
+      }
+      rightCosts[plane] =
+          right.count == 0 ? 0.0f : right.bounds.surfaceArea() * right.count;
+    }
+
+    float bestCost = std::numeric_limits<float>::max();
+    std::uint32_t bestPlane = 0;
+    Bin left{};
+    for (std::uint32_t plane = 1; plane < SAH_BINS; plane++) {
+      const Bin &bin = bins[plane - 1];
+      if (bin.count > 0) {
+        left.bounds = left.count == 0 ? bin.bounds
+                                      : Aabb::merge(left.bounds, bin.bounds);
+        left.count += bin.count;
+      }
+
+      if (left.count == 0 || left.count == end - begin) {
+        continue;
+      }
+
+      const float cost =
+          left.bounds.surfaceArea() * left.count + rightCosts[plane];
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestPlane = plane;
+      }
+    }
+
+    if (bestPlane != 0) {
+      auto first = buildLeaves.begin() + begin;
+      auto last = buildLeaves.begin() + end;
+      middle = begin + static_cast<std::uint32_t>(std::distance(
+                           first, std::partition(first, last, [&](auto &leaf) {
+                             return binOf(leaf) < bestPlane;
+                           })));
+      split = true;
+    }
+  }
+
+  // All centroids in one bin, fall back to a median split
+  if (!split) {
+    std::nth_element(buildLeaves.begin() + begin, buildLeaves.begin() + middle,
+                     buildLeaves.begin() + end, [&](auto &a, auto &b) {
+                       return a.centroid[axis] < b.centroid[axis];
+                     });
+  }
+
+  const std::uint32_t leftChild = buildRange(begin, middle);
+  const std::uint32_t rightChild = buildRange(middle, end);
+  const std::uint32_t node = allocateNode();
+
+  nodes[node].children[0] = leftChild;
+  nodes[node].children[1] = rightChild;
+  nodes[node].bounds =
+      Aabb::merge(nodes[leftChild].bounds, nodes[rightChild].bounds);
+  nodes[leftChild].parent = node;
+  nodes[rightChild].parent = node;
+  return node;
+}
+
+bool VlknBvh::needsSync(Entity entity, std::uint32_t version) {
+  if (entity.index >= proxies.size()) {
+    proxies.resize(entity.index + 1);
+  }
+
+  // The slot may still hold the leaf of a destroyed entity
+  Proxy &proxy = proxies[entity.index];
+  if (proxy.node != NULL_NODE && proxy.entity != entity) {
+    remove(proxy.node);
+    proxy = Proxy{};
+  }
+
+  proxy.stamp = updateStamp;
+  return proxy.node == NULL_NODE || proxy.version != version;
+}
+
+void VlknBvh::syncProxy(Entity entity, std::uint32_t version,
+                        const Aabb &bounds) {
+  Proxy &proxy = proxies[entity.index];
+  proxy.entity = entity;
+  proxy.version = version;
+
+  if (proxy.node == NULL_NODE) {
+    proxy.node = createLeaf(entity, bounds);
+    pendingLeaves.push_back(proxy.node);
+  } else {
+    move(proxy.node, bounds);
+  }
+}
+
+} // namespace vlkn
@@ -0,0 +1,251 @@
+#pragma once
+
+// local
+#include "vlkn_model.hpp"
+#include "vlkn_registry.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace vlkn {
+
+// World space axis aligned bounding box
+struct Aabb {
+  glm::vec3 min{0.0f};
+  glm::vec3 max{0.0f};
+
+  // Bounds of a model space box after transformation by modelMatrix
+  static Aabb transform(const VlknModel::BoundingBox &box,
+                        const glm::mat4 &modelMatrix);
+
+  static Aabb merge(const Aabb &a, const Aabb &b) {
+    return Aabb{glm::min(a.min, b.min), glm::max(a.max, b.max)};
+  }
+
+  bool contains(const Aabb &other) const {
+    return glm::all(glm::lessThanEqual(min, other.min)) &&
+           glm::all(glm::greaterThanEqual(max, other.max));
+  }
+
+  bool overlaps(const Aabb &other) const {
+    return glm::all(glm::lessThanEqual(min, other.max)) &&
+           glm::all(glm::greaterThanEqual(max, other.min));
+  }
+
+  float surfaceArea() const {
+    const glm::vec3 extent = max - min;
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z +
+                   extent.z * extent.x);
+  }
+};
+
+// Six planes pointing inwards, extracted from a view projection matrix with
+// a zero to one depth range
+struct Frustum {
+  std::array<glm::vec4, 6> planes{};
+
+  static Frustum fromViewProjection(const glm::mat4 &viewProjection);
+
+  // Conservative, may report boxes near the frustum corners as intersecting
+  bool intersects(const Aabb &box) const;
+};
+
+// Dynamic bounding volume hierarchy over entity world bounds. Leaves store
+// bounds enlarged by FAT_MARGIN, so objects that move a little only need a
+// containment check. Objects leaving their fat bounds are removed and
+// reinserted where they add the least surface area, and the whole tree is
+// rebuilt top down with a binned surface area heuristic once enough leaves
+// were reinserted that the incremental tree has likely degraded.
+class VlknBvh {
+public:
+  static constexpr std::uint32_t NULL_NODE =
+      std::numeric_limits<std::uint32_t>::max();
+
+  static constexpr float FAT_MARGIN = 0.1f;
+  static constexpr std::uint32_t SAH_BINS = 16;
+
+  // Rebuild once this share of the leaves was reinserted since the last build
+  static constexpr float REBUILD_REINSERT_FRACTION = 0.25f;
+
+  // Inline traversal stack size, deeper trees spill the stack to the heap.
+  // Inserting a leaf deeper than half of it rebuilds the tree right away.
+  static constexpr std::uint32_t MAX_DEPTH = 64;
+
+  VlknBvh() = default;
+
+  VlknBvh(const VlknBvh &) = delete;
+  VlknBvh &operator=(const VlknBvh &) = delete;
+
+  // Returns the proxy of the new leaf, it stays valid until remove()
+  std::uint32_t insert(Entity entity, const Aabb &bounds);
+  void remove(std::uint32_t proxy);
+
+  // Returns true if the leaf left its fat bounds and was reinserted
+  bool move(std::uint32_t proxy, const Aabb &bounds);
+
+  // Top down binned SAH build over the current leaves. Proxies stay valid.
+  void rebuild();
+
+  // Keeps one leaf per entity with a transform and a model or point light in
+  // sync with the registry, then rebuilds if the tree has degraded. Only
+  // entities whose transform changed since the last call are refitted.
+  void update(VlknRegistry &registry);
+
+  Entity getEntity(std::uint32_t proxy) const { return nodes[proxy].entity; }
+  const Aabb &getFatBounds(std::uint32_t proxy) const {
+    return nodes[proxy].bounds;
+  }
+  std::uint32_t getLeafCount() const { return leafCount; }
+
+  // Each query calls f(entity) for every leaf whose fat bounds pass the test
+  template <typename F> void queryAabb(const Aabb &box, F &&f) const {
+    traverse([&](const Aabb &bounds) { return bounds.overlaps(box); }, f);
+  }
+
+  template <typename F>
+  void querySphere(const glm::vec3 &center, float radius, F &&f) const {
+    const float radiusSquared = radius * radius;
+    traverse(
+        [&](const Aabb &bounds) {
+          const glm::vec3 offset =
+              center - glm::clamp(center, bounds.min, bounds.max);
+          return glm::dot(offset, offset) <= radiusSquared;
+        },
+        f);
+  }
+
+  template <typename F>
+  void queryFrustum(const Frustum &frustum, F &&f) const {
+    traverse([&](const Aabb &bounds) { return frustum.intersects(bounds); },
+             f);
+  }
+
+  // Calls f(entity, distance) for leaves hit within maxDistance, where
+  // distance is where the ray enters the fat bounds. f returns the new
+  // maximum distance, so returning distance finds the nearest hit and
+  // returning 0 stops the query.
+  template <typename F>
+  void raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+               float maxDistance, F &&f) const {
+    const glm::vec3 inverseDirection = 1.0f / direction;
+    float distance = 0.0f;
+
+    traverse(
+        [&](const Aabb &bounds) {
+          return rayEntry(origin, inverseDirection, bounds, maxDistance,
+                          distance);
+        },
+        [&](Entity entity) { maxDistance = f(entity, distance); });
+  }
+
+private:
+  struct Node {
+    Aabb bounds{};
+    std::uint32_t parent = NULL_NODE;
+    std::uint32_t children[2] = {NULL_NODE, NULL_NODE};
+    // Also links free nodes together
+    std::uint32_t next = NULL_NODE;
+    Entity entity = NULL_ENTITY;
+
+    bool isLeaf() const { return children[0] == NULL_NODE; }
+  };
+
+  // Registry entity bookkeeping for update(), indexed by entity index
+  struct Proxy {
+    Entity entity = NULL_ENTITY;
+    std::uint32_t node = NULL_NODE;
+    std::uint32_t version = 0;
+    std::uint32_t stamp = 0;
+  };
+
+  template <typename Test, typename F>
+  void traverse(const Test &test, F &&f) const {
+    if (root == NULL_NODE) {
+      return;
+    }
+
+    // A rebuild does not bound the depth, a skewed tree may outgrow the
+    // inline stack
+    std::uint32_t inlineStack[MAX_DEPTH];
+    std::vector<std::uint32_t> heapStack{};
+    std::uint32_t *stack = inlineStack;
+    std::uint32_t capacity = MAX_DEPTH;
+    std::uint32_t stackSize = 0;
+    stack[stackSize++] = root;
+
+    while (stackSize > 0) {
+      const Node &node = nodes[stack[--stackSize]];
+      if (!test(node.bounds)) {
+        continue;
+      }
+
+      if (node.isLeaf()) {
+        f(node.entity);
+      } else {
+        if (stackSize + 2 > capacity) {
+          capacity *= 2;
+          heapStack.resize(capacity);
+          if (stack == inlineStack) {
+            std::copy(inlineStack, inlineStack + stackSize, heapStack.begin());
+          }
+          stack = heapStack.data();
+        }
+        stack[stackSize++] = node.children[1];
+        stack[stackSize++] = node.children[0];
+      }
+    }
+  }
+
+  static bool rayEntry(const glm::vec3 &origin,
+                       const glm::vec3 &inverseDirection, const Aabb &bounds,
+                       float maxDistance, float &distance);
+  static Aabb fatten(const Aabb &bounds);
+
+  std::uint32_t allocateNode();
+  // Leaf that is not linked into the tree yet
+  std::uint32_t createLeaf(Entity entity, const Aabb &bounds);
+  void freeNode(std::uint32_t node);
+  // Returns the depth the leaf was inserted at
+  std::uint32_t insertLeaf(std::uint32_t leaf);
+  void removeLeaf(std::uint32_t leaf);
+  void refitAncestors(std::uint32_t node);
+  std::uint32_t buildRange(std::uint32_t begin, std::uint32_t end);
+
+  // Stamps the entity's leaf and returns false if it is already up to date
+  // with the transform version
+  bool needsSync(Entity entity, std::uint32_t version);
+  void syncProxy(Entity entity, std::uint32_t version, const Aabb &bounds);
+
+  std::vector<Node> nodes{};
+  std::uint32_t freeList = NULL_NODE;
+  std::uint32_t root = NULL_NODE;
+  std::uint32_t leafCount = 0;
+
+  std::uint32_t reinsertsSinceRebuild = 0;
+
+  // Leaf copies partitioned by rebuild(), kept contiguous so the build does
+  // not chase leaves across the node array
+  struct BuildLeaf {
+    Aabb bounds{};
+    glm::vec3 centroid{0.0f};
+    std::uint32_t node = NULL_NODE;
+  };
+  std::vector<BuildLeaf> buildLeaves{};
+
+  std::vector<Proxy> proxies{};
+  // Leaves created by update(), linked in one go once all entities are synced
+  std::vector<std::uint32_t> pendingLeaves{};
+  std::uint32_t updateStamp = 0;
+};
+
+} // namespace vlkn
@@ -19,6 +19,8 @@ void VlknCamera::setOrthographicProjection(float left, float right, float top,
                                            float bottom, float near,
                                            float far) {
   projectionMatrix = glm::ortho(left, right, bottom, top, near, far);
+  nearPlane = near;
+  farPlane = far;
 }
 
 void VlknCamera::setPerspectiveProjection(float fovy, float aspect, float near,
@@ -26,6 +28,8 @@ void VlknCamera::setPerspectiveProjection(float fovy, float aspect, float near,
   assert(glm::abs(aspect) >
          std::numeric_limits<decltype(glm::abs(aspect))>::epsilon());
   projectionMatrix = glm::perspective(fovy, aspect, near, far);
+  nearPlane = near;
+  farPlane = far;
 }
 
 void VlknCamera::setViewDirection(glm::vec3 position, glm::vec3 direction,
@@ -29,11 +29,15 @@ public:
   const glm::vec3 getPosition() const {
     return glm::vec3(inverseViewMatrix[3]);
   }
+  float getNear() const { return nearPlane; }
+  float getFar() const { return farPlane; }
 
 private:
   glm::mat4 projectionMatrix{1.0f};
   glm::mat4 viewMatrix{1.0f};
   glm::mat4 inverseViewMatrix{1.0f};
+  float nearPlane = 0.1f;
+  float farPlane = 100.0f;
 };
 
 } // namespace vlkn
@@ -0,0 +1,172 @@
+// header
+#include "vlkn_command_recorder.hpp"
+
+// local
+#include "vlkn_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace vlkn {
+
+VlknCommandRecorder::VlknCommandRecorder(VlknDevice &device,
+                                         VlknRenderer &renderer,
+                                         VlknThreadPool &threadPool)
+    : vlknDevice(device), vlknRenderer(renderer), threadPool(threadPool),
+      slotCount(threadPool.getThreadCount() + 1 + MAX_SUBPASSES) {
+  createFrameResources();
+}
+
+VlknCommandRecorder::~VlknCommandRecorder() {
+  for (FrameResources &frame : frames) {
+    for (VkCommandPool commandPool : frame.commandPools) {
+      vkDestroyCommandPool(vlknDevice.device(), commandPool, nullptr);
+    }
+  }
+}
+
+void VlknCommandRecorder::createFrameResources() {
+  QueueFamilyIndices queueFamilyIndices =
+      vlknDevice.findPhysicalQueueFamilies();
+
+  frames.resize(vlknRenderer.getFramesInFlight());
+
+  for (FrameResources &frame : frames) {
+    frame.commandPools.resize(slotCount);
+    frame.commandBuffers.resize(slotCount);
+
+    for (std::uint32_t slot = 0; slot < slotCount; slot++) {
+      VkCommandPoolCreateInfo poolInfo{};
+      poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+      poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+      if (vkCreateCommandPool(vlknDevice.device(), &poolInfo, nullptr,
+                              &frame.commandPools[slot]) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create command pool");
+      }
+
+      VkCommandBufferAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      allocInfo.commandPool = frame.commandPools[slot];
+      allocInfo.commandBufferCount = 1;
+
+      if (vkAllocateCommandBuffers(vlknDevice.device(), &allocInfo,
+                                   &frame.commandBuffers[slot]) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate command buffers");
+      }
+    }
+  }
+}
+
+void VlknCommandRecorder::beginFrame() {
+  frameIndex = vlknRenderer.getFrameIndex();
+  nextSlot = 0;
+  for (std::vector<VkCommandBuffer> &buffers : recordedBuffers) {
+    buffers.clear();
+  }
+
+  for (VkCommandPool commandPool : frames[frameIndex].commandPools) {
+    vkResetCommandPool(vlknDevice.device(), commandPool, 0);
+  }
+
+  inheritanceInfo = VkCommandBufferInheritanceInfo{};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = vlknRenderer.getSwapChainRenderPass();
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = vlknRenderer.getCurrentFramebuffer();
+  currentSubpass = 0;
+}
+
+void VlknCommandRecorder::setSubpass(std::uint32_t subpass) {
+  assert(subpass < MAX_SUBPASSES && "Subpass exceeds MAX_SUBPASSES");
+  inheritanceInfo.subpass = subpass;
+  currentSubpass = subpass;
+}
+
+void VlknCommandRecorder::recordQueue(const VlknRenderQueue &renderQueue,
+                                      std::size_t first, std::size_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  // Keep the last slots free for the overlays
+  assert(nextSlot < slotCount - MAX_SUBPASSES &&
+         "No recording slot left in this frame");
+  const std::size_t freeSlots = slotCount - MAX_SUBPASSES - nextSlot;
+  const std::size_t rangeCount = std::clamp<std::size_t>(
+      count / MIN_PACKETS_PER_BUFFER, 1, freeSlots);
+  const std::size_t rangeSize = (count + rangeCount - 1) / rangeCount;
+
+  const std::uint32_t firstSlot = nextSlot;
+  const std::vector<VkCommandBuffer> &commandBuffers =
+      frames[frameIndex].commandBuffers;
+
+  threadPool.parallelFor(
+      static_cast<std::uint32_t>(rangeCount), [&](std::uint32_t range) {
+        const std::size_t offset = range * rangeSize;
+        VkCommandBuffer commandBuffer = commandBuffers[firstSlot + range];
+
+        beginSecondary(commandBuffer);
+        renderQueue.submit(commandBuffer, first + offset,
+                           std::min(rangeSize, count - offset));
+        endSecondary(commandBuffer);
+      });
+
+  for (std::size_t range = 0; range < rangeCount; range++) {
+    recordedBuffers[currentSubpass].push_back(
+        commandBuffers[firstSlot + range]);
+  }
+  nextSlot += static_cast<std::uint32_t>(rangeCount);
+}
+
+void VlknCommandRecorder::recordOverlay(
+    const std::function<void(VkCommandBuffer)> &record) {
+  VkCommandBuffer commandBuffer =
+      frames[frameIndex]
+          .commandBuffers[slotCount - MAX_SUBPASSES + currentSubpass];
+
+  beginSecondary(commandBuffer);
+  record(commandBuffer);
+  endSecondary(commandBuffer);
+
+  recordedBuffers[currentSubpass].push_back(commandBuffer);
+}
+
+void VlknCommandRecorder::executeCommands(VkCommandBuffer primaryCommandBuffer,
+                                          std::uint32_t subpass) {
+  const std::vector<VkCommandBuffer> &buffers = recordedBuffers[subpass];
+  if (buffers.empty()) {
+    return;
+  }
+
+  vkCmdExecuteCommands(primaryCommandBuffer,
+                       static_cast<std::uint32_t>(buffers.size()),
+                       buffers.data());
+}
+
+void VlknCommandRecorder::beginSecondary(VkCommandBuffer commandBuffer) {
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin secondary command buffer");
+  }
+
+  vlknRenderer.setViewportAndScissor(commandBuffer);
+}
+
+void VlknCommandRecorder::endSecondary(VkCommandBuffer commandBuffer) {
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record secondary command buffer");
+  }
+}
+
+} // namespace vlkn
@@ -0,0 +1,90 @@
+#pragma once
+
+// local
+#include "vlkn_device.hpp"
+#include "vlkn_render_queue.hpp"
+#include "vlkn_renderer.hpp"
+#include "vlkn_thread_pool.hpp"
+
+// libs
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace vlkn {
+
+// Records the render queue into secondary command buffers on the thread pool.
+// Every recording slot owns one command pool per frame in flight, so slots
+// never share a pool and a whole frame is recycled with vkResetCommandPool.
+class VlknCommandRecorder {
+public:
+  // Smaller ranges are not worth a command buffer of their own
+  static constexpr std::size_t MIN_PACKETS_PER_BUFFER = 64;
+  // Geometry, lighting, transparent and composite subpasses
+  static constexpr std::uint32_t MAX_SUBPASSES = 4;
+
+  VlknCommandRecorder(VlknDevice &device, VlknRenderer &renderer,
+                      VlknThreadPool &threadPool);
+  ~VlknCommandRecorder();
+
+  VlknCommandRecorder(const VlknCommandRecorder &) = delete;
+  VlknCommandRecorder &operator=(const VlknCommandRecorder &) = delete;
+
+  // Must be called after VlknRenderer::beginFrame, which waited for the
+  // last frame that used the frame index
+  void beginFrame();
+
+  // Buffers recorded from here on continue the given subpass of the swap
+  // chain render pass. beginFrame starts at subpass 0.
+  void setSubpass(std::uint32_t subpass);
+
+  // Splits the sorted packets into contiguous ranges and records each range
+  // on its own worker. Submission order is kept by executeCommands.
+  void recordQueue(const VlknRenderQueue &renderQueue) {
+    recordQueue(renderQueue, 0, renderQueue.size());
+  }
+  void recordQueue(const VlknRenderQueue &renderQueue, std::size_t first,
+                   std::size_t count);
+
+  // Records into one more secondary buffer on the calling thread, for work
+  // that is not thread safe such as ImGui. Each subpass has one overlay
+  // buffer.
+  void recordOverlay(const std::function<void(VkCommandBuffer)> &record);
+
+  // Executes everything recorded this frame for the subpass inside a subpass
+  // begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+  void executeCommands(VkCommandBuffer primaryCommandBuffer,
+                       std::uint32_t subpass = 0);
+
+private:
+  struct FrameResources {
+    std::vector<VkCommandPool> commandPools{};
+    std::vector<VkCommandBuffer> commandBuffers{};
+  };
+
+  void createFrameResources();
+  void beginSecondary(VkCommandBuffer commandBuffer);
+  void endSecondary(VkCommandBuffer commandBuffer);
+
+  VlknDevice &vlknDevice;
+  VlknRenderer &vlknRenderer;
+  VlknThreadPool &threadPool;
+
+  // One slot per thread taking part in parallelFor plus one overlay slot per
+  // subpass
+  std::uint32_t slotCount;
+  std::vector<FrameResources> frames{};
+
+  VkCommandBufferInheritanceInfo inheritanceInfo{};
+  std::uint32_t frameIndex = 0;
+  std::uint32_t nextSlot = 0;
+  std::uint32_t currentSubpass = 0;
+  std::array<std::vector<VkCommandBuffer>, MAX_SUBPASSES> recordedBuffers{};
+};
+
+} // namespace vlkn
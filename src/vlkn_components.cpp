@@ -0,0 +1,63 @@
+// header
+#include "vlkn_components.hpp"
+
+namespace vlkn {
+
+const glm::mat4 &TransformComponent::mat4() {
+  if (dirty) {
+    updateMatrices();
+  }
+  return worldMatrix;
+}
+
+const glm::mat3 &TransformComponent::normalMatrix() {
+  if (dirty) {
+    updateMatrices();
+  }
+  return normalMat;
+}
+
+void TransformComponent::setParentMatrices(const glm::mat4 &matrix,
+                                           const glm::mat3 &normal) {
+  parentMatrix = matrix;
+  parentNormalMatrix = normal;
+  parented = true;
+  dirty = true;
+}
+
+void TransformComponent::clearParent() {
+  parentMatrix = glm::mat4(1.0f);
+  parentNormalMatrix = glm::mat3(1.0f);
+  parented = false;
+  dirty = true;
+}
+
+void TransformComponent::updateMatrices() {
+  // The local matrix is scale * rotation * translation, so its upper-left
+  // 3x3 part is S * R and the translation column is S * R * t
+  const glm::mat3 rotationMatrix = glm::mat3_cast(rotation);
+
+  worldMatrix = glm::mat4(1.0f);
+  for (int column = 0; column < 3; column++) {
+    worldMatrix[column] = glm::vec4(scale * rotationMatrix[column], 0.0f);
+  }
+  worldMatrix[3] = glm::vec4(scale * (rotationMatrix * translation), 1.0f);
+
+  // transpose(inverse(S * R)) = S^-1 * R for a diagonal S and orthonormal R,
+  // so no general inverse is needed
+  const glm::vec3 inverseScale = 1.0f / scale;
+  for (int column = 0; column < 3; column++) {
+    normalMat[column] = inverseScale * rotationMatrix[column];
+  }
+
+  // transpose(inverse(P * L)) = transpose(inverse(P)) * transpose(inverse(L))
+  if (parented) {
+    worldMatrix = parentMatrix * worldMatrix;
+    normalMat = parentNormalMatrix * normalMat;
+  }
+
+  version++;
+  dirty = false;
+}
+
+} // namespace vlkn
@@ -0,0 +1,128 @@
+#pragma once
+
+// local
+#include "vlkn_model.hpp"
+
+// lib
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace vlkn {
+
+// Local translation, rotation and scale with cached world and normal
+// matrices. Setters mark the cache dirty; VlknTransformBatch refreshes dirty
+// root transforms in bulk, VlknTransformHierarchy refreshes parented ones and
+// the matrix getters fall back to a scalar update.
+//
+// For a parented transform the world matrix is the parent's world matrix
+// times the local one. The parent's matrices are copied in by the hierarchy,
+// so the component never has to look up its parent.
+class TransformComponent {
+public:
+  const glm::vec3 &getTranslation() const { return translation; }
+  const glm::vec3 &getScale() const { return scale; }
+  const glm::quat &getRotation() const { return rotation; }
+
+  void setTranslation(const glm::vec3 &value) {
+    translation = value;
+    dirty = true;
+  }
+
+  void setScale(const glm::vec3 &value) {
+    scale = value;
+    dirty = true;
+  }
+
+  void setRotation(const glm::quat &value) {
+    rotation = value;
+    dirty = true;
+  }
+
+  bool isDirty() const { return dirty; }
+  bool hasParent() const { return parented; }
+
+  // Incremented every time the world matrices are recomputed
+  std::uint32_t getVersion() const { return version; }
+
+  const glm::mat4 &mat4();
+  const glm::mat3 &normalMatrix();
+
+private:
+  friend class VlknTransformBatch;
+  friend class VlknTransformHierarchy;
+
+  void setParentMatrices(const glm::mat4 &matrix, const glm::mat3 &normal);
+  void clearParent();
+  void updateMatrices();
+
+  glm::vec3 translation{};
+  glm::vec3 scale{1.0f, 1.0f, 1.0f};
+  glm::quat rotation{};
+
+  glm::mat4 worldMatrix{1.0f};
+  glm::mat3 normalMat{1.0f};
+  std::uint32_t version = 0;
+  bool dirty = true;
+
+  glm::mat4 parentMatrix{1.0f};
+  glm::mat3 parentNormalMatrix{1.0f};
+  bool parented = false;
+};
+
+struct PointLightComponent {
+  float lightIntensity = 1.0f;
+  glm::vec3 color{1.0f};
+};
+
+// Point light animated on the GPU by VlknLightAnimator instead of through a
+// transform. The light orbits orbitCenter, starting at orbitCenter +
+// orbitOffset, and its intensity is the PointLightComponent intensity plus a
+// sine wave, scaled by a periodic curve sampled at evenly spaced points.
+//
+// The parameters live on the GPU. Set dirty after editing them or the
+// light's PointLightComponent, VlknLightAnimator then uploads them again.
+struct LightAnimationComponent {
+  static constexpr std::size_t CURVE_SAMPLES = 8;
+
+  glm::vec3 orbitCenter{0.0f};
+  glm::vec3 orbitOffset{1.0f, 0.0f, 0.0f};
+  glm::vec3 orbitAxis{0.0f, -1.0f, 0.0f};
+  // Radians per second
+  float orbitSpeed = 1.0f;
+  float phase = 0.0f;
+
+  float waveAmplitude = 0.0f;
+  // Radians per second
+  float waveFrequency = 1.0f;
+
+  // Seconds per curve cycle
+  float curvePeriod = 1.0f;
+  std::array<float, CURVE_SAMPLES> intensityCurve{1.0f, 1.0f, 1.0f, 1.0f,
+                                                  1.0f, 1.0f, 1.0f, 1.0f};
+
+  float billboardRadius = 0.1f;
+
+  bool dirty = true;
+};
+
+struct ModelComponent {
+  std::shared_ptr<VlknModel> model = nullptr;
+  std::int32_t imgIdx = 0;
+  // Models below 1 are drawn in the order independent transparent pass
+  float opacity = 1.0f;
+};
+
+// Tag for entities whose model is rasterized into the software occlusion
+// buffer
+struct OccluderComponent {};
+
+} // namespace vlkn
@@ -0,0 +1,38 @@
+// header
+#include "vlkn_deletion_queue.hpp"
+
+// std
+#include <cassert>
+#include <utility>
+
+namespace vlkn {
+
+VlknDeletionQueue::~VlknDeletionQueue() { flush(); }
+
+void VlknDeletionQueue::push(std::uint64_t submittedFrames, Deleter deleter) {
+  assert((entries.empty() ||
+          entries.back().submittedFrames <= submittedFrames) &&
+         "Objects have to be retired in frame order");
+
+  entries.push_back({submittedFrames, std::move(deleter)});
+}
+
+void VlknDeletionQueue::collect(std::uint64_t completedFrames) {
+  while (!entries.empty() &&
+         entries.front().submittedFrames <= completedFrames) {
+    // Popped first, so a deleter may retire further objects
+    Deleter deleter = std::move(entries.front().deleter);
+    entries.pop_front();
+    deleter();
+  }
+}
+
+void VlknDeletionQueue::flush() {
+  while (!entries.empty()) {
+    Deleter deleter = std::move(entries.front().deleter);
+    entries.pop_front();
+    deleter();
+  }
+}
+
+} // namespace vlkn
@@ -0,0 +1,44 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace vlkn {
+
+// Destroys objects once the frames that may still use them have finished,
+// instead of idling the device. Every deleter is tagged with the number of
+// frames submitted when the object was retired, and runs once the last of
+// those frames has finished.
+class VlknDeletionQueue {
+public:
+  using Deleter = std::function<void()>;
+
+  VlknDeletionQueue() = default;
+  ~VlknDeletionQueue();
+
+  VlknDeletionQueue(const VlknDeletionQueue &) = delete;
+  VlknDeletionQueue &operator=(const VlknDeletionQueue &) = delete;
+
+  // Frames up to submittedFrames - 1 may still use the object
+  void push(std::uint64_t submittedFrames, Deleter deleter);
+  // Runs the deleters of every object the first completedFrames frames were
+  // the last users of, in the order they were pushed
+  void collect(std::uint64_t completedFrames);
+  // Runs every deleter, the device has to be idle
+  void flush();
+
+  bool empty() const { return entries.empty(); }
+
+private:
+  struct Entry {
+    std::uint64_t submittedFrames;
+    Deleter deleter;
+  };
+
+  // Ordered by submittedFrames, as frames only ever get submitted
+  std::deque<Entry> entries{};
+};
+
+} // namespace vlkn
@@ -1,7 +1,13 @@
 #include "vlkn_device.hpp"
 
+#include <algorithm>
+#include <bit>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <set>
 #include <string>
 #include <unordered_set>
@@ -9,6 +15,19 @@
 
 namespace vlkn {
 
+namespace {
+
+// Written ahead of the driver's cache data in PIPELINE_CACHE_PATH
+struct PipelineCachePrefix {
+  uint32_t magic;
+  uint32_t driverVersion;
+  uint8_t driverUUID[VK_UUID_SIZE];
+};
+
+constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x4e4b4c56; // "VLKN"
+
+} // namespace
+
 static VKAPI_ATTR VkBool32 VKAPI_CALL
 debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
               VkDebugUtilsMessageTypeFlagsEXT messageType,
@@ -87,9 +106,17 @@ VlknDevice::VlknDevice(VlknWindow &window) : window{window} {
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  loadDeviceFunctions();
+  createGraphicsTimeline();
+  createPipelineCache();
+  shaderModuleCache_ = std::make_unique<VlknShaderModuleCache>(device_);
 }
 
 VlknDevice::~VlknDevice() {
+  shaderModuleCache_.reset();
+  savePipelineCache();
+  vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
+  vkDestroySemaphore(device_, graphicsTimeline_, nullptr);
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -112,7 +139,17 @@ void VlknDevice::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  // A Vulkan 1.0 loader has no vkEnumerateInstanceVersion and fails on any
+  // higher version
+  auto enumerateInstanceVersion =
+      (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(
+          nullptr, "vkEnumerateInstanceVersion");
+  if (enumerateInstanceVersion != nullptr) {
+    uint32_t loaderVersion = VK_API_VERSION_1_0;
+    enumerateInstanceVersion(&loaderVersion);
+    instanceApiVersion = std::min(loaderVersion, VK_API_VERSION_1_3);
+  }
+  appInfo.apiVersion = instanceApiVersion;
 
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -165,6 +202,21 @@ void VlknDevice::pickPhysicalDevice() {
 
   vkGetPhysicalDeviceProperties(physicalDevice, &properties);
   std::cout << "physical device: " << properties.deviceName << std::endl;
+
+  // Suitable devices support Vulkan 1.2, so the query is always there
+  auto getProperties2 =
+      (PFN_vkGetPhysicalDeviceProperties2)vkGetInstanceProcAddr(
+          instance, "vkGetPhysicalDeviceProperties2");
+  VkPhysicalDeviceIDProperties idProperties{};
+  idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+  VkPhysicalDeviceProperties2 properties2{};
+  properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties2.pNext = &idProperties;
+  getProperties2(physicalDevice, &properties2);
+  std::memcpy(driverUUID, idProperties.driverUUID, VK_UUID_SIZE);
+
+  dynamicRenderingSupported = checkDynamicRenderingSupport(physicalDevice);
+  presentWaitSupported = checkPresentWaitSupport(physicalDevice);
 }
 
 void VlknDevice::createLogicalDevice() {
@@ -186,6 +238,9 @@ void VlknDevice::createLogicalDevice() {
 
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  // Transparency accumulates and multiplies into two targets with different
+  // blend factors
+  deviceFeatures.independentBlend = VK_TRUE;
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -195,9 +250,43 @@ void VlknDevice::createLogicalDevice() {
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount =
-      static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+  // Every suitable device supports timeline semaphores
+  VkPhysicalDeviceVulkan12Features vulkan12Features{};
+  vulkan12Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12Features.timelineSemaphore = VK_TRUE;
+  createInfo.pNext = &vulkan12Features;
+
+  VkPhysicalDeviceVulkan13Features vulkan13Features{};
+  vulkan13Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+  vulkan13Features.dynamicRendering = VK_TRUE;
+
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+  presentIdFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  presentIdFeatures.presentId = VK_TRUE;
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+  presentWaitFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  presentWaitFeatures.presentWait = VK_TRUE;
+
+  std::vector<const char *> extensions = deviceExtensions;
+  void **next = &vulkan12Features.pNext;
+  if (dynamicRenderingSupported) {
+    *next = &vulkan13Features;
+    next = &vulkan13Features.pNext;
+  }
+  if (presentWaitSupported) {
+    *next = &presentIdFeatures;
+    presentIdFeatures.pNext = &presentWaitFeatures;
+    extensions.insert(extensions.end(), presentWaitExtensions.begin(),
+                      presentWaitExtensions.end());
+  }
+
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
 
   if (enableValidationLayers) {
     createInfo.enabledLayerCount =
@@ -231,6 +320,186 @@ void VlknDevice::createCommandPool() {
   }
 }
 
+void VlknDevice::loadDeviceFunctions() {
+  vkWaitSemaphores_ =
+      (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device_, "vkWaitSemaphores");
+  vkGetSemaphoreCounterValue_ =
+      (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(
+          device_, "vkGetSemaphoreCounterValue");
+
+  if (vkWaitSemaphores_ == nullptr || vkGetSemaphoreCounterValue_ == nullptr) {
+    throw std::runtime_error("failed to load timeline semaphore functions!");
+  }
+
+  if (presentWaitSupported) {
+    vkWaitForPresentKHR_ = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(
+        device_, "vkWaitForPresentKHR");
+    if (vkWaitForPresentKHR_ == nullptr) {
+      throw std::runtime_error("failed to load vkWaitForPresentKHR!");
+    }
+  }
+
+  if (!dynamicRenderingSupported) {
+    return;
+  }
+
+  vkCmdBeginRendering_ = (PFN_vkCmdBeginRendering)vkGetDeviceProcAddr(
+      device_, "vkCmdBeginRendering");
+  vkCmdEndRendering_ =
+      (PFN_vkCmdEndRendering)vkGetDeviceProcAddr(device_, "vkCmdEndRendering");
+
+  if (vkCmdBeginRendering_ == nullptr || vkCmdEndRendering_ == nullptr) {
+    throw std::runtime_error("failed to load dynamic rendering functions!");
+  }
+}
+
+void VlknDevice::cmdBeginRendering(VkCommandBuffer commandBuffer,
+                                   const VkRenderingInfo &renderingInfo) {
+  vkCmdBeginRendering_(commandBuffer, &renderingInfo);
+}
+
+void VlknDevice::cmdEndRendering(VkCommandBuffer commandBuffer) {
+  vkCmdEndRendering_(commandBuffer);
+}
+
+VkResult VlknDevice::waitForPresent(VkSwapchainKHR swapChain,
+                                    uint64_t presentId, uint64_t timeout) {
+  return vkWaitForPresentKHR_(device_, swapChain, presentId, timeout);
+}
+
+void VlknDevice::createGraphicsTimeline() {
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+
+  if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr,
+                        &graphicsTimeline_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create timeline semaphore!");
+  }
+}
+
+uint64_t VlknDevice::getGraphicsTimelineValue() {
+  uint64_t value = 0;
+  if (vkGetSemaphoreCounterValue_(device_, graphicsTimeline_, &value) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to read timeline semaphore!");
+  }
+  return value;
+}
+
+void VlknDevice::waitGraphicsTimeline(uint64_t value) {
+  VkSemaphoreWaitInfo waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &graphicsTimeline_;
+  waitInfo.pValues = &value;
+
+  if (vkWaitSemaphores_(device_, &waitInfo,
+                        std::numeric_limits<uint64_t>::max()) != VK_SUCCESS) {
+    throw std::runtime_error("failed to wait for timeline semaphore!");
+  }
+}
+
+void VlknDevice::createPipelineCache() {
+  std::vector<char> data{};
+  std::ifstream file{PIPELINE_CACHE_PATH, std::ios::ate | std::ios::binary};
+  if (file.is_open()) {
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!file.good()) {
+      data.clear();
+    }
+  }
+
+  // Data of another device or driver version is dropped, drivers are not
+  // required to reject it themselves
+  if (!data.empty() && !isPipelineCacheCompatible(data)) {
+    std::cout << "pipeline cache: discarding data of another device or driver"
+              << std::endl;
+    data.clear();
+  }
+  if (!data.empty()) {
+    data.erase(data.begin(), data.begin() + sizeof(PipelineCachePrefix));
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = data.size();
+  cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+
+  loadedPipelineCacheSize = data.size();
+}
+
+bool VlknDevice::isPipelineCacheCompatible(const std::vector<char> &data) {
+  PipelineCachePrefix prefix{};
+  VkPipelineCacheHeaderVersionOne header{};
+  if (data.size() < sizeof(prefix) + sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&prefix, data.data(), sizeof(prefix));
+  std::memcpy(&header, data.data() + sizeof(prefix), sizeof(header));
+
+  return prefix.magic == PIPELINE_CACHE_MAGIC &&
+         prefix.driverVersion == properties.driverVersion &&
+         std::memcmp(prefix.driverUUID, driverUUID, VK_UUID_SIZE) == 0 &&
+         header.headerSize >= sizeof(header) &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == properties.vendorID &&
+         header.deviceID == properties.deviceID &&
+         std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+                     VK_UUID_SIZE) == 0;
+}
+
+void VlknDevice::savePipelineCache() {
+  size_t size = 0;
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &size, nullptr) !=
+          VK_SUCCESS ||
+      size == 0) {
+    return;
+  }
+
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &size, data.data()) !=
+      VK_SUCCESS) {
+    return;
+  }
+
+  // Written next to the cache and renamed over it, so an interrupted write
+  // never leaves a truncated cache behind
+  const std::string tempPath = std::string(PIPELINE_CACHE_PATH) + ".tmp";
+  {
+    PipelineCachePrefix prefix{};
+    prefix.magic = PIPELINE_CACHE_MAGIC;
+    prefix.driverVersion = properties.driverVersion;
+    std::memcpy(prefix.driverUUID, driverUUID, VK_UUID_SIZE);
+
+    std::ofstream file{tempPath, std::ios::binary | std::ios::trunc};
+    file.write(reinterpret_cast<const char *>(&prefix), sizeof(prefix));
+    file.write(data.data(), static_cast<std::streamsize>(size));
+    if (!file.good()) {
+      std::cerr << "failed to write pipeline cache: " << tempPath << '\n';
+      return;
+    }
+  }
+
+  std::error_code error{};
+  std::filesystem::rename(tempPath, PIPELINE_CACHE_PATH, error);
+  if (error) {
+    std::cerr << "failed to save pipeline cache: " << error.message() << '\n';
+  }
+}
+
 void VlknDevice::createSurface() {
   window.createWindowSurface(instance, &surface_);
 }
@@ -251,7 +520,100 @@ bool VlknDevice::isDeviceSuitable(VkPhysicalDevice device) {
   vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
   return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-         supportedFeatures.samplerAnisotropy;
+         supportedFeatures.samplerAnisotropy &&
+         supportedFeatures.independentBlend &&
+         checkTimelineSemaphoreSupport(device);
+}
+
+bool VlknDevice::checkPresentWaitSupport(VkPhysicalDevice device) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       availableExtensions.data());
+
+  std::set<std::string> missingExtensions(presentWaitExtensions.begin(),
+                                          presentWaitExtensions.end());
+
+  for (const auto &extension : availableExtensions) {
+    missingExtensions.erase(extension.extensionName);
+  }
+
+  if (!missingExtensions.empty()) {
+    return false;
+  }
+
+  // Suitable devices support Vulkan 1.2, so the query is always there
+  auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(
+      instance, "vkGetPhysicalDeviceFeatures2");
+
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+  presentWaitFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+  presentIdFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  presentIdFeatures.pNext = &presentWaitFeatures;
+  VkPhysicalDeviceFeatures2 features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &presentIdFeatures;
+  getFeatures2(device, &features);
+
+  return presentIdFeatures.presentId == VK_TRUE &&
+         presentWaitFeatures.presentWait == VK_TRUE;
+}
+
+bool VlknDevice::checkTimelineSemaphoreSupport(VkPhysicalDevice device) {
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(device, &deviceProperties);
+  if (std::min(instanceApiVersion, deviceProperties.apiVersion) <
+      VK_API_VERSION_1_2) {
+    return false;
+  }
+
+  auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(
+      instance, "vkGetPhysicalDeviceFeatures2");
+  if (getFeatures2 == nullptr) {
+    return false;
+  }
+
+  VkPhysicalDeviceVulkan12Features vulkan12Features{};
+  vulkan12Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  VkPhysicalDeviceFeatures2 features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &vulkan12Features;
+  getFeatures2(device, &features);
+
+  return vulkan12Features.timelineSemaphore == VK_TRUE;
+}
+
+bool VlknDevice::checkDynamicRenderingSupport(VkPhysicalDevice device) {
+  // The instance version caps the version the device may be used with
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(device, &deviceProperties);
+  if (std::min(instanceApiVersion, deviceProperties.apiVersion) <
+      VK_API_VERSION_1_3) {
+    return false;
+  }
+
+  auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(
+      instance, "vkGetPhysicalDeviceFeatures2");
+  if (getFeatures2 == nullptr) {
+    return false;
+  }
+
+  VkPhysicalDeviceVulkan13Features vulkan13Features{};
+  vulkan13Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+  VkPhysicalDeviceFeatures2 features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &vulkan13Features;
+  getFeatures2(device, &features);
+
+  return vulkan13Features.dynamicRendering == VK_TRUE;
 }
 
 void VlknDevice::populateDebugMessengerCreateInfo(
@@ -376,8 +738,10 @@ QueueFamilyIndices VlknDevice::findQueueFamilies(VkPhysicalDevice device) {
 
   int i = 0;
   for (const auto &queueFamily : queueFamilies) {
+    // Compute passes are recorded into the graphics command buffers
     if (queueFamily.queueCount > 0 &&
-        queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+        (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
       indices.graphicsFamily = i;
       indices.graphicsFamilyHasValue = true;
     }
@@ -457,6 +821,35 @@ uint32_t VlknDevice::findMemoryType(uint32_t typeFilter,
   throw std::runtime_error("failed to find suitable memory type!");
 }
 
+bool VlknDevice::hasMemoryType(VkMemoryPropertyFlags properties) {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((memProperties.memoryTypes[i].propertyFlags & properties) ==
+        properties) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+VkSampleCountFlagBits
+VlknDevice::clampSampleCount(VkSampleCountFlagBits requested) {
+  const VkSampleCountFlags supported =
+      properties.limits.framebufferColorSampleCounts &
+      properties.limits.framebufferDepthSampleCounts;
+
+  // Sample counts are single bits, so halving steps down one count
+  uint32_t sampleCount = std::bit_floor(
+      std::min<uint32_t>(requested, VK_SAMPLE_COUNT_64_BIT));
+  while (sampleCount > 1 && !(supported & sampleCount)) {
+    sampleCount >>= 1;
+  }
+
+  return static_cast<VkSampleCountFlagBits>(std::max(sampleCount, 1u));
+}
+
 void VlknDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                               VkMemoryPropertyFlags properties,
                               VkBuffer &buffer, VkDeviceMemory &bufferMemory) {
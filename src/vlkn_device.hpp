@@ -1,7 +1,9 @@
 #pragma once
 
+#include "vlkn_shader_module_cache.hpp"
 #include "vlkn_window.hpp"
 
+#include <memory>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
@@ -29,6 +31,10 @@ public:
   const bool enableValidationLayers = true;
 #endif
 
+  // Pipeline cache data is loaded from and saved to this file in the working
+  // directory
+  static constexpr const char *PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
   VlknDevice(VlknWindow &window);
   ~VlknDevice();
 
@@ -45,6 +51,12 @@ public:
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
   const VlknWindow &getWindow() { return window; }
+  // Shared by every pipeline, saved to PIPELINE_CACHE_PATH on destruction
+  VkPipelineCache pipelineCache() { return pipelineCache_; }
+  // Size of the cache data loaded at startup, 0 on a cold start
+  size_t getLoadedPipelineCacheSize() const { return loadedPipelineCacheSize; }
+  // Shared by every pipeline, modules only live while pipelines use them
+  VlknShaderModuleCache &shaderModuleCache() { return *shaderModuleCache_; }
 
   SwapChainSupportDetails getSwapChainSupport() {
     return querySwapChainSupport(physicalDevice);
@@ -52,6 +64,35 @@ public:
 
   uint32_t findMemoryType(uint32_t typeFilter,
                           VkMemoryPropertyFlags properties);
+  // True if any memory type has all of the property flags
+  bool hasMemoryType(VkMemoryPropertyFlags properties);
+  // Highest sample count up to requested that both colour and depth
+  // attachments support
+  VkSampleCountFlagBits clampSampleCount(VkSampleCountFlagBits requested);
+
+  // Vulkan 1.3 dynamic rendering, the feature is enabled whenever the device
+  // supports it
+  bool supportsDynamicRendering() const { return dynamicRenderingSupported; }
+  // Only valid if dynamic rendering is supported
+  void cmdBeginRendering(VkCommandBuffer commandBuffer,
+                         const VkRenderingInfo &renderingInfo);
+  void cmdEndRendering(VkCommandBuffer commandBuffer);
+
+  // Timeline semaphore of the graphics queue, signalled by every frame with
+  // the number of frames submitted up to and including it. Suitable devices
+  // always support Vulkan 1.2 timeline semaphores.
+  VkSemaphore graphicsTimeline() { return graphicsTimeline_; }
+  uint64_t getGraphicsTimelineValue();
+  // Blocks until the graphics timeline has reached value
+  void waitGraphicsTimeline(uint64_t value);
+
+  // VK_KHR_present_id and VK_KHR_present_wait, enabled whenever the device
+  // supports both
+  bool supportsPresentWait() const { return presentWaitSupported; }
+  // Only valid if present wait is supported. Returns VK_TIMEOUT if the
+  // present with presentId has not completed within timeout nanoseconds.
+  VkResult waitForPresent(VkSwapchainKHR swapChain, uint64_t presentId,
+                          uint64_t timeout);
 
   QueueFamilyIndices findPhysicalQueueFamilies() {
     return findQueueFamilies(physicalDevice);
@@ -85,6 +126,13 @@ private:
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void loadDeviceFunctions();
+  void createGraphicsTimeline();
+  void createPipelineCache();
+  void savePipelineCache();
+  // Whether cache data, prefix included, was written by this driver for this
+  // device
+  bool isPipelineCacheCompatible(const std::vector<char> &data);
 
   bool isDeviceSuitable(VkPhysicalDevice device);
   std::vector<const char *> getRequiredExtensions();
@@ -95,8 +143,13 @@ private:
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
+  bool checkDynamicRenderingSupport(VkPhysicalDevice device);
+  bool checkTimelineSemaphoreSupport(VkPhysicalDevice device);
+  bool checkPresentWaitSupport(VkPhysicalDevice device);
 
   VkInstance instance;
+  // Highest API version up to 1.3 the loader supports
+  uint32_t instanceApiVersion = VK_API_VERSION_1_0;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   VlknWindow &window;
@@ -107,11 +160,35 @@ private:
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
 
+  bool dynamicRenderingSupported = false;
+  // Loaded from the device, the loader may predate Vulkan 1.3
+  PFN_vkCmdBeginRendering vkCmdBeginRendering_ = nullptr;
+  PFN_vkCmdEndRendering vkCmdEndRendering_ = nullptr;
+
+  VkSemaphore graphicsTimeline_ = VK_NULL_HANDLE;
+  // Loaded from the device, the loader may predate Vulkan 1.2
+  PFN_vkWaitSemaphores vkWaitSemaphores_ = nullptr;
+  PFN_vkGetSemaphoreCounterValue vkGetSemaphoreCounterValue_ = nullptr;
+
+  bool presentWaitSupported = false;
+  PFN_vkWaitForPresentKHR vkWaitForPresentKHR_ = nullptr;
+
+  VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+  // The pipeline cache UUID is not required to change with every driver
+  // build, so the saved cache is also tagged with the driver's own UUID
+  uint8_t driverUUID[VK_UUID_SIZE]{};
+  size_t loadedPipelineCacheSize = 0;
+
+  std::unique_ptr<VlknShaderModuleCache> shaderModuleCache_;
+
   const std::vector<const char *> validationLayers = {
       "VK_LAYER_KHRONOS_validation"};
 
   const std::vector<const char *> deviceExtensions = {
       VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  // Optional, only enabled together
+  const std::vector<const char *> presentWaitExtensions = {
+      VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME};
 };
 
 } // namespace vlkn
@@ -0,0 +1,20 @@
+// header
+#include "vlkn_embedded_shaders.hpp"
+
+// std
+#include <cstddef>
+#include <string_view>
+
+namespace vlkn {
+
+const EmbeddedShader *findEmbeddedShader(std::string_view path) {
+  for (std::size_t i = 0; i < EMBEDDED_SHADER_COUNT; i++) {
+    if (path == EMBEDDED_SHADERS[i].path) {
+      return &EMBEDDED_SHADERS[i];
+    }
+  }
+
+  return nullptr;
+}
+
+} // namespace vlkn
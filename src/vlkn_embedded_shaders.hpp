@@ -0,0 +1,27 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace vlkn {
+
+// SPIR-V of a shader compiled into the executable. The code is stored as
+// 32-bit words, so it is aligned for vkCreateShaderModule as is.
+struct EmbeddedShader {
+  // Path the shader would be loaded from, e.g. "shaders/render.vert.spv"
+  const char *path;
+  const std::uint32_t *code;
+  // In bytes
+  std::size_t size;
+};
+
+// Generated at build time by cmake/embed_shaders.cmake
+extern const EmbeddedShader EMBEDDED_SHADERS[];
+extern const std::size_t EMBEDDED_SHADER_COUNT;
+
+// Null if no shader with the path was embedded
+const EmbeddedShader *findEmbeddedShader(std::string_view path);
+
+} // namespace vlkn
@@ -1,22 +1,53 @@
 #pragma once
 
 // local
+#include "vlkn_bvh.hpp"
 #include "vlkn_camera.hpp"
-#include "vlkn_game_object.hpp"
+#include "vlkn_components.hpp"
+#include "vlkn_occlusion_culler.hpp"
+#include "vlkn_registry.hpp"
+#include "vlkn_render_queue.hpp"
 
 // libs
 #include <vulkan/vulkan.h>
 
 // std
-#include <array>
+#include <cstddef>
+#include <cstdint>
 
 namespace vlkn {
 
-constexpr std::size_t MAX_LIGHTS = 16;
+// Capacity of the point light storage buffer
+constexpr std::size_t MAX_LIGHTS = 4096;
 
+// Size of the global texture array
+constexpr std::size_t TEXTURE_COUNT = 8;
+
+// Blinn-Phong exponent of every lit surface
+constexpr float SPECULAR_EXPONENT = 512.0f;
+
+// constant_id of the specialization constants the shading shaders declare
+enum class ShaderConstant : std::uint32_t {
+  // Most lights of one cluster the light loop runs to
+  MaxClusterLights = 0,
+  // Whether the texture is sampled or only the vertex colour is used
+  Textured = 1,
+  TextureCount = 2,
+  SpecularExponent = 3,
+};
+
+// Irradiance below which a point light is ignored, it bounds the otherwise
+// infinite inverse square falloff so lights can be assigned to clusters
+constexpr float LIGHT_CUTOFF = 0.01f;
+
+// position.w holds the range of the light. shadowIndex selects the light's
+// ShadowData in VlknShadowAtlas, or is -1 if the light casts no shadows.
+// The padding keeps the std430 array stride of the shaders.
 struct PointLight {
   glm::vec4 position{};
   glm::vec4 color{};
+  std::int32_t shadowIndex = -1;
+  std::int32_t padding[3]{};
 };
 
 struct GlobalUbo {
@@ -24,8 +55,11 @@ struct GlobalUbo {
   glm::mat4 view{1.0f};
   glm::mat4 inverseView{1.0f};
   glm::vec4 ambientLightColor{1.0f, 1.0f, 1.0f, 0.02f};
-  std::array<PointLight, MAX_LIGHTS> pointLights{};
-  std::size_t lightsNum = 0;
+  // Cluster grid dimensions in xyz
+  glm::uvec4 clusterCounts{};
+  // Inverse framebuffer size in xy, log depth slice scale and bias in zw
+  glm::vec4 clusterParams{};
+  std::uint32_t lightsNum = 0;
 };
 
 struct FrameInfo {
@@ -35,7 +69,10 @@ struct FrameInfo {
   VkCommandBuffer commandBuffer;
   VlknCamera &camera;
   VkDescriptorSet globalDescriptorSet;
-  VlknGameObject::Map &gameObjects;
+  VlknRegistry &registry;
+  const VlknBvh &sceneBvh;
+  const VlknOcclusionCuller &occlusionCuller;
+  VlknRenderQueue &renderQueue;
 };
 
 } // namespace vlkn
\ No newline at end of file
@@ -0,0 +1,74 @@
+// header
+#include "vlkn_frame_pacer.hpp"
+
+// libs
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+namespace vlkn {
+
+namespace {
+
+// Weight of a new latency sample in the smoothed latency
+constexpr float LATENCY_SMOOTHING = 0.1f;
+
+} // namespace
+
+VlknFramePacer::VlknFramePacer(VlknDevice &device, VlknRenderer &renderer)
+    : vlknDevice(device), vlknRenderer(renderer) {}
+
+void VlknFramePacer::waitForFrame() {
+  if (!lowLatency) {
+    return;
+  }
+
+  vlknRenderer.waitForFrame();
+
+  // The frame that last used the next frame index has finished on the GPU,
+  // waiting for it to be displayed keeps the swap chain queue short
+  const std::uint64_t submitted = vlknRenderer.getSubmittedFrameCount();
+  const std::uint32_t framesInFlight = vlknRenderer.getFramesInFlight();
+  if (vlknDevice.supportsPresentWait() && submitted >= framesInFlight) {
+    isFrameDone(submitted + 1 - framesInFlight, PRESENT_WAIT_TIMEOUT);
+  }
+
+  collectLatencies();
+}
+
+void VlknFramePacer::beginFrame(double inputTime) {
+  collectLatencies();
+
+  if (pendingFrames.size() >= MAX_PENDING_FRAMES) {
+    pendingFrames.pop_front();
+  }
+  pendingFrames.push_back(
+      {vlknRenderer.getSubmittedFrameCount() + 1, inputTime});
+
+  predictedPresentTime = inputTime + static_cast<double>(latencyMs) * 0.001;
+}
+
+bool VlknFramePacer::isFrameDone(std::uint64_t frameNumber,
+                                 std::uint64_t timeout) {
+  if (!vlknDevice.supportsPresentWait()) {
+    return vlknDevice.getGraphicsTimelineValue() >= frameNumber;
+  }
+
+  return vlknRenderer.waitForPresent(frameNumber, timeout) != VK_TIMEOUT;
+}
+
+void VlknFramePacer::collectLatencies() {
+  // Frames complete in order, so the first one not done ends the search
+  while (!pendingFrames.empty() &&
+         isFrameDone(pendingFrames.front().frameNumber, 0)) {
+    const double latency = glfwGetTime() - pendingFrames.front().inputTime;
+    pendingFrames.pop_front();
+
+    const float sample = static_cast<float>(latency * 1000.0);
+    latencyMs = hasLatency
+                    ? latencyMs + (sample - latencyMs) * LATENCY_SMOOTHING
+                    : sample;
+    hasLatency = true;
+  }
+}
+
+} // namespace vlkn
@@ -0,0 +1,77 @@
+#pragma once
+
+// local
+#include "vlkn_device.hpp"
+#include "vlkn_renderer.hpp"
+
+// libs
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace vlkn {
+
+// Paces frames for latency and measures it. Normally beginFrame() blocks
+// after input has been sampled, so the input ages by the wait. In low
+// latency mode waitForFrame() waits first, before input is sampled, and
+// with VK_KHR_present_wait also until the frame that last used the frame
+// index is on screen, so frames do not queue up behind the display.
+//
+// The latency of every frame is measured from the time its input was
+// sampled to its present, or to the end of its GPU work without present
+// wait. Completion is polled once per frame, so a sample may be late by up
+// to a frame unless its frame was just waited on.
+class VlknFramePacer {
+public:
+  // Bounds a present wait, presenting stalls while the window is hidden
+  static constexpr std::uint64_t PRESENT_WAIT_TIMEOUT = 100'000'000;
+  // Frames whose latency is never measured are dropped past this
+  static constexpr std::size_t MAX_PENDING_FRAMES = 16;
+
+  VlknFramePacer(VlknDevice &device, VlknRenderer &renderer);
+
+  VlknFramePacer(const VlknFramePacer &) = delete;
+  VlknFramePacer &operator=(const VlknFramePacer &) = delete;
+
+  void setLowLatency(bool enable) { lowLatency = enable; }
+  bool isLowLatency() const { return lowLatency; }
+  // Whether the latency reaches up to the present
+  bool measuresPresent() const { return vlknDevice.supportsPresentWait(); }
+
+  // Must be called before input is sampled, does nothing unless in low
+  // latency mode
+  void waitForFrame();
+  // Records when the input of the frame about to be recorded was sampled,
+  // in seconds of glfwGetTime(), and collects earlier frames' latencies
+  void beginFrame(double inputTime);
+
+  // Time at which the frame begun last is expected on screen
+  double getPredictedPresentTime() const { return predictedPresentTime; }
+  // Smoothed latency in milliseconds
+  float getLatency() const { return latencyMs; }
+
+private:
+  struct PendingFrame {
+    std::uint64_t frameNumber;
+    double inputTime;
+  };
+
+  // Whether the frame has been presented, or has finished without present
+  // wait. A present that failed counts as done.
+  bool isFrameDone(std::uint64_t frameNumber, std::uint64_t timeout);
+  void collectLatencies();
+
+  VlknDevice &vlknDevice;
+  VlknRenderer &vlknRenderer;
+
+  bool lowLatency = false;
+  std::deque<PendingFrame> pendingFrames{};
+  float latencyMs = 0.0f;
+  bool hasLatency = false;
+  double predictedPresentTime = 0.0;
+};
+
+} // namespace vlkn
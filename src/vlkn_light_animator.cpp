@@ -0,0 +1,309 @@
+// header
+#include "vlkn_light_animator.hpp"
+
+// local
+#include "vlkn_components.hpp"
+#include "vlkn_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace vlkn {
+
+struct LightAnimationPushConstants {
+  glm::vec4 colorOffset{};
+  float time = 0.0f;
+  std::uint32_t firstLight = 0;
+  std::uint32_t lightCount = 0;
+};
+
+namespace {
+
+// Billboard instance stride, see PointLightSystem
+constexpr VkDeviceSize BILLBOARD_SIZE = 2 * sizeof(glm::vec4);
+
+} // namespace
+
+VlknLightAnimator::VlknLightAnimator(VlknDevice &device,
+                                     VlknRenderer &renderer,
+                                     VlknLightClusters &lightClusters)
+    : vlknDevice(device), vlknRenderer(renderer),
+      vlknLightClusters(lightClusters) {
+  const std::uint32_t framesInFlight = vlknRenderer.getFramesInFlight();
+
+  animationBuffer = std::make_unique<VlknBuffer>(
+      vlknDevice, sizeof(LightAnimation), MAX_LIGHTS,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  billboardBuffers.resize(framesInFlight);
+  for (auto &buffer : billboardBuffers) {
+    buffer = std::make_unique<VlknBuffer>(
+        vlknDevice, BILLBOARD_SIZE, MAX_LIGHTS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+
+  createDescriptors();
+  createPipelineLayout();
+  createPipeline();
+}
+
+VlknLightAnimator::~VlknLightAnimator() {
+  vkDestroyPipelineLayout(vlknDevice.device(), pipelineLayout, nullptr);
+}
+
+void VlknLightAnimator::createDescriptors() {
+  setLayout = VlknDescriptorSetLayout::Builder(vlknDevice)
+                  .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                              VK_SHADER_STAGE_COMPUTE_BIT)
+                  .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                              VK_SHADER_STAGE_COMPUTE_BIT)
+                  .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                              VK_SHADER_STAGE_COMPUTE_BIT)
+                  .build();
+
+  const std::uint32_t framesInFlight =
+      static_cast<std::uint32_t>(billboardBuffers.size());
+
+  descriptorPool = VlknDescriptorPool::Builder(vlknDevice)
+                       .setMaxSets(framesInFlight)
+                       .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                    3 * framesInFlight)
+                       .build();
+
+  descriptorSets.resize(framesInFlight);
+  for (std::uint32_t i = 0; i < descriptorSets.size(); i++) {
+    auto animationInfo = animationBuffer->descriptorInfo();
+    auto lightsInfo = vlknLightClusters.lightsDescriptorInfo(i);
+    auto billboardInfo = billboardBuffers[i]->descriptorInfo();
+
+    VlknDescriptorWriter descriptorWriter =
+        VlknDescriptorWriter(*setLayout, *descriptorPool);
+
+    descriptorWriter.writeBuffer(0, &animationInfo);
+    descriptorWriter.writeBuffer(1, &lightsInfo);
+    descriptorWriter.writeBuffer(2, &billboardInfo);
+
+    if (!descriptorWriter.build(descriptorSets[i])) {
+      throw std::runtime_error("failed to build the light animation sets");
+    }
+  }
+}
+
+void VlknLightAnimator::createPipelineLayout() {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(LightAnimationPushConstants);
+
+  VkDescriptorSetLayout descriptorSetLayout =
+      setLayout->getDescriptorSetLayout();
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(vlknDevice.device(), &pipelineLayoutInfo, nullptr,
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout");
+  }
+}
+
+void VlknLightAnimator::createPipeline() {
+  assert(pipelineLayout != nullptr &&
+         "Cannot create pipeline before pipeline layout");
+
+  vlknPipeline = std::make_unique<VlknPipeline>(
+      vlknDevice, "shaders/light_animation.comp.spv", pipelineLayout);
+}
+
+void VlknLightAnimator::upload(VlknRegistry &registry) {
+  animations.clear();
+  bounds.clear();
+
+  registry.view<PointLightComponent, LightAnimationComponent>().each(
+      [&](Entity, PointLightComponent &pointLight,
+          LightAnimationComponent &animation) {
+        if (animations.size() >= MAX_LIGHTS) {
+          return;
+        }
+
+        LightAnimation gpuAnimation{};
+        gpuAnimation.center =
+            glm::vec4(animation.orbitCenter, animation.billboardRadius);
+        gpuAnimation.offset =
+            glm::vec4(animation.orbitOffset, animation.orbitSpeed);
+        gpuAnimation.axis =
+            glm::vec4(glm::normalize(animation.orbitAxis), animation.phase);
+        gpuAnimation.color =
+            glm::vec4(pointLight.color, pointLight.lightIntensity);
+        gpuAnimation.wave =
+            glm::vec4(animation.waveAmplitude, animation.waveFrequency,
+                      std::max(animation.curvePeriod, 1e-3f), 0.0f);
+        for (std::size_t i = 0; i < animation.intensityCurve.size(); i++) {
+          gpuAnimation.curve[i / 4][static_cast<glm::length_t>(i % 4)] =
+              animation.intensityCurve[i];
+        }
+        animations.push_back(gpuAnimation);
+
+        const float curvePeak =
+            *std::max_element(animation.intensityCurve.begin(),
+                              animation.intensityCurve.end());
+        bounds.push_back(Bound{
+            .center = animation.orbitCenter,
+            .sweepRadius = glm::length(animation.orbitOffset),
+            .color = pointLight.color,
+            .peakIntensity = (pointLight.lightIntensity +
+                              std::abs(animation.waveAmplitude)) *
+                             std::max(curvePeak, 0.0f),
+        });
+      });
+
+  // A pending upload that was never recorded is not used by the GPU and
+  // is replaced right away
+  stagingBuffer.reset();
+  stagingSize = 0;
+
+  if (!animations.empty()) {
+    stagingSize = sizeof(LightAnimation) * animations.size();
+
+    stagingBuffer = std::make_unique<VlknBuffer>(
+        vlknDevice, stagingSize, 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    stagingBuffer->map();
+    stagingBuffer->writeToBuffer(animations.data(), stagingSize);
+  }
+
+  std::vector<LightAnimationComponent> &components =
+      registry.getComponents<LightAnimationComponent>();
+  for (LightAnimationComponent &animation : components) {
+    animation.dirty = false;
+  }
+
+  uploadedPoolSize = components.size();
+  boundLights.clear();
+}
+
+void VlknLightAnimator::updateBounds(const glm::vec4 &colorOffset) {
+  boundLights.resize(bounds.size());
+
+  for (std::size_t i = 0; i < bounds.size(); i++) {
+    const Bound &bound = bounds[i];
+    const glm::vec3 color = bound.color + glm::vec3(colorOffset);
+
+    // Same range as PointLightSystem::update at the peak intensity
+    const float brightness = std::max({color.r, color.g, color.b, 0.0f}) *
+                             std::max(bound.peakIntensity + colorOffset.w,
+                                      0.0f);
+    const float range = glm::sqrt(brightness / LIGHT_CUTOFF);
+
+    boundLights[i] = PointLight{
+        glm::vec4(bound.center, bound.sweepRadius + range), glm::vec4(0.0f)};
+  }
+
+  boundColorOffset = colorOffset;
+}
+
+void VlknLightAnimator::update(VlknRegistry &registry,
+                               const glm::vec4 &colorOffset,
+                               std::vector<PointLight> &lights) {
+  // Edits are flagged on the components, so frames without edits only read
+  // one flag per animated light
+  const std::vector<LightAnimationComponent> &components =
+      registry.getComponents<LightAnimationComponent>();
+  const bool edited = std::any_of(
+      components.begin(), components.end(),
+      [](const LightAnimationComponent &animation) { return animation.dirty; });
+  if (edited || components.size() != uploadedPoolSize) {
+    upload(registry);
+  }
+
+  if (boundLights.size() != bounds.size() || colorOffset != boundColorOffset) {
+    updateBounds(colorOffset);
+  }
+
+  firstLight = static_cast<std::uint32_t>(
+      std::min<std::size_t>(lights.size(), MAX_LIGHTS));
+  dispatchCount = static_cast<std::uint32_t>(
+      std::min<std::size_t>(boundLights.size(), MAX_LIGHTS - firstLight));
+
+  lights.insert(lights.end(), boundLights.begin(),
+                boundLights.begin() + dispatchCount);
+}
+
+// Frames in flight may still read the parameters. A barrier's first scope
+// includes the work submitted earlier on the queue, so the copy waits for
+// their dispatches without stalling the CPU, and this frame's dispatch
+// waits for the copy. Uploads only happen when lights are added or edited,
+// so this is cheaper than double buffering the parameters.
+void VlknLightAnimator::recordUpload(VkCommandBuffer commandBuffer) {
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  // Write after read only needs the execution dependency
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = animationBuffer->getBuffer();
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1,
+                       &barrier, 0, nullptr);
+
+  VkBufferCopy copyRegion{};
+  copyRegion.size = stagingSize;
+  vkCmdCopyBuffer(commandBuffer, stagingBuffer->getBuffer(),
+                  animationBuffer->getBuffer(), 1, &copyRegion);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
+                       &barrier, 0, nullptr);
+
+  // The copy reads the staging buffer until the frame has finished
+  vlknRenderer.deferDestruction(std::move(stagingBuffer));
+  stagingSize = 0;
+}
+
+void VlknLightAnimator::record(VkCommandBuffer commandBuffer,
+                               std::uint32_t frameIndex, float time) {
+  if (stagingBuffer != nullptr) {
+    recordUpload(commandBuffer);
+  }
+
+  if (dispatchCount == 0) {
+    return;
+  }
+
+  vlknPipeline->bind(commandBuffer);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipelineLayout, 0, 1, &descriptorSets[frameIndex], 0,
+                          nullptr);
+
+  LightAnimationPushConstants push{};
+  push.colorOffset = boundColorOffset;
+  push.time = time;
+  push.firstLight = firstLight;
+  push.lightCount = dispatchCount;
+  vkCmdPushConstants(commandBuffer, pipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(LightAnimationPushConstants), &push);
+
+  vkCmdDispatch(commandBuffer,
+                (dispatchCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+}
+
+} // namespace vlkn
@@ -0,0 +1,130 @@
+#pragma once
+
+// local
+#include "vlkn_buffer.hpp"
+#include "vlkn_descriptors.hpp"
+#include "vlkn_device.hpp"
+#include "vlkn_frame_info.hpp"
+#include "vlkn_light_clusters.hpp"
+#include "vlkn_pipeline.hpp"
+#include "vlkn_registry.hpp"
+#include "vlkn_renderer.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vlkn {
+
+// Animates the lights with a LightAnimationComponent in a compute pass. The
+// animation parameters live in a device local buffer that is only uploaded
+// when animated lights are added or removed, or a component is dirty. The
+// upload is copied in the next recorded frame, ordered behind the dispatches
+// of earlier frames by a barrier instead of idling the queue. Every
+// frame the compute shader evaluates the orbit, intensity wave and curve of
+// each light and writes the result into the frame's light buffer of
+// VlknLightClusters and into a billboard instance buffer.
+//
+// Cluster assignment stays on the CPU, so each animated light is assigned
+// with a conservative bound: a sphere around its orbit grown by the range at
+// its peak intensity. The bounds only change with the parameters or the
+// light colour offset, so no per light animation runs on the CPU.
+class VlknLightAnimator {
+public:
+  static constexpr std::uint32_t WORKGROUP_SIZE = 64;
+
+  // lightClusters has to be created with the renderer's frames in flight
+  VlknLightAnimator(VlknDevice &device, VlknRenderer &renderer,
+                    VlknLightClusters &lightClusters);
+  ~VlknLightAnimator();
+
+  VlknLightAnimator(const VlknLightAnimator &) = delete;
+  VlknLightAnimator &operator=(const VlknLightAnimator &) = delete;
+
+  // Uploads the parameters if needed, clearing the dirty flags of the
+  // components, and appends the bound of every animated light to lights.
+  // The compute pass overwrites these entries on the GPU.
+  void update(VlknRegistry &registry, const glm::vec4 &colorOffset,
+              std::vector<PointLight> &lights);
+
+  // Records a pending parameter upload and the dispatch, which writes the
+  // frame's light buffer and billboard buffer in the compute stage. Must be
+  // recorded outside of a render pass, the readers have to wait for it.
+  void record(VkCommandBuffer commandBuffer, std::uint32_t frameIndex,
+              float time);
+
+  // Billboard instances in the layout of PointLightSystem, position.w is the
+  // billboard radius
+  VkBuffer getBillboardBuffer(std::uint32_t frameIndex) const {
+    return billboardBuffers[frameIndex]->getBuffer();
+  }
+  std::uint32_t getLightCount() const { return dispatchCount; }
+
+private:
+  // Mirrors LightAnimation in light_animation.comp
+  struct LightAnimation {
+    // xyz orbit center, w billboard radius
+    glm::vec4 center{};
+    // xyz offset from the center at time 0, w orbit speed
+    glm::vec4 offset{};
+    // xyz orbit axis, w phase
+    glm::vec4 axis{};
+    // rgb color, w base intensity
+    glm::vec4 color{};
+    // x wave amplitude, y wave frequency, z curve period
+    glm::vec4 wave{};
+    glm::vec4 curve[2]{};
+  };
+
+  struct Bound {
+    glm::vec3 center{};
+    float sweepRadius = 0.0f;
+    glm::vec3 color{};
+    float peakIntensity = 0.0f;
+  };
+
+  void createDescriptors();
+  void createPipelineLayout();
+  void createPipeline();
+  void upload(VlknRegistry &registry);
+  void recordUpload(VkCommandBuffer commandBuffer);
+  void updateBounds(const glm::vec4 &colorOffset);
+
+  VlknDevice &vlknDevice;
+  VlknRenderer &vlknRenderer;
+  VlknLightClusters &vlknLightClusters;
+
+  std::unique_ptr<VlknBuffer> animationBuffer;
+  // Parameters waiting to be copied into animationBuffer, null if none
+  std::unique_ptr<VlknBuffer> stagingBuffer;
+  VkDeviceSize stagingSize = 0;
+  std::vector<std::unique_ptr<VlknBuffer>> billboardBuffers{};
+
+  std::unique_ptr<VlknDescriptorSetLayout> setLayout;
+  std::unique_ptr<VlknDescriptorPool> descriptorPool;
+  std::vector<VkDescriptorSet> descriptorSets{};
+
+  std::unique_ptr<VlknPipeline> vlknPipeline;
+  VkPipelineLayout pipelineLayout;
+
+  std::size_t uploadedPoolSize = 0;
+
+  std::vector<LightAnimation> animations{};
+  std::vector<Bound> bounds{};
+  // Cluster bounds for the current colour offset
+  std::vector<PointLight> boundLights{};
+  glm::vec4 boundColorOffset{};
+
+  // Light buffer index of the first animated light and how many fit
+  std::uint32_t firstLight = 0;
+  std::uint32_t dispatchCount = 0;
+};
+
+} // namespace vlkn
@@ -0,0 +1,198 @@
+// header
+#include "vlkn_light_clusters.hpp"
+
+// local
+#include "vlkn_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+
+namespace vlkn {
+
+VlknLightClusters::VlknLightClusters(VlknDevice &device,
+                                     std::uint32_t framesInFlight)
+    : vlknDevice(device) {
+  frames.resize(framesInFlight);
+
+  for (FrameBuffers &frame : frames) {
+    frame.lights = std::make_unique<VlknBuffer>(
+        vlknDevice, sizeof(PointLight), MAX_LIGHTS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+    frame.clusters = std::make_unique<VlknBuffer>(
+        vlknDevice, sizeof(glm::uvec2), CLUSTER_COUNT,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+    frame.lightIndices = std::make_unique<VlknBuffer>(
+        vlknDevice, sizeof(std::uint32_t), MAX_LIGHT_INDICES,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+    frame.lights->map();
+    frame.clusters->map();
+    frame.lightIndices->map();
+  }
+}
+
+void VlknLightClusters::update(std::uint32_t frameIndex,
+                               const VlknCamera &camera, VkExtent2D extent,
+                               const std::vector<PointLight> &lights,
+                               GlobalUbo &ubo) {
+  // slice = log(depth / near) / log(far / near) * CLUSTERS_Z
+  const float logDepthRange = std::log(camera.getFar() / camera.getNear());
+  sliceScale = CLUSTERS_Z / logDepthRange;
+  sliceBias = -CLUSTERS_Z * std::log(camera.getNear()) / logDepthRange;
+
+  const std::uint32_t lightCount = static_cast<std::uint32_t>(
+      std::min<std::size_t>(lights.size(), MAX_LIGHTS));
+
+  assignments.clear();
+  for (std::uint32_t i = 0; i < lightCount; i++) {
+    assignLight(camera, lights[i], i);
+  }
+
+  // Counting sort of the assignments by cluster
+  clusterRanges.assign(CLUSTER_COUNT, glm::uvec2(0));
+  for (const Assignment &assignment : assignments) {
+    clusterRanges[assignment.cluster].y++;
+  }
+
+  std::uint32_t offset = 0;
+  maxClusterLights = 0;
+  for (glm::uvec2 &range : clusterRanges) {
+    range.x = offset;
+    range.y = std::min(range.y, MAX_LIGHT_INDICES - offset);
+    offset += range.y;
+    maxClusterLights = std::max(maxClusterLights, range.y);
+  }
+
+  lightIndices.resize(offset);
+  clusterFill.assign(CLUSTER_COUNT, 0);
+  for (const Assignment &assignment : assignments) {
+    const glm::uvec2 &range = clusterRanges[assignment.cluster];
+    std::uint32_t &fill = clusterFill[assignment.cluster];
+
+    if (fill < range.y) {
+      lightIndices[range.x + fill++] = assignment.light;
+    }
+  }
+
+  FrameBuffers &frame = frames[frameIndex];
+
+  if (lightCount > 0) {
+    frame.lights->writeToBuffer(lights.data(),
+                                lightCount * sizeof(PointLight));
+    frame.lights->flush();
+  }
+
+  frame.clusters->writeToBuffer(clusterRanges.data());
+  frame.clusters->flush();
+
+  if (!lightIndices.empty()) {
+    frame.lightIndices->writeToBuffer(
+        lightIndices.data(), lightIndices.size() * sizeof(std::uint32_t));
+    frame.lightIndices->flush();
+  }
+
+  ubo.clusterCounts = glm::uvec4(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, 0);
+  ubo.clusterParams = glm::vec4(1.0f / extent.width, 1.0f / extent.height,
+                                sliceScale, sliceBias);
+  ubo.lightsNum = lightCount;
+}
+
+VkDescriptorBufferInfo
+VlknLightClusters::lightsDescriptorInfo(std::uint32_t frameIndex) {
+  return frames[frameIndex].lights->descriptorInfo();
+}
+
+VkDescriptorBufferInfo
+VlknLightClusters::clustersDescriptorInfo(std::uint32_t frameIndex) {
+  return frames[frameIndex].clusters->descriptorInfo();
+}
+
+VkDescriptorBufferInfo
+VlknLightClusters::lightIndicesDescriptorInfo(std::uint32_t frameIndex) {
+  return frames[frameIndex].lightIndices->descriptorInfo();
+}
+
+void VlknLightClusters::assignLight(const VlknCamera &camera,
+                                    const PointLight &light,
+                                    std::uint32_t lightIndex) {
+  const glm::vec3 center =
+      glm::vec3(camera.getView() * glm::vec4(glm::vec3(light.position), 1.0f));
+  const float range = light.position.w;
+
+  // The camera looks down -z in view space
+  const float depth = -center.z;
+  const float minDepth = std::max(depth - range, camera.getNear());
+  const float maxDepth = std::min(depth + range, camera.getFar());
+
+  if (minDepth > maxDepth) {
+    return;
+  }
+
+  auto sliceOf = [&](float viewDepth) {
+    const float slice =
+        std::floor(std::log(viewDepth) * sliceScale + sliceBias);
+    return static_cast<std::uint32_t>(
+        std::clamp(slice, 0.0f, static_cast<float>(CLUSTERS_Z - 1)));
+  };
+
+  auto sliceDepth = [&](std::uint32_t slice) {
+    return std::exp((static_cast<float>(slice) - sliceBias) / sliceScale);
+  };
+
+  // Tile range covered by [low, high] in normalized device coordinates, or
+  // an empty range if it is off screen
+  auto tileRange = [](float low, float high, std::uint32_t tiles) {
+    if (high < -1.0f || low > 1.0f) {
+      return glm::uvec2(1, 0);
+    }
+
+    auto tileOf = [&](float ndc) {
+      const float tile = std::floor((ndc * 0.5f + 0.5f) * tiles);
+      return static_cast<std::uint32_t>(
+          std::clamp(tile, 0.0f, static_cast<float>(tiles - 1)));
+    };
+    return glm::uvec2(tileOf(low), tileOf(high));
+  };
+
+  const glm::mat4 &projection = camera.getProjection();
+
+  const std::uint32_t lastSlice = sliceOf(maxDepth);
+  for (std::uint32_t slice = sliceOf(minDepth); slice <= lastSlice; slice++) {
+    const float nearDepth = std::max(minDepth, sliceDepth(slice));
+    const float farDepth = std::min(maxDepth, sliceDepth(slice + 1));
+
+    // With a symmetric perspective projection ndc = scale * x / depth, so the
+    // screen bounds of the light's box within the slice are reached at its
+    // nearest or furthest depth
+    auto ndcBounds = [&](float low, float high, float scale) {
+      const float candidates[4] = {
+          scale * low / nearDepth, scale * low / farDepth,
+          scale * high / nearDepth, scale * high / farDepth};
+      return glm::vec2(*std::min_element(candidates, candidates + 4),
+                       *std::max_element(candidates, candidates + 4));
+    };
+
+    const glm::vec2 ndcX =
+        ndcBounds(center.x - range, center.x + range, projection[0][0]);
+    const glm::vec2 ndcY =
+        ndcBounds(center.y - range, center.y + range, projection[1][1]);
+
+    const glm::uvec2 tilesX = tileRange(ndcX.x, ndcX.y, CLUSTERS_X);
+    const glm::uvec2 tilesY = tileRange(ndcY.x, ndcY.y, CLUSTERS_Y);
+
+    for (std::uint32_t y = tilesY.x; y <= tilesY.y; y++) {
+      for (std::uint32_t x = tilesX.x; x <= tilesX.y; x++) {
+        const std::uint32_t cluster = (slice * CLUSTERS_Y + y) * CLUSTERS_X + x;
+        assignments.push_back(Assignment{cluster, lightIndex});
+      }
+    }
+  }
+}
+
+} // namespace vlkn
@@ -0,0 +1,84 @@
+#pragma once
+
+// local
+#include "vlkn_buffer.hpp"
+#include "vlkn_camera.hpp"
+#include "vlkn_device.hpp"
+#include "vlkn_frame_info.hpp"
+
+// libs
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vlkn {
+
+// Clustered forward lighting. The view frustum is split into screen tiles
+// and logarithmic depth slices, and every frame each light is assigned on the
+// CPU to the clusters its range overlaps. Fragments then shade only the
+// lights of their own cluster, so the cost per fragment depends on the local
+// light density instead of the total light count.
+class VlknLightClusters {
+public:
+  static constexpr std::uint32_t CLUSTERS_X = 16;
+  static constexpr std::uint32_t CLUSTERS_Y = 9;
+  static constexpr std::uint32_t CLUSTERS_Z = 24;
+  static constexpr std::uint32_t CLUSTER_COUNT =
+      CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+
+  // Light index budget shared by all clusters, lights past it are dropped
+  static constexpr std::uint32_t MAX_LIGHT_INDICES = CLUSTER_COUNT * 64;
+
+  // The light, cluster and index buffers are kept per frame in flight
+  VlknLightClusters(VlknDevice &device, std::uint32_t framesInFlight);
+
+  VlknLightClusters(const VlknLightClusters &) = delete;
+  VlknLightClusters &operator=(const VlknLightClusters &) = delete;
+
+  // Assigns the lights to clusters, uploads the buffers of frameIndex and
+  // fills in the cluster fields of the ubo. Lights past MAX_LIGHTS are
+  // ignored.
+  void update(std::uint32_t frameIndex, const VlknCamera &camera,
+              VkExtent2D extent, const std::vector<PointLight> &lights,
+              GlobalUbo &ubo);
+
+  // Most lights assigned to one cluster in the last update
+  std::uint32_t getMaxClusterLights() const { return maxClusterLights; }
+
+  VkDescriptorBufferInfo lightsDescriptorInfo(std::uint32_t frameIndex);
+  VkDescriptorBufferInfo clustersDescriptorInfo(std::uint32_t frameIndex);
+  VkDescriptorBufferInfo lightIndicesDescriptorInfo(std::uint32_t frameIndex);
+
+private:
+  struct FrameBuffers {
+    std::unique_ptr<VlknBuffer> lights;
+    // Offset into the light indices and light count of every cluster
+    std::unique_ptr<VlknBuffer> clusters;
+    std::unique_ptr<VlknBuffer> lightIndices;
+  };
+
+  struct Assignment {
+    std::uint32_t cluster;
+    std::uint32_t light;
+  };
+
+  void assignLight(const VlknCamera &camera, const PointLight &light,
+                   std::uint32_t lightIndex);
+
+  VlknDevice &vlknDevice;
+  std::vector<FrameBuffers> frames{};
+
+  float sliceScale = 0.0f;
+  float sliceBias = 0.0f;
+  std::uint32_t maxClusterLights = 0;
+
+  std::vector<Assignment> assignments{};
+  std::vector<glm::uvec2> clusterRanges{};
+  std::vector<std::uint32_t> clusterFill{};
+  std::vector<std::uint32_t> lightIndices{};
+};
+
+} // namespace vlkn
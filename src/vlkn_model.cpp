@@ -17,8 +17,10 @@
 
 // std
 #include <cassert>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
+#include <stdexcept>
 #include <unordered_map>
 #include <vector>
 
@@ -35,10 +37,20 @@ template <> struct hash<vlkn::VlknModel::Vertex> {
 
 namespace vlkn {
 
+namespace {
+
+// Sequential mesh ids for render queue sort keys
+std::atomic<std::uint32_t> nextModelId{0};
+
+} // namespace
+
 VlknModel::VlknModel(VlknDevice &device, const Builder &builder)
-    : vlknDevice(device) {
+    : vlknDevice(device), id(nextModelId++) {
+  // First, so an empty mesh throws before any buffer is created
+  createBoundingBox(builder.vertices);
   createVertexBuffers(builder.vertices);
   createIndexBuffers(builder.indices);
+  createOccluderMesh(builder.vertices, builder.indices);
 }
 
 std::unique_ptr<VlknModel>
@@ -104,11 +116,96 @@ void VlknModel::createIndexBuffers(const std::vector<std::uint32_t> &indices) {
                         bufferSize);
 }
 
-void VlknModel::draw(VkCommandBuffer commandBuffer) {
+void VlknModel::createBoundingBox(const std::vector<Vertex> &vertices) {
+  if (vertices.empty()) {
+    throw std::runtime_error("failed to create model, mesh has no vertices!");
+  }
+
+  boundingBox.min = vertices[0].position;
+  boundingBox.max = vertices[0].position;
+
+  for (const Vertex &vertex : vertices) {
+    boundingBox.min = glm::min(boundingBox.min, vertex.position);
+    boundingBox.max = glm::max(boundingBox.max, vertex.position);
+  }
+}
+
+// Simplifies the mesh by vertex clustering: every vertex is snapped to a cell
+// of a uniform grid laid over the bounding box, all vertices of a cell are
+// merged into their average and triangles that collapse are dropped. The
+// error is bounded by the cell size, which is plenty for occlusion testing
+// against a low resolution depth buffer.
+void VlknModel::createOccluderMesh(const std::vector<Vertex> &vertices,
+                                   const std::vector<std::uint32_t> &indices) {
+  constexpr std::uint32_t resolution = OCCLUDER_GRID_RESOLUTION;
+
+  const glm::vec3 extent = boundingBox.max - boundingBox.min;
+  const glm::vec3 cellSize =
+      glm::max(extent / static_cast<float>(resolution), glm::vec3(1e-6f));
+
+  std::unordered_map<std::uint32_t, std::uint32_t> cellToCluster{};
+  std::vector<glm::vec3> clusterSums{};
+  std::vector<std::uint32_t> clusterCounts{};
+  std::vector<std::uint32_t> vertexToCluster(vertices.size());
+
+  for (std::size_t i = 0; i < vertices.size(); i++) {
+    const glm::uvec3 cell = glm::min(
+        glm::uvec3((vertices[i].position - boundingBox.min) / cellSize),
+        glm::uvec3(resolution - 1));
+    const std::uint32_t cellIndex =
+        cell.x + cell.y * resolution + cell.z * resolution * resolution;
+
+    auto [it, inserted] = cellToCluster.try_emplace(
+        cellIndex, static_cast<std::uint32_t>(clusterSums.size()));
+    if (inserted) {
+      clusterSums.emplace_back(0.0f);
+      clusterCounts.push_back(0);
+    }
+
+    clusterSums[it->second] += vertices[i].position;
+    clusterCounts[it->second]++;
+    vertexToCluster[i] = it->second;
+  }
+
+  occluderMesh.positions.resize(clusterSums.size());
+  for (std::size_t i = 0; i < clusterSums.size(); i++) {
+    occluderMesh.positions[i] =
+        clusterSums[i] / static_cast<float>(clusterCounts[i]);
+  }
+
+  const std::size_t triangleCornerCount =
+      indices.empty() ? vertices.size() : indices.size();
+
+  occluderMesh.indices.clear();
+  occluderMesh.indices.reserve(triangleCornerCount);
+
+  for (std::size_t i = 0; i + 2 < triangleCornerCount; i += 3) {
+    const std::uint32_t first = static_cast<std::uint32_t>(i);
+
+    std::uint32_t a = indices.empty() ? first : indices[i];
+    std::uint32_t b = indices.empty() ? first + 1 : indices[i + 1];
+    std::uint32_t c = indices.empty() ? first + 2 : indices[i + 2];
+
+    a = vertexToCluster[a];
+    b = vertexToCluster[b];
+    c = vertexToCluster[c];
+
+    if (a == b || b == c || c == a) {
+      continue;
+    }
+
+    occluderMesh.indices.push_back(a);
+    occluderMesh.indices.push_back(b);
+    occluderMesh.indices.push_back(c);
+  }
+}
+
+void VlknModel::draw(VkCommandBuffer commandBuffer,
+                     std::uint32_t instanceCount) {
   if (hasIndexBuffer) {
-    vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+    vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, 0);
   } else {
-    vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+    vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, 0);
   }
 }
 
@@ -15,6 +15,7 @@
 
 // std
 #include <filesystem>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -22,6 +23,8 @@ namespace vlkn {
 
 class VlknModel {
 public:
+  using id_t = std::uint32_t;
+
   struct Vertex {
     Vertex(glm::vec3 pos, glm::vec3 col);
     Vertex(glm::vec3 pos);
@@ -50,6 +53,22 @@ public:
     void loadModel(const std::filesystem::path &path);
   };
 
+  struct BoundingBox {
+    glm::vec3 min{0.0f};
+    glm::vec3 max{0.0f};
+  };
+
+  // Position-only, simplified copy of the mesh kept on the CPU for the
+  // software occlusion culler
+  struct OccluderMesh {
+    std::vector<glm::vec3> positions{};
+    std::vector<std::uint32_t> indices{};
+  };
+
+  // Cells per bounding box axis used when clustering vertices of the
+  // occluder mesh
+  static constexpr std::uint32_t OCCLUDER_GRID_RESOLUTION = 16;
+
   VlknModel(VlknDevice &device, const Builder &builder);
 
   VlknModel(const VlknModel &) = delete;
@@ -59,13 +78,22 @@ public:
   createModelFromFile(VlknDevice &device, const std::filesystem::path &path);
 
   void bind(VkCommandBuffer commandBuffer);
-  void draw(VkCommandBuffer commandBuffer);
+  void draw(VkCommandBuffer commandBuffer, std::uint32_t instanceCount = 1);
+
+  id_t getId() const { return id; }
+
+  const BoundingBox &getBoundingBox() const { return boundingBox; }
+  const OccluderMesh &getOccluderMesh() const { return occluderMesh; }
 
 private:
   void createVertexBuffers(const std::vector<Vertex> &vertices);
   void createIndexBuffers(const std::vector<std::uint32_t> &indices);
+  void createBoundingBox(const std::vector<Vertex> &vertices);
+  void createOccluderMesh(const std::vector<Vertex> &vertices,
+                          const std::vector<std::uint32_t> &indices);
 
   VlknDevice &vlknDevice;
+  id_t id;
 
   std::unique_ptr<VlknBuffer> vertexBuffer;
   std::uint32_t vertexCount;
@@ -73,6 +101,9 @@ private:
   bool hasIndexBuffer = false;
   std::unique_ptr<VlknBuffer> indexBuffer;
   std::uint32_t indexCount;
+
+  BoundingBox boundingBox{};
+  OccluderMesh occluderMesh{};
 };
 
 } // namespace vlkn
@@ -0,0 +1,375 @@
+// header
+#include "vlkn_occlusion_culler.hpp"
+
+// libs
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vlkn {
+
+namespace {
+
+constexpr std::uint64_t FULL_TILE_MASK = ~std::uint64_t{0};
+
+struct EdgeFunction {
+  float a;
+  float b;
+  float c;
+
+  float evaluate(float x, float y) const { return a * x + b * y + c; }
+};
+
+EdgeFunction makeEdge(const glm::vec3 &from, const glm::vec3 &to) {
+  return EdgeFunction{from.y - to.y, to.x - from.x,
+                      from.x * to.y - from.y * to.x};
+}
+
+glm::vec3 toScreen(const glm::vec4 &clip) {
+  const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+  return glm::vec3(
+      (ndc.x * 0.5f + 0.5f) * static_cast<float>(VlknOcclusionCuller::WIDTH),
+      (ndc.y * 0.5f + 0.5f) * static_cast<float>(VlknOcclusionCuller::HEIGHT),
+      ndc.z);
+}
+
+} // namespace
+
+VlknOcclusionCuller::VlknOcclusionCuller(VlknThreadPool &threadPool)
+    : threadPool(threadPool), tiles(TILES_X * TILES_Y) {
+  beginFrame(glm::mat4(1.0f));
+}
+
+void VlknOcclusionCuller::beginFrame(const glm::mat4 &viewProjection) {
+  this->viewProjection = viewProjection;
+  occluders.clear();
+  std::fill(tiles.begin(), tiles.end(), Tile{0, 1.0f, 0.0f});
+}
+
+void VlknOcclusionCuller::addOccluder(const VlknModel::OccluderMesh &mesh,
+                                      const glm::mat4 &modelMatrix) {
+  if (mesh.indices.empty()) {
+    return;
+  }
+
+  occluders.push_back(Occluder{&mesh, viewProjection * modelMatrix});
+}
+
+void VlknOcclusionCuller::rasterizeOccluders() {
+  if (screenTriangles.size() < occluders.size()) {
+    screenTriangles.resize(occluders.size());
+  }
+
+  threadPool.parallelFor(
+      static_cast<std::uint32_t>(occluders.size()),
+      [this](std::uint32_t occluderIndex) { setupTriangles(occluderIndex); });
+
+  // Each band of tile rows is owned by exactly one task, so tiles are
+  // written without any synchronisation
+  const std::uint32_t bandCount =
+      std::min(TILES_Y, threadPool.getThreadCount() + 1);
+
+  threadPool.parallelFor(bandCount, [this, bandCount](std::uint32_t band) {
+    const std::uint32_t tileRowBegin = band * TILES_Y / bandCount;
+    const std::uint32_t tileRowEnd = (band + 1) * TILES_Y / bandCount;
+
+    for (std::size_t i = 0; i < occluders.size(); i++) {
+      for (const ScreenTriangle &triangle : screenTriangles[i]) {
+        rasterizeTriangle(triangle, tileRowBegin, tileRowEnd);
+      }
+    }
+  });
+}
+
+void VlknOcclusionCuller::setupTriangles(std::uint32_t occluderIndex) {
+  const Occluder &occluder = occluders[occluderIndex];
+  const VlknModel::OccluderMesh &mesh = *occluder.mesh;
+
+  std::vector<ScreenTriangle> &triangles = screenTriangles[occluderIndex];
+  triangles.clear();
+
+  thread_local std::vector<glm::vec4> clipPositions{};
+  clipPositions.resize(mesh.positions.size());
+
+  for (std::size_t i = 0; i < mesh.positions.size(); i++) {
+    clipPositions[i] =
+        occluder.modelViewProjection * glm::vec4(mesh.positions[i], 1.0f);
+  }
+
+  for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+    const glm::vec4 corners[3] = {clipPositions[mesh.indices[i]],
+                                  clipPositions[mesh.indices[i + 1]],
+                                  clipPositions[mesh.indices[i + 2]]};
+
+    // Clip against the near plane (z = 0 with zero to one depth), the
+    // remaining planes are handled by clamping to the depth buffer bounds
+    glm::vec4 clipped[4];
+    std::uint32_t clippedCount = 0;
+
+    for (std::uint32_t k = 0; k < 3; k++) {
+      const glm::vec4 &current = corners[k];
+      const glm::vec4 &next = corners[(k + 1) % 3];
+
+      if (current.z >= 0.0f) {
+        clipped[clippedCount++] = current;
+      }
+
+      if ((current.z >= 0.0f) != (next.z >= 0.0f)) {
+        const float t = current.z / (current.z - next.z);
+        clipped[clippedCount++] = current + t * (next - current);
+      }
+    }
+
+    if (clippedCount < 3) {
+      continue;
+    }
+
+    glm::vec3 screen[4];
+    for (std::uint32_t k = 0; k < clippedCount; k++) {
+      screen[k] = toScreen(clipped[k]);
+    }
+
+    triangles.push_back(ScreenTriangle{{screen[0], screen[1], screen[2]}});
+    if (clippedCount == 4) {
+      triangles.push_back(ScreenTriangle{{screen[0], screen[2], screen[3]}});
+    }
+  }
+}
+
+void VlknOcclusionCuller::rasterizeTriangle(const ScreenTriangle &triangle,
+                                            std::uint32_t tileRowBegin,
+                                            std::uint32_t tileRowEnd) {
+  const glm::vec3 &a = triangle.v[0];
+  const glm::vec3 &b = triangle.v[1];
+  const glm::vec3 &c = triangle.v[2];
+
+  const glm::vec3 boundsMin = glm::min(a, glm::min(b, c));
+  const glm::vec3 boundsMax = glm::max(a, glm::max(b, c));
+
+  if (boundsMax.x < 0.0f || boundsMax.y < 0.0f ||
+      boundsMin.x >= static_cast<float>(WIDTH) ||
+      boundsMin.y >= static_cast<float>(HEIGHT) || boundsMin.z >= 1.0f) {
+    return;
+  }
+
+  const auto toTile = [](float pixel, std::uint32_t tileCount) {
+    const float tile = std::floor(pixel / static_cast<float>(TILE_SIZE));
+    return static_cast<std::uint32_t>(
+        std::clamp(tile, 0.0f, static_cast<float>(tileCount - 1)));
+  };
+
+  const std::uint32_t tileX0 = toTile(boundsMin.x, TILES_X);
+  const std::uint32_t tileX1 = toTile(boundsMax.x, TILES_X);
+  const std::uint32_t tileY0 =
+      std::max(toTile(boundsMin.y, TILES_Y), tileRowBegin);
+  const std::uint32_t tileY1 =
+      std::min(toTile(boundsMax.y, TILES_Y) + 1, tileRowEnd);
+
+  if (tileY0 >= tileY1) {
+    return;
+  }
+
+  float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+  if (std::abs(area) < std::numeric_limits<float>::epsilon()) {
+    return;
+  }
+
+  // Occluders are rasterized regardless of winding, flip the edges of
+  // clockwise triangles so that the inside is always positive
+  EdgeFunction edges[3] = {makeEdge(b, c), makeEdge(c, a), makeEdge(a, b)};
+  if (area < 0.0f) {
+    for (EdgeFunction &edge : edges) {
+      edge.a = -edge.a;
+      edge.b = -edge.b;
+      edge.c = -edge.c;
+    }
+    area = -area;
+  }
+
+  // Depth is affine in screen space, z(x, y) = plane.a * x + plane.b * y +
+  // plane.c, built from the barycentric weights of the edge functions
+  const EdgeFunction depthPlane{
+      (edges[0].a * a.z + edges[1].a * b.z + edges[2].a * c.z) / area,
+      (edges[0].b * a.z + edges[1].b * b.z + edges[2].b * c.z) / area,
+      (edges[0].c * a.z + edges[1].c * b.z + edges[2].c * c.z) / area,
+  };
+
+#if defined(__SSE2__)
+  __m128 laneOffsetsLo = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+  __m128 laneOffsetsHi = _mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f);
+  __m128 edgeLanesLo[3];
+  __m128 edgeLanesHi[3];
+  for (std::uint32_t k = 0; k < 3; k++) {
+    edgeLanesLo[k] = _mm_mul_ps(_mm_set1_ps(edges[k].a), laneOffsetsLo);
+    edgeLanesHi[k] = _mm_mul_ps(_mm_set1_ps(edges[k].a), laneOffsetsHi);
+  }
+  const __m128 zero = _mm_setzero_ps();
+#endif
+
+  constexpr float tileExtent = static_cast<float>(TILE_SIZE - 1);
+
+  for (std::uint32_t tileY = tileY0; tileY < tileY1; tileY++) {
+    for (std::uint32_t tileX = tileX0; tileX <= tileX1; tileX++) {
+      const float x0 = static_cast<float>(tileX * TILE_SIZE) + 0.5f;
+      const float y0 = static_cast<float>(tileY * TILE_SIZE) + 0.5f;
+
+      std::uint64_t triangleMask = 0;
+
+      for (std::uint32_t row = 0; row < TILE_SIZE; row++) {
+        const float y = y0 + static_cast<float>(row);
+
+#if defined(__SSE2__)
+        __m128 insideLo = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        __m128 insideHi = insideLo;
+
+        for (std::uint32_t k = 0; k < 3; k++) {
+          const __m128 rowStart = _mm_set1_ps(edges[k].evaluate(x0, y));
+          insideLo = _mm_and_ps(
+              insideLo,
+              _mm_cmpge_ps(_mm_add_ps(edgeLanesLo[k], rowStart), zero));
+          insideHi = _mm_and_ps(
+              insideHi,
+              _mm_cmpge_ps(_mm_add_ps(edgeLanesHi[k], rowStart), zero));
+        }
+
+        const std::uint64_t rowMask = static_cast<std::uint64_t>(
+            _mm_movemask_ps(insideLo) | (_mm_movemask_ps(insideHi) << 4));
+#else
+        std::uint64_t rowMask = 0;
+        for (std::uint32_t column = 0; column < TILE_SIZE; column++) {
+          const float x = x0 + static_cast<float>(column);
+          if (edges[0].evaluate(x, y) >= 0.0f &&
+              edges[1].evaluate(x, y) >= 0.0f &&
+              edges[2].evaluate(x, y) >= 0.0f) {
+            rowMask |= std::uint64_t{1} << column;
+          }
+        }
+#endif
+
+        triangleMask |= rowMask << (row * TILE_SIZE);
+      }
+
+      if (triangleMask == 0) {
+        continue;
+      }
+
+      // Farthest depth of the triangle inside the tile, taken from the plane
+      // at the tile corners and clamped to the depth range of the triangle
+      const float cornerZMax = std::max(
+          std::max(depthPlane.evaluate(x0, y0),
+                   depthPlane.evaluate(x0 + tileExtent, y0)),
+          std::max(depthPlane.evaluate(x0, y0 + tileExtent),
+                   depthPlane.evaluate(x0 + tileExtent, y0 + tileExtent)));
+      const float triangleZMax =
+          std::min(std::max(cornerZMax, boundsMin.z), boundsMax.z);
+
+      updateTile(tiles[tileY * TILES_X + tileX], triangleMask, triangleZMax);
+    }
+  }
+}
+
+void VlknOcclusionCuller::updateTile(Tile &tile, std::uint64_t triangleMask,
+                                     float triangleZMax) {
+  // A triangle behind the reference layer cannot tighten the tile
+  if (triangleZMax >= tile.zMax0) {
+    return;
+  }
+
+  tile.zMax1 = tile.coverageMask == 0 ? triangleZMax
+                                      : std::max(tile.zMax1, triangleZMax);
+  tile.coverageMask |= triangleMask;
+
+  // Once the working layer covers the whole tile it becomes the new
+  // reference layer for every pixel
+  if (tile.coverageMask == FULL_TILE_MASK) {
+    tile.zMax0 = tile.zMax1;
+    tile.coverageMask = 0;
+    tile.zMax1 = 0.0f;
+  }
+}
+
+bool VlknOcclusionCuller::isVisible(const VlknModel::BoundingBox &box,
+                                    const glm::mat4 &modelMatrix) const {
+  const glm::mat4 modelViewProjection = viewProjection * modelMatrix;
+
+  glm::vec3 ndcMin{std::numeric_limits<float>::max()};
+  glm::vec3 ndcMax{std::numeric_limits<float>::lowest()};
+
+  for (std::uint32_t corner = 0; corner < 8; corner++) {
+    const glm::vec3 position{(corner & 1) ? box.max.x : box.min.x,
+                             (corner & 2) ? box.max.y : box.min.y,
+                             (corner & 4) ? box.max.z : box.min.z};
+    const glm::vec4 clip = modelViewProjection * glm::vec4(position, 1.0f);
+
+    // Boxes crossing the near plane are always treated as visible
+    if (clip.z < 0.0f || clip.w <= std::numeric_limits<float>::epsilon()) {
+      return true;
+    }
+
+    const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    ndcMin = glm::min(ndcMin, ndc);
+    ndcMax = glm::max(ndcMax, ndc);
+  }
+
+  if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f ||
+      ndcMin.y > 1.0f || ndcMin.z > 1.0f) {
+    return false;
+  }
+
+  const auto toPixel = [](float ndc, std::uint32_t size) {
+    const float pixel =
+        std::floor((ndc * 0.5f + 0.5f) * static_cast<float>(size));
+    return static_cast<std::uint32_t>(
+        std::clamp(pixel, 0.0f, static_cast<float>(size - 1)));
+  };
+
+  const std::uint32_t pixelX0 = toPixel(ndcMin.x, WIDTH);
+  const std::uint32_t pixelX1 = toPixel(ndcMax.x, WIDTH);
+  const std::uint32_t pixelY0 = toPixel(ndcMin.y, HEIGHT);
+  const std::uint32_t pixelY1 = toPixel(ndcMax.y, HEIGHT);
+  const float boxZMin = ndcMin.z;
+
+  for (std::uint32_t tileY = pixelY0 / TILE_SIZE; tileY <= pixelY1 / TILE_SIZE;
+       tileY++) {
+    for (std::uint32_t tileX = pixelX0 / TILE_SIZE;
+         tileX <= pixelX1 / TILE_SIZE; tileX++) {
+      const std::uint32_t tileOriginX = tileX * TILE_SIZE;
+      const std::uint32_t tileOriginY = tileY * TILE_SIZE;
+
+      const std::uint32_t columnBegin =
+          std::max(pixelX0, tileOriginX) - tileOriginX;
+      const std::uint32_t columnEnd =
+          std::min(pixelX1, tileOriginX + TILE_SIZE - 1) - tileOriginX;
+      const std::uint32_t rowBegin =
+          std::max(pixelY0, tileOriginY) - tileOriginY;
+      const std::uint32_t rowEnd =
+          std::min(pixelY1, tileOriginY + TILE_SIZE - 1) - tileOriginY;
+
+      const std::uint64_t rowMask = (std::uint64_t{0xFF} >> (7 - columnEnd)) &
+                                    (std::uint64_t{0xFF} << columnBegin);
+
+      std::uint64_t boxMask = 0;
+      for (std::uint32_t row = rowBegin; row <= rowEnd; row++) {
+        boxMask |= rowMask << (row * TILE_SIZE);
+      }
+
+      const Tile &tile = tiles[tileY * TILES_X + tileX];
+      const bool occluded =
+          boxZMin > tile.zMax0 ||
+          ((boxMask & ~tile.coverageMask) == 0 && boxZMin > tile.zMax1);
+
+      if (!occluded) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+} // namespace vlkn
@@ -0,0 +1,83 @@
+#pragma once
+
+// local
+#include "vlkn_model.hpp"
+#include "vlkn_thread_pool.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vlkn {
+
+// CPU masked software occlusion culler. Occluder meshes are rasterized into a
+// low resolution, tiled depth buffer. Every 8x8 tile stores a coverage mask
+// and two depth layers instead of per-pixel depth, so occludee queries only
+// look at a few tiles and never wait for the GPU.
+class VlknOcclusionCuller {
+public:
+  static constexpr std::uint32_t TILE_SIZE = 8;
+  static constexpr std::uint32_t TILES_X = 32;
+  static constexpr std::uint32_t TILES_Y = 18;
+  static constexpr std::uint32_t WIDTH = TILES_X * TILE_SIZE;
+  static constexpr std::uint32_t HEIGHT = TILES_Y * TILE_SIZE;
+
+  VlknOcclusionCuller(VlknThreadPool &threadPool);
+
+  VlknOcclusionCuller(const VlknOcclusionCuller &) = delete;
+  VlknOcclusionCuller &operator=(const VlknOcclusionCuller &) = delete;
+
+  // Clears the depth buffer and drops all occluders of the previous frame
+  void beginFrame(const glm::mat4 &viewProjection);
+
+  // The mesh must stay alive until rasterizeOccluders() returns
+  void addOccluder(const VlknModel::OccluderMesh &mesh,
+                   const glm::mat4 &modelMatrix);
+
+  // Transforms and rasterizes all added occluders on the thread pool
+  void rasterizeOccluders();
+
+  // Conservative test of a model space bounding box. Returns false only when
+  // the box is outside of the view frustum or hidden behind occluders.
+  bool isVisible(const VlknModel::BoundingBox &box,
+                 const glm::mat4 &modelMatrix) const;
+
+private:
+  struct Occluder {
+    const VlknModel::OccluderMesh *mesh;
+    glm::mat4 modelViewProjection;
+  };
+
+  // Vertices in depth buffer pixel coordinates, z is the NDC depth
+  struct ScreenTriangle {
+    glm::vec3 v[3];
+  };
+
+  // Two layer depth representation of a tile. Every pixel of the tile is at
+  // most at depth zMax0, pixels in coverageMask are at most at depth zMax1.
+  struct Tile {
+    std::uint64_t coverageMask;
+    float zMax0;
+    float zMax1;
+  };
+
+  void setupTriangles(std::uint32_t occluderIndex);
+  void rasterizeTriangle(const ScreenTriangle &triangle,
+                         std::uint32_t tileRowBegin, std::uint32_t tileRowEnd);
+  static void updateTile(Tile &tile, std::uint64_t triangleMask,
+                         float triangleZMax);
+
+  VlknThreadPool &threadPool;
+
+  glm::mat4 viewProjection{1.0f};
+  std::vector<Occluder> occluders{};
+  std::vector<std::vector<ScreenTriangle>> screenTriangles{};
+  std::vector<Tile> tiles;
+};
+
+} // namespace vlkn
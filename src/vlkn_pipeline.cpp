@@ -3,76 +3,97 @@
 
 // local
 #include "vlkn_model.hpp"
+#include "vlkn_shader_module_cache.hpp"
 
 // lib
 #include <vulkan/vulkan_core.h>
 
 // std
+#include <atomic>
+#include <chrono>
 #include <cstdint>
-#include <fstream>
-#include <ios>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
 namespace vlkn {
 
+namespace {
+
+// Compact ids keep the pipeline field of render queue sort keys small
+std::atomic<std::uint32_t> nextPipelineId{0};
+
+std::atomic<std::uint64_t> creationNanoseconds{0};
+
+// Adds the time since start to the total pipeline creation time
+void addCreationTime(std::chrono::steady_clock::time_point start) {
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  creationNanoseconds +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+} // namespace
+
 VlknPipeline::VlknPipeline(VlknDevice &device, const std::string &vert,
                            const std::string &frag,
                            const PipelineConfigInfo &configInfo)
-    : vlknDevice(device) {
+    : vlknDevice(device), id(nextPipelineId++) {
   createGraphicsPipeline(vert, frag, configInfo);
 }
 
-VlknPipeline::~VlknPipeline() {
-  vkDestroyShaderModule(vlknDevice.device(), vertShaderModule, nullptr);
-  vkDestroyShaderModule(vlknDevice.device(), fragShaderModule, nullptr);
-  vkDestroyPipeline(vlknDevice.device(), graphicsPipeline, nullptr);
+VlknPipeline::VlknPipeline(VlknDevice &device, const std::string &comp,
+                           VkPipelineLayout pipelineLayout)
+    : vlknDevice(device), id(nextPipelineId++),
+      bindPoint(VK_PIPELINE_BIND_POINT_COMPUTE) {
+  createComputePipeline(comp, pipelineLayout);
 }
 
-std::vector<char> VlknPipeline::readFile(const std::string &path) {
-  std::ifstream file{path, std::ios::ate | std::ios::binary};
-
-  if (!file.is_open() || !file.good()) {
-    throw std::runtime_error("failed to open file: " + path);
-  }
-
-  size_t fileSize = static_cast<size_t>(file.tellg());
-  std::vector<char> buffer(fileSize);
+VlknPipeline::~VlknPipeline() {
+  vkDestroyPipeline(vlknDevice.device(), pipeline, nullptr);
+}
 
-  file.seekg(0);
-  file.read(buffer.data(), fileSize);
-  file.close();
+std::uint32_t VlknPipeline::getCreatedCount() { return nextPipelineId; }
 
-  return buffer;
+double VlknPipeline::getCreationTime() {
+  return static_cast<double>(creationNanoseconds) / 1'000'000.0;
 }
 
 void VlknPipeline::createGraphicsPipeline(
     const std::string &vert, const std::string &frag,
     const PipelineConfigInfo &configInfo) {
-  std::vector<char> vertCode = readFile(vert);
-  std::vector<char> fragCode = readFile(frag);
-
-  createShaderModule(vertCode, &vertShaderModule);
-  createShaderModule(fragCode, &fragShaderModule);
+  // Held only until the pipeline has been created
+  std::shared_ptr<VlknShaderModule> vertShaderModule =
+      vlknDevice.shaderModuleCache().acquire(vert);
+  std::shared_ptr<VlknShaderModule> fragShaderModule =
+      vlknDevice.shaderModuleCache().acquire(frag);
+
+  VkSpecializationInfo specializationInfo{};
+  specializationInfo.mapEntryCount =
+      static_cast<std::uint32_t>(configInfo.specializationEntries.size());
+  specializationInfo.pMapEntries = configInfo.specializationEntries.data();
+  specializationInfo.dataSize = configInfo.specializationData.size();
+  specializationInfo.pData = configInfo.specializationData.data();
+  const VkSpecializationInfo *pSpecializationInfo =
+      configInfo.specializationEntries.empty() ? nullptr : &specializationInfo;
 
   VkPipelineShaderStageCreateInfo shaderStages[2];
 
   shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-  shaderStages[0].module = vertShaderModule;
+  shaderStages[0].module = vertShaderModule->getShaderModule();
   shaderStages[0].pName = "main";
   shaderStages[0].flags = 0;
   shaderStages[0].pNext = nullptr;
-  shaderStages[0].pSpecializationInfo = nullptr;
+  shaderStages[0].pSpecializationInfo = pSpecializationInfo;
 
   shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  shaderStages[1].module = fragShaderModule;
+  shaderStages[1].module = fragShaderModule->getShaderModule();
   shaderStages[1].pName = "main";
   shaderStages[1].flags = 0;
   shaderStages[1].pNext = nullptr;
-  shaderStages[1].pSpecializationInfo = nullptr;
+  shaderStages[1].pSpecializationInfo = pSpecializationInfo;
 
   auto &bindingDescriptions = configInfo.bindingDescriptions;
   auto &attributeDescriptions = configInfo.attributeDescriptions;
@@ -104,25 +125,57 @@ void VlknPipeline::createGraphicsPipeline(
   pipelineInfo.renderPass = configInfo.renderPass;
   pipelineInfo.subpass = configInfo.subpass;
 
+  VkPipelineRenderingCreateInfo renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+  renderingInfo.colorAttachmentCount =
+      static_cast<std::uint32_t>(configInfo.colorAttachmentFormats.size());
+  renderingInfo.pColorAttachmentFormats =
+      configInfo.colorAttachmentFormats.data();
+  renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+  if (configInfo.renderPass == nullptr) {
+    pipelineInfo.pNext = &renderingInfo;
+  }
+
   pipelineInfo.basePipelineIndex = -1;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-  if (vkCreateGraphicsPipelines(vlknDevice.device(), nullptr, 1, &pipelineInfo,
-                                nullptr, &graphicsPipeline) != VK_SUCCESS) {
+  const auto start = std::chrono::steady_clock::now();
+  const VkResult result =
+      vkCreateGraphicsPipelines(vlknDevice.device(), vlknDevice.pipelineCache(),
+                                1, &pipelineInfo, nullptr, &pipeline);
+  addCreationTime(start);
+
+  if (result != VK_SUCCESS) {
     throw std::runtime_error("failed to create graphics pipeline");
   }
 }
 
-void VlknPipeline::createShaderModule(const std::vector<char> &code,
-                                      VkShaderModule *shaderModule) {
-  VkShaderModuleCreateInfo createInfo{};
-  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+void VlknPipeline::createComputePipeline(const std::string &comp,
+                                         VkPipelineLayout pipelineLayout) {
+  std::shared_ptr<VlknShaderModule> compShaderModule =
+      vlknDevice.shaderModuleCache().acquire(comp);
+
+  VkPipelineShaderStageCreateInfo shaderStage{};
+  shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  shaderStage.module = compShaderModule->getShaderModule();
+  shaderStage.pName = "main";
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage = shaderStage;
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.basePipelineIndex = -1;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  const auto start = std::chrono::steady_clock::now();
+  const VkResult result =
+      vkCreateComputePipelines(vlknDevice.device(), vlknDevice.pipelineCache(),
+                               1, &pipelineInfo, nullptr, &pipeline);
+  addCreationTime(start);
 
-  if (vkCreateShaderModule(vlknDevice.device(), &createInfo, nullptr,
-                           shaderModule) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create shader module");
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline");
   }
 }
 
@@ -211,8 +264,7 @@ void VlknPipeline::defaultPipelineConfigInfo(PipelineConfigInfo &configInfo) {
 }
 
 void VlknPipeline::bind(VkCommandBuffer commandBuffer) {
-  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    graphicsPipeline);
+  vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
 }
 
 void VlknPipeline::enableAlphaBlending(PipelineConfigInfo &configInfo) {
@@ -231,4 +283,31 @@ void VlknPipeline::enableAlphaBlending(PipelineConfigInfo &configInfo) {
   configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 }
 
+void VlknPipeline::enableWeightedBlending(PipelineConfigInfo &configInfo) {
+  VkPipelineColorBlendAttachmentState &accum =
+      configInfo.weightedBlendAttachments[0];
+  accum = configInfo.colorBlendAttachment;
+  accum.blendEnable = VK_TRUE;
+  accum.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  accum.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  accum.colorBlendOp = VK_BLEND_OP_ADD;
+  accum.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  accum.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  accum.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  VkPipelineColorBlendAttachmentState &revealage =
+      configInfo.weightedBlendAttachments[1];
+  revealage = accum;
+  revealage.colorWriteMask = VK_COLOR_COMPONENT_R_BIT;
+  revealage.srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+  revealage.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+
+  configInfo.colorBlendInfo.attachmentCount =
+      static_cast<uint32_t>(configInfo.weightedBlendAttachments.size());
+  configInfo.colorBlendInfo.pAttachments =
+      configInfo.weightedBlendAttachments.data();
+
+  configInfo.depthStencilInfo.depthWriteEnable = VK_FALSE;
+}
+
 } // namespace vlkn
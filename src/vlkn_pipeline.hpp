@@ -2,7 +2,9 @@
 
 #include "vlkn_device.hpp"
 
+#include <array>
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -21,6 +23,8 @@ struct PipelineConfigInfo {
   VkPipelineRasterizationStateCreateInfo rasterizationInfo;
   VkPipelineMultisampleStateCreateInfo multisampleInfo;
   VkPipelineColorBlendAttachmentState colorBlendAttachment;
+  // Accumulation and revealage states, see enableWeightedBlending
+  std::array<VkPipelineColorBlendAttachmentState, 2> weightedBlendAttachments;
   VkPipelineColorBlendStateCreateInfo colorBlendInfo;
   VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
   std::vector<VkDynamicState> dynamicStateEnables;
@@ -28,12 +32,24 @@ struct PipelineConfigInfo {
   VkPipelineLayout pipelineLayout = nullptr;
   VkRenderPass renderPass = nullptr;
   uint32_t subpass = 0;
+  // Attachment formats of a pipeline used with dynamic rendering, only read
+  // when renderPass is null
+  std::vector<VkFormat> colorAttachmentFormats{};
+  VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+  // Specialization constants of both stages, see addSpecializationConstant
+  std::vector<VkSpecializationMapEntry> specializationEntries{};
+  std::vector<std::uint8_t> specializationData{};
 };
 
 class VlknPipeline {
 public:
+  using id_t = std::uint32_t;
+
   VlknPipeline(VlknDevice &device, const std::string &vert,
                const std::string &frag, const PipelineConfigInfo &configInfo);
+  // Compute pipeline
+  VlknPipeline(VlknDevice &device, const std::string &comp,
+               VkPipelineLayout pipelineLayout);
   ~VlknPipeline();
 
   VlknPipeline(const VlknPipeline &) = delete;
@@ -41,22 +57,49 @@ public:
 
   static void defaultPipelineConfigInfo(PipelineConfigInfo &configInfo);
   static void enableAlphaBlending(PipelineConfigInfo &configInfo);
+  // Weighted blended order independent transparency for the transparent
+  // subpass: the weighted colour is added into the accumulation target and
+  // (1 - alpha) is multiplied into the revealage target. Depth is tested but
+  // not written.
+  static void enableWeightedBlending(PipelineConfigInfo &configInfo);
+  // Sets the specialization constant with constantId in both stages,
+  // constants a shader does not declare are ignored. Booleans must be
+  // passed as VkBool32.
+  template <typename T>
+  static void addSpecializationConstant(PipelineConfigInfo &configInfo,
+                                        std::uint32_t constantId,
+                                        const T &value) {
+    VkSpecializationMapEntry entry{};
+    entry.constantID = constantId;
+    entry.offset =
+        static_cast<std::uint32_t>(configInfo.specializationData.size());
+    entry.size = sizeof(T);
+    configInfo.specializationEntries.push_back(entry);
+
+    configInfo.specializationData.resize(entry.offset + sizeof(T));
+    std::memcpy(configInfo.specializationData.data() + entry.offset, &value,
+                sizeof(T));
+  }
 
   void bind(VkCommandBuffer commandBuffer);
 
-private:
-  static std::vector<char> readFile(const std::string &path);
+  id_t getId() const { return id; }
 
+  // Number of pipelines created so far and the time spent in the driver
+  // creating them, in milliseconds. Shows what the pipeline cache saves.
+  static std::uint32_t getCreatedCount();
+  static double getCreationTime();
+
+private:
   void createGraphicsPipeline(const std::string &vert, const std::string &frag,
                               const PipelineConfigInfo &configInfo);
-
-  void createShaderModule(const std::vector<char> &code,
-                          VkShaderModule *shaderModule);
+  void createComputePipeline(const std::string &comp,
+                             VkPipelineLayout pipelineLayout);
 
   VlknDevice &vlknDevice;
-  VkPipeline graphicsPipeline;
-  VkShaderModule vertShaderModule;
-  VkShaderModule fragShaderModule;
+  id_t id;
+  VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  VkPipeline pipeline = VK_NULL_HANDLE;
 };
 
 } // namespace vlkn
@@ -0,0 +1,86 @@
+// header
+#include "vlkn_pipeline_builder.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace vlkn {
+
+VlknAsyncPipeline::VlknAsyncPipeline(
+    std::future<std::unique_ptr<VlknPipeline>> future)
+    : future(std::move(future)) {}
+
+VlknAsyncPipeline::~VlknAsyncPipeline() {
+  if (future.valid()) {
+    future.wait();
+  }
+}
+
+VlknAsyncPipeline &VlknAsyncPipeline::operator=(VlknAsyncPipeline &&other) {
+  if (future.valid()) {
+    future.wait();
+  }
+  future = std::move(other.future);
+  pipeline = std::move(other.pipeline);
+  return *this;
+}
+
+VlknPipeline *VlknAsyncPipeline::get() {
+  if (pipeline == nullptr && future.valid() &&
+      future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+    pipeline = future.get();
+  }
+  return pipeline.get();
+}
+
+VlknPipeline &VlknAsyncPipeline::wait() {
+  if (pipeline == nullptr && future.valid()) {
+    pipeline = future.get();
+  }
+  return *pipeline;
+}
+
+VlknPipelineBuilder::VlknPipelineBuilder(std::uint32_t threadCount)
+    : threadPool(threadCount) {}
+
+VlknPipelineBuilder::~VlknPipelineBuilder() { waitIdle(); }
+
+std::uint32_t VlknPipelineBuilder::defaultThreadCount() {
+  return std::max(VlknThreadPool::defaultThreadCount() / 2, 1u);
+}
+
+VlknAsyncPipeline VlknPipelineBuilder::build(CreateFunction create) {
+  {
+    std::lock_guard<std::mutex> lock{pendingMutex};
+    pendingCount++;
+  }
+
+  return VlknAsyncPipeline{
+      threadPool.submit([this, create = std::move(create)]() {
+        try {
+          std::unique_ptr<VlknPipeline> pipeline = create();
+          finishTask();
+          return pipeline;
+        } catch (...) {
+          finishTask();
+          throw;
+        }
+      })};
+}
+
+void VlknPipelineBuilder::waitIdle() {
+  std::unique_lock<std::mutex> lock{pendingMutex};
+  idleCondition.wait(lock, [this]() { return pendingCount == 0; });
+}
+
+void VlknPipelineBuilder::finishTask() {
+  {
+    std::lock_guard<std::mutex> lock{pendingMutex};
+    pendingCount--;
+  }
+  idleCondition.notify_all();
+}
+
+} // namespace vlkn
@@ -0,0 +1,79 @@
+#pragma once
+
+// local
+#include "vlkn_pipeline.hpp"
+#include "vlkn_thread_pool.hpp"
+
+// std
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+
+namespace vlkn {
+
+// Pipeline being created by a VlknPipelineBuilder. Destroying or replacing
+// it waits for the creation to finish, so the objects the creation uses
+// must outlive it.
+class VlknAsyncPipeline {
+public:
+  VlknAsyncPipeline() = default;
+  explicit VlknAsyncPipeline(std::future<std::unique_ptr<VlknPipeline>> future);
+  ~VlknAsyncPipeline();
+
+  VlknAsyncPipeline(const VlknAsyncPipeline &) = delete;
+  VlknAsyncPipeline &operator=(const VlknAsyncPipeline &) = delete;
+  VlknAsyncPipeline(VlknAsyncPipeline &&other) = default;
+  VlknAsyncPipeline &operator=(VlknAsyncPipeline &&other);
+
+  // Null while the pipeline is still being created, never blocks. Errors
+  // of the creation are rethrown here or in wait().
+  VlknPipeline *get();
+  // Blocks until the pipeline has been created
+  VlknPipeline &wait();
+
+private:
+  std::future<std::unique_ptr<VlknPipeline>> future{};
+  std::unique_ptr<VlknPipeline> pipeline{};
+};
+
+// Creates pipelines on worker threads of its own, so long compiles never
+// hold up the frame work of the app's thread pool. vkCreateGraphicsPipelines
+// and vkCreateShaderModule may be called from several threads at once, and
+// the device's pipeline cache is internally synchronised.
+class VlknPipelineBuilder {
+public:
+  using CreateFunction = std::function<std::unique_ptr<VlknPipeline>()>;
+
+  VlknPipelineBuilder(std::uint32_t threadCount = defaultThreadCount());
+  ~VlknPipelineBuilder();
+
+  VlknPipelineBuilder(const VlknPipelineBuilder &) = delete;
+  VlknPipelineBuilder &operator=(const VlknPipelineBuilder &) = delete;
+
+  // Half of the app's pool, builds compete with the frame for the cores
+  static std::uint32_t defaultThreadCount();
+
+  std::uint32_t getThreadCount() const { return threadPool.getThreadCount(); }
+
+  // Runs create on a worker. The function builds its own PipelineConfigInfo,
+  // since the config holds pointers into the stack of its creator.
+  VlknAsyncPipeline build(CreateFunction create);
+
+  // Blocks until every pipeline built so far has been created
+  void waitIdle();
+
+private:
+  void finishTask();
+
+  // Declared before the pool, whose workers use them until they are joined
+  std::mutex pendingMutex;
+  std::condition_variable idleCondition;
+  std::uint32_t pendingCount = 0;
+
+  VlknThreadPool threadPool;
+};
+
+} // namespace vlkn
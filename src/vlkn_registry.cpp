@@ -0,0 +1,47 @@
+// header
+#include "vlkn_registry.hpp"
+
+namespace vlkn {
+
+Entity VlknRegistry::create() {
+  if (!freeIndices.empty()) {
+    std::uint32_t index = freeIndices.back();
+    freeIndices.pop_back();
+    generations[index] &= ~FREE_BIT;
+    return Entity{index, generations[index]};
+  }
+
+  generations.push_back(0);
+  return Entity{static_cast<std::uint32_t>(generations.size() - 1), 0};
+}
+
+void VlknRegistry::destroy(Entity entity) {
+  if (!isAlive(entity)) {
+    return;
+  }
+
+  for (auto &componentPool : pools) {
+    if (componentPool != nullptr) {
+      componentPool->remove(entity.index);
+    }
+  }
+
+  // Invalidates every outstanding handle to this slot
+  generations[entity.index] =
+      ((generations[entity.index] + 1) & ~FREE_BIT) | FREE_BIT;
+  freeIndices.push_back(entity.index);
+}
+
+bool VlknRegistry::isAlive(Entity entity) const {
+  return entity.index < generations.size() &&
+         generations[entity.index] == entity.generation;
+}
+
+Entity VlknRegistry::entityAt(std::uint32_t index) const {
+  if (index >= generations.size() || (generations[index] & FREE_BIT) != 0) {
+    return NULL_ENTITY;
+  }
+  return Entity{index, generations[index]};
+}
+
+} // namespace vlkn
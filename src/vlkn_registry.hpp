@@ -0,0 +1,251 @@
+#pragma once
+
+// std
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace vlkn {
+
+// Index into the registry plus the generation the slot had when the entity
+// was created, so handles to destroyed entities are detected after the index
+// is reused
+struct Entity {
+  static constexpr std::uint32_t INVALID_INDEX =
+      std::numeric_limits<std::uint32_t>::max();
+
+  std::uint32_t index = INVALID_INDEX;
+  std::uint32_t generation = 0;
+
+  bool operator==(const Entity &other) const = default;
+};
+
+constexpr Entity NULL_ENTITY{};
+
+// Sparse set bookkeeping shared by all component types. sparse maps an entity
+// index to a position in the dense arrays, which are kept packed by moving
+// the last element into every hole.
+class ComponentPoolBase {
+public:
+  static constexpr std::uint32_t ABSENT =
+      std::numeric_limits<std::uint32_t>::max();
+
+  virtual ~ComponentPoolBase() = default;
+
+  virtual void remove(std::uint32_t entityIndex) = 0;
+
+  bool contains(std::uint32_t entityIndex) const {
+    return entityIndex < sparse.size() && sparse[entityIndex] != ABSENT;
+  }
+
+  std::size_t size() const { return entities.size(); }
+
+  const std::vector<Entity> &getEntities() const { return entities; }
+
+protected:
+  std::uint32_t insertEntity(Entity entity) {
+    if (entity.index >= sparse.size()) {
+      sparse.resize(entity.index + 1, ABSENT);
+    }
+
+    std::uint32_t denseIndex = static_cast<std::uint32_t>(entities.size());
+    sparse[entity.index] = denseIndex;
+    entities.push_back(entity);
+    return denseIndex;
+  }
+
+  // Returns the dense index that was vacated and now holds the last element
+  std::uint32_t eraseEntity(std::uint32_t entityIndex) {
+    std::uint32_t denseIndex = sparse[entityIndex];
+    Entity last = entities.back();
+
+    entities[denseIndex] = last;
+    sparse[last.index] = denseIndex;
+    sparse[entityIndex] = ABSENT;
+    entities.pop_back();
+    return denseIndex;
+  }
+
+  std::vector<std::uint32_t> sparse{};
+  std::vector<Entity> entities{};
+};
+
+template <typename T> class ComponentPool : public ComponentPoolBase {
+public:
+  template <typename... Args> T &emplace(Entity entity, Args &&...args) {
+    assert(!contains(entity.index) && "Entity already has this component");
+
+    insertEntity(entity);
+    components.push_back(T{std::forward<Args>(args)...});
+    return components.back();
+  }
+
+  void remove(std::uint32_t entityIndex) override {
+    if (!contains(entityIndex)) {
+      return;
+    }
+
+    std::uint32_t denseIndex = eraseEntity(entityIndex);
+    if (denseIndex != components.size() - 1) {
+      components[denseIndex] = std::move(components.back());
+    }
+    components.pop_back();
+  }
+
+  T &get(std::uint32_t entityIndex) {
+    assert(contains(entityIndex) && "Entity does not have this component");
+    return components[sparse[entityIndex]];
+  }
+
+  const T &get(std::uint32_t entityIndex) const {
+    assert(contains(entityIndex) && "Entity does not have this component");
+    return components[sparse[entityIndex]];
+  }
+
+  std::vector<T> &getComponents() { return components; }
+
+private:
+  std::vector<T> components{};
+};
+
+// Entity-component store with one densely packed array per component type.
+// References to components stay valid only until a component of the same
+// type is added or removed.
+class VlknRegistry {
+public:
+  template <typename... Ts> class View;
+
+  VlknRegistry() = default;
+
+  VlknRegistry(const VlknRegistry &) = delete;
+  VlknRegistry &operator=(const VlknRegistry &) = delete;
+
+  Entity create();
+  void destroy(Entity entity);
+  bool isAlive(Entity entity) const;
+
+  // Handle of the live entity in slot index, or NULL_ENTITY
+  Entity entityAt(std::uint32_t index) const;
+
+  std::size_t getEntityCount() const {
+    return generations.size() - freeIndices.size();
+  }
+
+  template <typename T, typename... Args>
+  T &emplace(Entity entity, Args &&...args) {
+    assert(isAlive(entity) && "Cannot add a component to a dead entity");
+    return pool<T>().emplace(entity, std::forward<Args>(args)...);
+  }
+
+  template <typename T> void remove(Entity entity) {
+    assert(isAlive(entity) && "Cannot remove a component of a dead entity");
+    pool<T>().remove(entity.index);
+  }
+
+  template <typename T> bool has(Entity entity) const {
+    const ComponentPool<T> *componentPool = findPool<T>();
+    return isAlive(entity) && componentPool != nullptr &&
+           componentPool->contains(entity.index);
+  }
+
+  template <typename T> T &get(Entity entity) {
+    assert(isAlive(entity) && "Cannot get a component of a dead entity");
+    return pool<T>().get(entity.index);
+  }
+
+  template <typename T> T *tryGet(Entity entity) {
+    return has<T>(entity) ? &pool<T>().get(entity.index) : nullptr;
+  }
+
+  template <typename T> const T *tryGet(Entity entity) const {
+    return has<T>(entity) ? &findPool<T>()->get(entity.index) : nullptr;
+  }
+
+  // Dense array of every T, in no particular entity order
+  template <typename T> std::vector<T> &getComponents() {
+    return pool<T>().getComponents();
+  }
+
+  // Entities that have every one of Ts. Components must not be added or
+  // removed while a view is iterated.
+  template <typename... Ts> View<Ts...> view() {
+    return View<Ts...>{pool<Ts>()...};
+  }
+
+private:
+  static std::uint32_t nextComponentTypeId() {
+    static std::uint32_t nextId = 0;
+    return nextId++;
+  }
+
+  template <typename T> static std::uint32_t componentTypeId() {
+    static const std::uint32_t id = nextComponentTypeId();
+    return id;
+  }
+
+  template <typename T> ComponentPool<T> &pool() {
+    std::uint32_t typeId = componentTypeId<T>();
+    if (typeId >= pools.size()) {
+      pools.resize(typeId + 1);
+    }
+    if (pools[typeId] == nullptr) {
+      pools[typeId] = std::make_unique<ComponentPool<T>>();
+    }
+    return static_cast<ComponentPool<T> &>(*pools[typeId]);
+  }
+
+  template <typename T> const ComponentPool<T> *findPool() const {
+    std::uint32_t typeId = componentTypeId<T>();
+    if (typeId >= pools.size()) {
+      return nullptr;
+    }
+    return static_cast<const ComponentPool<T> *>(pools[typeId].get());
+  }
+
+  // Set in the generation of unused slots so no handle can match them
+  static constexpr std::uint32_t FREE_BIT = 1u << 31;
+
+  std::vector<std::uint32_t> generations{};
+  std::vector<std::uint32_t> freeIndices{};
+  std::vector<std::unique_ptr<ComponentPoolBase>> pools{};
+};
+
+template <typename... Ts> class VlknRegistry::View {
+public:
+  View(ComponentPool<Ts> &...componentPools) : pools{componentPools...} {}
+
+  // Calls f(entity, components...) for every matching entity. The smallest
+  // pool drives the iteration, so its components are visited in dense order
+  // and the other pools are only probed through their sparse arrays.
+  template <typename F> void each(F &&f) {
+    const ComponentPoolBase *driver = smallestPool();
+
+    for (Entity entity : driver->getEntities()) {
+      if ((std::get<ComponentPool<Ts> &>(pools).contains(entity.index) &&
+           ...)) {
+        f(entity, std::get<ComponentPool<Ts> &>(pools).get(entity.index)...);
+      }
+    }
+  }
+
+private:
+  const ComponentPoolBase *smallestPool() const {
+    const ComponentPoolBase *smallest = &std::get<0>(pools);
+    auto consider = [&](const ComponentPoolBase &candidate) {
+      if (candidate.size() < smallest->size()) {
+        smallest = &candidate;
+      }
+    };
+    (consider(std::get<ComponentPool<Ts> &>(pools)), ...);
+    return smallest;
+  }
+
+  std::tuple<ComponentPool<Ts> &...> pools;
+};
+
+} // namespace vlkn
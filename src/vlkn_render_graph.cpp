@@ -0,0 +1,570 @@
+// header
+#include "vlkn_render_graph.hpp"
+
+// local
+#include "vlkn_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+namespace vlkn {
+
+VlknRenderGraph::Pass &VlknRenderGraph::Pass::read(RenderGraphImage image,
+                                                   RenderGraphUsage usage) {
+  uses.push_back(Use{true, false, image.index, usage});
+  return *this;
+}
+
+VlknRenderGraph::Pass &VlknRenderGraph::Pass::write(RenderGraphImage image,
+                                                    RenderGraphUsage usage) {
+  assert(usageInfo(usage).writeAccess != 0 && "Usage cannot write");
+  uses.push_back(Use{true, true, image.index, usage});
+  return *this;
+}
+
+VlknRenderGraph::Pass &VlknRenderGraph::Pass::read(RenderGraphBuffer buffer,
+                                                   RenderGraphUsage usage) {
+  uses.push_back(Use{false, false, buffer.index, usage});
+  return *this;
+}
+
+VlknRenderGraph::Pass &VlknRenderGraph::Pass::write(RenderGraphBuffer buffer,
+                                                    RenderGraphUsage usage) {
+  assert(usageInfo(usage).writeAccess != 0 && "Usage cannot write");
+  uses.push_back(Use{false, true, buffer.index, usage});
+  return *this;
+}
+
+VlknRenderGraph::Pass &VlknRenderGraph::Pass::setSideEffects() {
+  sideEffects = true;
+  return *this;
+}
+
+VlknRenderGraph::Pass &VlknRenderGraph::Pass::setRecord(RecordFunction record) {
+  recordFunction = std::move(record);
+  return *this;
+}
+
+VlknRenderGraph::VlknRenderGraph(VlknDevice &device,
+                                 std::uint32_t framesInFlight)
+    : vlknDevice(device) {
+  transientSets.resize(framesInFlight);
+}
+
+VlknRenderGraph::~VlknRenderGraph() {
+  for (TransientSet &transientSet : transientSets) {
+    destroyTransients(transientSet);
+  }
+}
+
+VlknRenderGraph::UsageInfo VlknRenderGraph::usageInfo(RenderGraphUsage usage) {
+  switch (usage) {
+  case RenderGraphUsage::None:
+    return {0, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED};
+  case RenderGraphUsage::SwapChainAcquire:
+    return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0,
+            VK_IMAGE_LAYOUT_UNDEFINED};
+  case RenderGraphUsage::ColorAttachment:
+    return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  case RenderGraphUsage::DepthAttachment:
+    return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+  case RenderGraphUsage::FragmentSampled:
+    return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  case RenderGraphUsage::FragmentDepthSampled:
+    return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+  case RenderGraphUsage::FragmentStorage:
+    return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL};
+  case RenderGraphUsage::VertexAttribute:
+    return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED};
+  case RenderGraphUsage::ComputeStorage:
+    return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL};
+  case RenderGraphUsage::Present:
+    return {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+  }
+  return {0, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED};
+}
+
+VlknRenderGraph::ResourceState
+VlknRenderGraph::initialState(RenderGraphUsage previousUsage,
+                              bool keepContents) {
+  const UsageInfo info = usageInfo(previousUsage);
+
+  ResourceState state{};
+  state.layout = keepContents ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+  // Usages that may write are assumed to have written
+  if (info.writeAccess != 0) {
+    state.writeStages = info.stages;
+    state.writeAccess = info.writeAccess;
+  } else {
+    state.readStages = info.stages;
+  }
+  return state;
+}
+
+RenderGraphImage VlknRenderGraph::importImage(VkImage image,
+                                              VkImageAspectFlags aspect,
+                                              RenderGraphUsage previousUsage,
+                                              RenderGraphUsage finalUsage,
+                                              bool keepContents) {
+  Image imported{};
+  imported.image = image;
+  imported.aspect = aspect;
+  imported.finalUsage = finalUsage;
+  imported.state = initialState(previousUsage, keepContents);
+  images.push_back(imported);
+  return {static_cast<std::uint32_t>(images.size() - 1)};
+}
+
+RenderGraphBuffer
+VlknRenderGraph::importBuffer(const VkDescriptorBufferInfo &bufferInfo,
+                              RenderGraphUsage previousUsage) {
+  Buffer imported{};
+  imported.buffer = bufferInfo.buffer;
+  imported.offset = bufferInfo.offset;
+  imported.size = bufferInfo.range;
+  imported.state = initialState(previousUsage, true);
+  buffers.push_back(imported);
+  return {static_cast<std::uint32_t>(buffers.size() - 1)};
+}
+
+RenderGraphImage
+VlknRenderGraph::createImage(const RenderGraphImageDesc &desc) {
+  Image transient{};
+  transient.aspect = desc.aspect;
+  transient.transient = true;
+  transient.transientIndex =
+      static_cast<std::uint32_t>(transientImages.size());
+  transient.desc = desc;
+  transientImages.push_back(static_cast<std::uint32_t>(images.size()));
+  images.push_back(transient);
+  return {static_cast<std::uint32_t>(images.size() - 1)};
+}
+
+VlknRenderGraph::Pass &VlknRenderGraph::addPass() {
+  passes.emplace_back();
+  return passes.back();
+}
+
+VkImage VlknRenderGraph::getImage(RenderGraphImage image) const {
+  return images[image.index].image;
+}
+
+VkImageView VlknRenderGraph::getImageView(RenderGraphImage image) const {
+  assert(images[image.index].transient &&
+         "Imported images have no view owned by the graph");
+  return images[image.index].view;
+}
+
+std::vector<std::uint32_t> VlknRenderGraph::cullPasses() const {
+  std::vector<bool> imageNeeded(images.size(), false);
+  std::vector<bool> live(passes.size(), false);
+
+  // A pass is live if it has side effects or writes something that outlives
+  // the frame or that a later live pass reads. Buffers are always imported.
+  for (std::size_t i = passes.size(); i-- > 0;) {
+    const Pass &pass = passes[i];
+
+    bool isLive = pass.sideEffects;
+    for (const Pass::Use &use : pass.uses) {
+      if (use.isWrite &&
+          (!use.isImage || !images[use.index].transient ||
+           imageNeeded[use.index])) {
+        isLive = true;
+      }
+    }
+
+    if (!isLive) {
+      continue;
+    }
+
+    live[i] = true;
+    for (const Pass::Use &use : pass.uses) {
+      if (use.isImage && !use.isWrite) {
+        imageNeeded[use.index] = true;
+      }
+    }
+  }
+
+  std::vector<std::uint32_t> livePasses{};
+  for (std::uint32_t i = 0; i < passes.size(); i++) {
+    if (live[i]) {
+      livePasses.push_back(i);
+    }
+  }
+  return livePasses;
+}
+
+void VlknRenderGraph::allocateTransients(
+    const std::vector<std::uint32_t> &livePasses, std::uint32_t frameIndex) {
+  const std::size_t count = transientImages.size();
+
+  std::vector<TransientKey> keys(count);
+  for (std::size_t i = 0; i < count; i++) {
+    keys[i].desc = images[transientImages[i]].desc;
+    keys[i].firstPass = std::numeric_limits<std::uint32_t>::max();
+    keys[i].lastPass = 0;
+  }
+  for (std::uint32_t position = 0; position < livePasses.size(); position++) {
+    for (const Pass::Use &use : passes[livePasses[position]].uses) {
+      if (use.isImage && images[use.index].transient) {
+        TransientKey &key = keys[images[use.index].transientIndex];
+        key.firstPass = std::min(key.firstPass, position);
+        key.lastPass = std::max(key.lastPass, position);
+      }
+    }
+  }
+
+  TransientSet &transientSet = transientSets[frameIndex];
+  if (transientSet.keys == keys) {
+    return;
+  }
+
+  // The frame index's last frame was waited on, so its old images are no
+  // longer in use
+  destroyTransients(transientSet);
+  transientSet.keys = keys;
+  transientSet.images.resize(count, VK_NULL_HANDLE);
+  transientSet.views.resize(count, VK_NULL_HANDLE);
+  transientSet.aliasPredecessors.resize(count);
+
+  auto isUsed = [&](std::size_t i) {
+    return keys[i].firstPass <= keys[i].lastPass;
+  };
+  auto livesOverlap = [&](std::size_t a, std::size_t b) {
+    return keys[a].firstPass <= keys[b].lastPass &&
+           keys[b].firstPass <= keys[a].lastPass;
+  };
+
+  std::vector<VkMemoryRequirements> requirements(count);
+  std::uint32_t memoryTypeBits = ~0u;
+  std::vector<std::size_t> order{};
+
+  for (std::size_t i = 0; i < count; i++) {
+    if (!isUsed(i)) {
+      continue;
+    }
+
+    const RenderGraphImageDesc &desc = keys[i].desc;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = desc.extent.width;
+    imageInfo.extent.height = desc.extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = desc.format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = desc.usage;
+    imageInfo.samples = desc.samples;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(vlknDevice.device(), &imageInfo, nullptr,
+                      &transientSet.images[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create transient image!");
+    }
+
+    vkGetImageMemoryRequirements(vlknDevice.device(), transientSet.images[i],
+                                 &requirements[i]);
+    memoryTypeBits &= requirements[i].memoryTypeBits;
+    order.push_back(i);
+  }
+
+  if (order.empty()) {
+    return;
+  }
+
+  // Largest first, each image goes to the lowest offset that does not
+  // overlap an image whose lifetime overlaps its own
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+    return requirements[a].size > requirements[b].size;
+  });
+
+  std::vector<VkDeviceSize> offsets(count, 0);
+  std::vector<std::size_t> placed{};
+  VkDeviceSize memorySize = 0;
+
+  for (std::size_t i : order) {
+    const VkDeviceSize size = requirements[i].size;
+    const VkDeviceSize alignment = requirements[i].alignment;
+
+    std::vector<VkDeviceSize> candidates = {0};
+    for (std::size_t other : placed) {
+      if (livesOverlap(i, other)) {
+        candidates.push_back(offsets[other] + requirements[other].size);
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (VkDeviceSize candidate : candidates) {
+      const VkDeviceSize offset =
+          (candidate + alignment - 1) / alignment * alignment;
+      const bool fits =
+          std::none_of(placed.begin(), placed.end(), [&](std::size_t other) {
+            return livesOverlap(i, other) &&
+                   offset < offsets[other] + requirements[other].size &&
+                   offsets[other] < offset + size;
+          });
+      if (fits) {
+        offsets[i] = offset;
+        break;
+      }
+    }
+
+    // Images sharing memory with this one that are done before it starts,
+    // or that start after it is done
+    for (std::size_t other : placed) {
+      const bool sharesMemory =
+          offsets[i] < offsets[other] + requirements[other].size &&
+          offsets[other] < offsets[i] + size;
+      if (!sharesMemory || livesOverlap(i, other)) {
+        continue;
+      }
+      if (keys[other].lastPass < keys[i].firstPass) {
+        transientSet.aliasPredecessors[i].push_back(
+            static_cast<std::uint32_t>(other));
+      } else {
+        transientSet.aliasPredecessors[other].push_back(
+            static_cast<std::uint32_t>(i));
+      }
+    }
+
+    placed.push_back(i);
+    memorySize = std::max(memorySize, offsets[i] + size);
+  }
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memorySize;
+  allocInfo.memoryTypeIndex = vlknDevice.findMemoryType(
+      memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  if (vkAllocateMemory(vlknDevice.device(), &allocInfo, nullptr,
+                       &transientSet.memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate transient image memory!");
+  }
+
+  for (std::size_t i : order) {
+    if (vkBindImageMemory(vlknDevice.device(), transientSet.images[i],
+                          transientSet.memory, offsets[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to bind transient image memory!");
+    }
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = transientSet.images[i];
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = keys[i].desc.format;
+    viewInfo.subresourceRange.aspectMask = keys[i].desc.aspect;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(vlknDevice.device(), &viewInfo, nullptr,
+                          &transientSet.views[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create transient image view!");
+    }
+  }
+}
+
+void VlknRenderGraph::destroyTransients(TransientSet &transientSet) {
+  for (std::size_t i = 0; i < transientSet.images.size(); i++) {
+    vkDestroyImageView(vlknDevice.device(), transientSet.views[i], nullptr);
+    vkDestroyImage(vlknDevice.device(), transientSet.images[i], nullptr);
+  }
+  vkFreeMemory(vlknDevice.device(), transientSet.memory, nullptr);
+
+  transientSet = TransientSet{};
+}
+
+bool VlknRenderGraph::syncUse(ResourceState &state, RenderGraphUsage usage,
+                              bool isWrite, bool isImage, Sync &sync) {
+  const UsageInfo info = usageInfo(usage);
+  const VkAccessFlags dstAccess =
+      info.readAccess | (isWrite ? info.writeAccess : 0);
+  const bool layoutChange = isImage && state.layout != info.layout;
+
+  sync.dstStages = info.stages;
+  sync.dstAccess = dstAccess;
+  sync.oldLayout = state.layout;
+  sync.newLayout = isImage ? info.layout : state.layout;
+
+  if (isWrite || layoutChange) {
+    // Waits for the last write and every read since, a layout transition
+    // counts as a write to later uses
+    sync.srcStages = state.writeStages | state.readStages;
+    sync.srcAccess = state.writeAccess;
+
+    state.layout = sync.newLayout;
+    state.writeStages = info.stages;
+    state.writeAccess = isWrite ? info.writeAccess : 0;
+    state.visibleStages = isWrite ? 0 : info.stages;
+    state.visibleAccess = isWrite ? 0 : dstAccess;
+    state.readStages = isWrite ? 0 : info.stages;
+
+    return layoutChange || sync.srcStages != 0;
+  }
+
+  const bool visible = (state.visibleStages & info.stages) == info.stages &&
+                       (state.visibleAccess & dstAccess) == dstAccess;
+  state.readStages |= info.stages;
+  if (state.writeStages == 0 || visible) {
+    return false;
+  }
+
+  sync.srcStages = state.writeStages;
+  sync.srcAccess = state.writeAccess;
+  state.visibleStages |= info.stages;
+  state.visibleAccess |= dstAccess;
+
+  return true;
+}
+
+void VlknRenderGraph::addImageBarrier(Image &image, RenderGraphUsage usage,
+                                      bool isWrite) {
+  Sync sync{};
+  if (!syncUse(image.state, usage, isWrite, true, sync)) {
+    return;
+  }
+
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = sync.srcAccess;
+  barrier.dstAccessMask = sync.dstAccess;
+  barrier.oldLayout = sync.oldLayout;
+  barrier.newLayout = sync.newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image.image;
+  barrier.subresourceRange.aspectMask = image.aspect;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+  imageBarriers.push_back(barrier);
+
+  barrierSrcStages |= sync.srcStages;
+  barrierDstStages |= sync.dstStages;
+}
+
+void VlknRenderGraph::addBufferBarrier(Buffer &buffer, RenderGraphUsage usage,
+                                       bool isWrite) {
+  Sync sync{};
+  if (!syncUse(buffer.state, usage, isWrite, false, sync)) {
+    return;
+  }
+
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = sync.srcAccess;
+  barrier.dstAccessMask = sync.dstAccess;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer.buffer;
+  barrier.offset = buffer.offset;
+  barrier.size = buffer.size;
+  bufferBarriers.push_back(barrier);
+
+  barrierSrcStages |= sync.srcStages;
+  barrierDstStages |= sync.dstStages;
+}
+
+void VlknRenderGraph::flushBarriers(VkCommandBuffer commandBuffer) {
+  if (imageBarriers.empty() && bufferBarriers.empty()) {
+    return;
+  }
+
+  // A transition out of an untouched image has nothing to wait for
+  if (barrierSrcStages == 0) {
+    barrierSrcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  }
+
+  vkCmdPipelineBarrier(
+      commandBuffer, barrierSrcStages, barrierDstStages, 0, 0, nullptr,
+      static_cast<std::uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+      static_cast<std::uint32_t>(imageBarriers.size()), imageBarriers.data());
+
+  imageBarriers.clear();
+  bufferBarriers.clear();
+  barrierSrcStages = 0;
+  barrierDstStages = 0;
+}
+
+void VlknRenderGraph::execute(VkCommandBuffer commandBuffer,
+                              std::uint32_t frameIndex) {
+  const std::vector<std::uint32_t> livePasses = cullPasses();
+  allocateTransients(livePasses, frameIndex);
+
+  const TransientSet &transientSet = transientSets[frameIndex];
+  for (Image &image : images) {
+    if (image.transient) {
+      image.image = transientSet.images[image.transientIndex];
+      image.view = transientSet.views[image.transientIndex];
+    }
+  }
+
+  for (std::uint32_t position = 0; position < livePasses.size(); position++) {
+    Pass &pass = passes[livePasses[position]];
+
+    for (const Pass::Use &use : pass.uses) {
+      if (!use.isImage) {
+        addBufferBarrier(buffers[use.index], use.usage, use.isWrite);
+        continue;
+      }
+
+      Image &image = images[use.index];
+      // A transient image starts out undefined, after whatever used its
+      // memory before it this frame
+      if (image.transient &&
+          transientSet.keys[image.transientIndex].firstPass == position) {
+        for (std::uint32_t predecessor :
+             transientSet.aliasPredecessors[image.transientIndex]) {
+          const Image &other = images[transientImages[predecessor]];
+          image.state.writeStages |= other.state.writeStages;
+          image.state.writeAccess |= other.state.writeAccess;
+          image.state.readStages |= other.state.readStages;
+        }
+      }
+      addImageBarrier(image, use.usage, use.isWrite);
+    }
+
+    flushBarriers(commandBuffer);
+
+    if (pass.recordFunction) {
+      pass.recordFunction(commandBuffer);
+    }
+  }
+
+  for (Image &image : images) {
+    if (!image.transient && image.finalUsage != RenderGraphUsage::None) {
+      addImageBarrier(image, image.finalUsage, false);
+    }
+  }
+  flushBarriers(commandBuffer);
+
+  passes.clear();
+  images.clear();
+  buffers.clear();
+  transientImages.clear();
+}
+
+} // namespace vlkn
@@ -0,0 +1,233 @@
+#pragma once
+
+// local
+#include "vlkn_device.hpp"
+
+// libs
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace vlkn {
+
+// How a pass uses a resource. Each usage maps to the pipeline stages, access
+// flags and image layout the graph synchronises with. Whether the use writes
+// is given by calling read() or write().
+enum class RenderGraphUsage : std::uint8_t {
+  // Not used yet, nothing to wait for
+  None,
+  // Swap chain image whose acquire semaphore is waited on at colour
+  // attachment output
+  SwapChainAcquire,
+  ColorAttachment,
+  DepthAttachment,
+  FragmentSampled,
+  // Depth image sampled in the read only depth layout
+  FragmentDepthSampled,
+  FragmentStorage,
+  VertexAttribute,
+  ComputeStorage,
+  Present,
+};
+
+struct RenderGraphImage {
+  std::uint32_t index = std::numeric_limits<std::uint32_t>::max();
+};
+
+struct RenderGraphBuffer {
+  std::uint32_t index = std::numeric_limits<std::uint32_t>::max();
+};
+
+struct RenderGraphImageDesc {
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkExtent2D extent{};
+  VkImageUsageFlags usage = 0;
+  VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+  bool operator==(const RenderGraphImageDesc &other) const = default;
+};
+
+// Frame graph rebuilt every frame. Passes declare which images and buffers
+// they read and write and record their commands in a callback; execute()
+// then culls the passes whose results nobody uses, records the rest in
+// declaration order and puts one batched pipeline barrier in front of each
+// pass for every hazard and layout transition it has on the resources
+// declared before it.
+//
+// Resources are either imported, owned elsewhere and kept alive across
+// frames, or transient, created by the graph and only valid during the
+// frame. Transient images whose pass lifetimes do not overlap share memory.
+// Every frame in flight gets its own transient images, which are only
+// recreated when the declared images or their lifetimes change.
+//
+// Render passes may still transition their own attachments, as long as
+// every image the graph tracks leaves the pass in the layout of the usage
+// it was declared with.
+class VlknRenderGraph {
+public:
+  using RecordFunction = std::function<void(VkCommandBuffer)>;
+
+  class Pass {
+  public:
+    Pass &read(RenderGraphImage image, RenderGraphUsage usage);
+    Pass &write(RenderGraphImage image, RenderGraphUsage usage);
+    Pass &read(RenderGraphBuffer buffer, RenderGraphUsage usage);
+    Pass &write(RenderGraphBuffer buffer, RenderGraphUsage usage);
+    // Keeps the pass even if none of its writes are used
+    Pass &setSideEffects();
+    Pass &setRecord(RecordFunction record);
+
+  private:
+    friend class VlknRenderGraph;
+
+    struct Use {
+      bool isImage;
+      bool isWrite;
+      std::uint32_t index;
+      RenderGraphUsage usage;
+    };
+
+    std::vector<Use> uses{};
+    RecordFunction recordFunction{};
+    bool sideEffects = false;
+  };
+
+  // Transient images are allocated once per frame in flight
+  VlknRenderGraph(VlknDevice &device, std::uint32_t framesInFlight);
+  ~VlknRenderGraph();
+
+  VlknRenderGraph(const VlknRenderGraph &) = delete;
+  VlknRenderGraph &operator=(const VlknRenderGraph &) = delete;
+
+  // previousUsage is the last use before this frame. Without keepContents
+  // the image is transitioned from the undefined layout. A finalUsage other
+  // than None is transitioned to after the last pass.
+  RenderGraphImage importImage(VkImage image, VkImageAspectFlags aspect,
+                               RenderGraphUsage previousUsage,
+                               RenderGraphUsage finalUsage,
+                               bool keepContents = true);
+  RenderGraphBuffer importBuffer(const VkDescriptorBufferInfo &bufferInfo,
+                                 RenderGraphUsage previousUsage);
+  RenderGraphImage createImage(const RenderGraphImageDesc &desc);
+
+  // The reference is only valid until the next addPass()
+  Pass &addPass();
+
+  // Only valid inside of a record function
+  VkImage getImage(RenderGraphImage image) const;
+  VkImageView getImageView(RenderGraphImage image) const;
+
+  // Records every pass that is not culled and clears the graph for the next
+  // frame. frameIndex selects the transient images, whose previous users
+  // must have finished.
+  void execute(VkCommandBuffer commandBuffer, std::uint32_t frameIndex);
+
+private:
+  struct UsageInfo {
+    VkPipelineStageFlags stages;
+    VkAccessFlags readAccess;
+    VkAccessFlags writeAccess;
+    VkImageLayout layout;
+  };
+
+  // Hazard tracking of one resource during execute()
+  struct ResourceState {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // Last write, and the stages and accesses it has been made visible to
+    VkPipelineStageFlags writeStages = 0;
+    VkAccessFlags writeAccess = 0;
+    VkPipelineStageFlags visibleStages = 0;
+    VkAccessFlags visibleAccess = 0;
+    // Reads since the last write, later writes wait for them
+    VkPipelineStageFlags readStages = 0;
+  };
+
+  // Masks and layouts of one barrier
+  struct Sync {
+    VkPipelineStageFlags srcStages = 0;
+    VkAccessFlags srcAccess = 0;
+    VkPipelineStageFlags dstStages = 0;
+    VkAccessFlags dstAccess = 0;
+    VkImageLayout oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageLayout newLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  };
+
+  struct Image {
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    bool transient = false;
+    std::uint32_t transientIndex = 0;
+    RenderGraphImageDesc desc{};
+    RenderGraphUsage finalUsage = RenderGraphUsage::None;
+    ResourceState state{};
+  };
+
+  struct Buffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = VK_WHOLE_SIZE;
+    ResourceState state{};
+  };
+
+  struct TransientKey {
+    RenderGraphImageDesc desc{};
+    // First and last live pass using the image, first > last if unused
+    std::uint32_t firstPass = 0;
+    std::uint32_t lastPass = 0;
+
+    bool operator==(const TransientKey &other) const = default;
+  };
+
+  // Transient images of one frame in flight
+  struct TransientSet {
+    std::vector<TransientKey> keys{};
+    std::vector<VkImage> images{};
+    std::vector<VkImageView> views{};
+    // Images that used the same memory earlier in the frame
+    std::vector<std::vector<std::uint32_t>> aliasPredecessors{};
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+  };
+
+  static UsageInfo usageInfo(RenderGraphUsage usage);
+  static ResourceState initialState(RenderGraphUsage previousUsage,
+                                    bool keepContents);
+
+  // Marks the passes that write a resource a later live pass reads, or an
+  // imported resource, and returns the indices of the live passes
+  std::vector<std::uint32_t> cullPasses() const;
+  void allocateTransients(const std::vector<std::uint32_t> &livePasses,
+                          std::uint32_t frameIndex);
+  void destroyTransients(TransientSet &transientSet);
+
+  // Updates the state for a use and returns whether it needs a barrier
+  static bool syncUse(ResourceState &state, RenderGraphUsage usage,
+                      bool isWrite, bool isImage, Sync &sync);
+  // Add the barrier a use needs, if any, to the batch in front of the pass
+  void addImageBarrier(Image &image, RenderGraphUsage usage, bool isWrite);
+  void addBufferBarrier(Buffer &buffer, RenderGraphUsage usage, bool isWrite);
+  void flushBarriers(VkCommandBuffer commandBuffer);
+
+  VlknDevice &vlknDevice;
+
+  std::vector<Pass> passes{};
+  std::vector<Image> images{};
+  std::vector<Buffer> buffers{};
+  // Index into images of every transient image
+  std::vector<std::uint32_t> transientImages{};
+
+  std::vector<TransientSet> transientSets{};
+
+  // Barriers batched in front of the pass being recorded
+  std::vector<VkImageMemoryBarrier> imageBarriers{};
+  std::vector<VkBufferMemoryBarrier> bufferBarriers{};
+  VkPipelineStageFlags barrierSrcStages = 0;
+  VkPipelineStageFlags barrierDstStages = 0;
+};
+
+} // namespace vlkn
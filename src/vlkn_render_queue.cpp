@@ -0,0 +1,165 @@
+// header
+#include "vlkn_render_queue.hpp"
+
+// std
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace vlkn {
+
+namespace {
+
+constexpr std::uint32_t PASS_SHIFT = 60;
+
+constexpr std::uint64_t bits(std::uint64_t value, std::uint32_t width,
+                             std::uint32_t shift) {
+  return (value & ((std::uint64_t{1} << width) - 1)) << shift;
+}
+
+// The bit pattern of a non-negative float grows with its value, so the top
+// bits of it are an order preserving, logarithmically spaced depth key
+std::uint32_t depthBits(float viewDistance) {
+  return std::bit_cast<std::uint32_t>(std::max(viewDistance, 0.0f));
+}
+
+} // namespace
+
+std::uint64_t VlknRenderQueue::makeOpaqueKey(std::uint32_t pipelineId,
+                                             std::uint32_t materialId,
+                                             std::uint32_t meshId,
+                                             float viewDistance) {
+  return bits(static_cast<std::uint64_t>(DrawPass::Opaque), 4, PASS_SHIFT) |
+         bits(pipelineId, 12, 48) | bits(materialId, 12, 36) |
+         bits(meshId, 16, 20) | bits(depthBits(viewDistance) >> 11, 20, 0);
+}
+
+std::uint64_t VlknRenderQueue::makeDepthPrepassKey(std::uint32_t pipelineId,
+                                                   std::uint32_t meshId,
+                                                   float viewDistance) {
+  return bits(static_cast<std::uint64_t>(DrawPass::DepthPrepass), 4,
+              PASS_SHIFT) |
+         bits(pipelineId, 12, 48) | bits(meshId, 16, 20) |
+         bits(depthBits(viewDistance) >> 11, 20, 0);
+}
+
+std::uint64_t VlknRenderQueue::makeTransparentKey(std::uint32_t pipelineId,
+                                                  std::uint32_t materialId,
+                                                  std::uint32_t meshId) {
+  return bits(static_cast<std::uint64_t>(DrawPass::Transparent), 4,
+              PASS_SHIFT) |
+         bits(pipelineId, 12, 48) | bits(materialId, 12, 36) |
+         bits(meshId, 16, 20);
+}
+
+void VlknRenderQueue::clear() {
+  packets.clear();
+  sortedEntries.clear();
+}
+
+void VlknRenderQueue::sort() {
+  sortedEntries.resize(packets.size());
+  sortScratch.resize(packets.size());
+
+  for (std::size_t i = 0; i < packets.size(); i++) {
+    sortedEntries[i] = SortEntry{packets[i].sortKey,
+                                 static_cast<std::uint32_t>(i)};
+  }
+
+  // Least significant digit first, one byte per pass. Passes in which every
+  // key has the same digit are skipped, which is common for the pass and
+  // pipeline bytes.
+  for (std::uint32_t shift = 0; shift < 64; shift += 8) {
+    std::array<std::uint32_t, 256> offsets{};
+
+    for (const SortEntry &entry : sortedEntries) {
+      offsets[(entry.key >> shift) & 0xFF]++;
+    }
+
+    if (std::find(offsets.begin(), offsets.end(), sortedEntries.size()) !=
+        offsets.end()) {
+      continue;
+    }
+
+    std::uint32_t total = 0;
+    for (std::uint32_t &offset : offsets) {
+      std::uint32_t count = offset;
+      offset = total;
+      total += count;
+    }
+
+    for (const SortEntry &entry : sortedEntries) {
+      sortScratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+    }
+
+    sortedEntries.swap(sortScratch);
+  }
+}
+
+std::size_t VlknRenderQueue::findPass(DrawPass pass) const {
+  const std::uint64_t passKey =
+      bits(static_cast<std::uint64_t>(pass), 4, PASS_SHIFT);
+
+  auto it = std::lower_bound(sortedEntries.begin(), sortedEntries.end(),
+                             passKey,
+                             [](const SortEntry &entry, std::uint64_t key) {
+                               return entry.key < key;
+                             });
+  return static_cast<std::size_t>(it - sortedEntries.begin());
+}
+
+void VlknRenderQueue::submit(VkCommandBuffer commandBuffer, std::size_t first,
+                             std::size_t count) const {
+  assert(first + count <= sortedEntries.size() &&
+         "Submitted range exceeds the sorted packets");
+
+  const VlknPipeline *boundPipeline = nullptr;
+  VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+  VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+  const VlknModel *boundModel = nullptr;
+
+  for (std::size_t i = first; i < first + count; i++) {
+    const DrawPacket &packet = packets[sortedEntries[i].packetIndex];
+
+    if (packet.pipeline != boundPipeline) {
+      packet.pipeline->bind(commandBuffer);
+      boundPipeline = packet.pipeline;
+    }
+
+    // Sets stay bound across pipeline changes only while the layouts match
+    if (packet.pipelineLayout != boundLayout ||
+        packet.descriptorSet != boundDescriptorSet) {
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              packet.pipelineLayout, 0, 1,
+                              &packet.descriptorSet, 0, nullptr);
+      boundLayout = packet.pipelineLayout;
+      boundDescriptorSet = packet.descriptorSet;
+    }
+
+    if (packet.model != nullptr && packet.model != boundModel) {
+      packet.model->bind(commandBuffer);
+      boundModel = packet.model;
+    } else if (packet.model == nullptr &&
+               packet.instanceBuffer != VK_NULL_HANDLE) {
+      // Replaces the model's vertex buffer at binding 0
+      const VkDeviceSize offset = 0;
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, &packet.instanceBuffer,
+                             &offset);
+      boundModel = nullptr;
+    }
+
+    if (packet.pushConstantSize > 0) {
+      vkCmdPushConstants(commandBuffer, packet.pipelineLayout,
+                         packet.pushConstantStages, 0, packet.pushConstantSize,
+                         packet.pushConstants.data());
+    }
+
+    if (packet.model != nullptr) {
+      packet.model->draw(commandBuffer, packet.instanceCount);
+    } else {
+      vkCmdDraw(commandBuffer, packet.vertexCount, packet.instanceCount, 0, 0);
+    }
+  }
+}
+
+} // namespace vlkn
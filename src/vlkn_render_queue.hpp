@@ -0,0 +1,122 @@
+#pragma once
+
+// local
+#include "vlkn_model.hpp"
+#include "vlkn_pipeline.hpp"
+
+// libs
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace vlkn {
+
+enum class DrawPass : std::uint8_t {
+  DepthPrepass = 0,
+  Opaque = 1,
+  Transparent = 2,
+};
+
+struct DrawPacket {
+  static constexpr std::uint32_t MAX_PUSH_CONSTANT_SIZE = 128;
+
+  template <typename T>
+  void setPushConstants(VkShaderStageFlags stages, const T &data) {
+    static_assert(sizeof(T) <= MAX_PUSH_CONSTANT_SIZE,
+                  "Push constant data does not fit into a draw packet");
+    pushConstantStages = stages;
+    pushConstantSize = sizeof(T);
+    std::memcpy(pushConstants.data(), &data, sizeof(T));
+  }
+
+  std::uint64_t sortKey = 0;
+
+  VlknPipeline *pipeline = nullptr;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+  // Packets without a model issue a non-indexed draw of vertexCount vertices
+  VlknModel *model = nullptr;
+  std::uint32_t vertexCount = 0;
+  std::uint32_t instanceCount = 1;
+  // Bound to vertex binding 0 for packets without a model, for per instance
+  // vertex attributes
+  VkBuffer instanceBuffer = VK_NULL_HANDLE;
+
+  VkShaderStageFlags pushConstantStages = 0;
+  std::uint32_t pushConstantSize = 0;
+  std::array<std::byte, MAX_PUSH_CONSTANT_SIZE> pushConstants{};
+};
+
+// Collects draw packets from all render systems, orders them by their 64-bit
+// sort key and records them while skipping redundant state changes.
+//
+// Opaque key layout, most significant bits first:
+//   pass (4) | pipeline (12) | material (12) | mesh (16) | depth (20)
+// Depth pre-pass key layout:
+//   pass (4) | pipeline (12) | unused (12) | mesh (16) | depth (20)
+// Transparent key layout:
+//   pass (4) | pipeline (12) | material (12) | mesh (16) | unused (20)
+class VlknRenderQueue {
+public:
+  VlknRenderQueue() = default;
+
+  VlknRenderQueue(const VlknRenderQueue &) = delete;
+  VlknRenderQueue &operator=(const VlknRenderQueue &) = delete;
+
+  // Front to back within equal pipeline, material and mesh
+  static std::uint64_t makeOpaqueKey(std::uint32_t pipelineId,
+                                     std::uint32_t materialId,
+                                     std::uint32_t meshId, float viewDistance);
+
+  // Front to back within equal pipeline and mesh, depth only draws have no
+  // material
+  static std::uint64_t makeDepthPrepassKey(std::uint32_t pipelineId,
+                                           std::uint32_t meshId,
+                                           float viewDistance);
+
+  // Transparency is blended order independently, so transparent packets
+  // are only grouped by state
+  static std::uint64_t makeTransparentKey(std::uint32_t pipelineId,
+                                          std::uint32_t materialId,
+                                          std::uint32_t meshId);
+
+  void clear();
+  void push(const DrawPacket &packet) { packets.push_back(packet); }
+
+  // Stable radix sort of the packet keys
+  void sort();
+
+  void submit(VkCommandBuffer commandBuffer) const {
+    submit(commandBuffer, 0, sortedEntries.size());
+  }
+
+  // Records count sorted packets starting at first. Bound state is tracked
+  // per call, so ranges can be recorded into separate command buffers.
+  void submit(VkCommandBuffer commandBuffer, std::size_t first,
+              std::size_t count) const;
+
+  std::size_t size() const { return packets.size(); }
+
+  // Index of the first sorted packet of pass or a later one, or size() if
+  // there is none. Passes are the top key bits, so the sorted packets of each
+  // pass are contiguous.
+  std::size_t findPass(DrawPass pass) const;
+
+private:
+  struct SortEntry {
+    std::uint64_t key;
+    std::uint32_t packetIndex;
+  };
+
+  std::vector<DrawPacket> packets{};
+  std::vector<SortEntry> sortedEntries{};
+  std::vector<SortEntry> sortScratch{};
+};
+
+} // namespace vlkn
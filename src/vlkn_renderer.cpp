@@ -3,9 +3,11 @@
 #include "vlkn_swap_chain.hpp"
 
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <array>
 #include <bits/fs_fwd.h>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 #include <glm/detail/qualifier.hpp>
 #include <glm/fwd.hpp>
@@ -18,13 +20,43 @@
 
 namespace vlkn {
 
-VlknRenderer::VlknRenderer(VlknWindow &window, VlknDevice &device)
-    : vlknWindow(window), vlknDevice(device) {
+namespace {
+
+void setViewportAndScissorTo(VkCommandBuffer commandBuffer,
+                             VkExtent2D extent) {
+  VkViewport viewport{};
+  viewport.x = 0;
+  viewport.y = 0;
+  viewport.width = static_cast<float>(extent.width);
+  viewport.height = static_cast<float>(extent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  VkRect2D scissor{{0, 0}, extent};
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+} // namespace
+
+VlknRenderer::VlknRenderer(VlknWindow &window, VlknDevice &device,
+                           RenderPath renderPath,
+                           VkSampleCountFlagBits sampleCount,
+                           bool dynamicRendering, uint32_t framesInFlight)
+    : vlknWindow(window), vlknDevice(device), renderPath(renderPath),
+      requestedSampleCount(sampleCount),
+      dynamicRendering(dynamicRendering && device.supportsDynamicRendering()),
+      framesInFlight(std::clamp(framesInFlight,
+                                VlknSwapChain::MIN_FRAMES_IN_FLIGHT,
+                                VlknSwapChain::MAX_FRAMES_IN_FLIGHT)) {
   recreateSwapChain();
   createCommandBuffers();
 }
 
-VlknRenderer::~VlknRenderer() { freeCommandBuffers(); }
+VlknRenderer::~VlknRenderer() {
+  // The device is idle by now
+  deletionQueue.flush();
+  freeCommandBuffers();
+}
 
 void VlknRenderer::recreateSwapChain() {
   VkExtent2D extent = vlknWindow.getExtent();
@@ -33,24 +65,32 @@ void VlknRenderer::recreateSwapChain() {
     glfwWaitEvents();
   }
 
-  vkDeviceWaitIdle(vlknDevice.device());
-
+  // The device is not idled, the old swap chain hands its semaphores over
+  // to the new one and is destroyed once the frames that used it finished
   if (vlknSwapChain == nullptr) {
-    vlknSwapChain = std::make_unique<VlknSwapChain>(vlknDevice, extent);
+    vlknSwapChain = std::make_unique<VlknSwapChain>(
+        vlknDevice, extent, renderPath, requestedSampleCount, dynamicRendering,
+        framesInFlight);
   } else {
     std::shared_ptr<VlknSwapChain> oldSwapChain = std::move(vlknSwapChain);
 
-    vlknSwapChain =
-        std::make_unique<VlknSwapChain>(vlknDevice, extent, oldSwapChain);
+    vlknSwapChain = std::make_unique<VlknSwapChain>(
+        vlknDevice, extent, renderPath, requestedSampleCount, dynamicRendering,
+        framesInFlight, oldSwapChain);
 
     if (!oldSwapChain->compareSwapFormats(*vlknSwapChain.get())) {
-      throw std::runtime_error("Swap chain image or depth format have changed");
+      throw std::runtime_error(
+          "Swap chain image, depth format or sample count have changed");
     }
+
+    deferDestruction([oldSwapChain]() mutable { oldSwapChain.reset(); });
   }
+
+  swapChainGeneration++;
 }
 
 void VlknRenderer::createCommandBuffers() {
-  commandBuffers.resize(VlknSwapChain::MAX_FRAMES_IN_FLIGHT);
+  commandBuffers.resize(framesInFlight);
   VkCommandBufferAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -70,11 +110,34 @@ void VlknRenderer::freeCommandBuffers() {
   commandBuffers.clear();
 }
 
+void VlknRenderer::waitForFrame() {
+  assert(!isFrameStarted &&
+         "Cant call waitForFrame while frame is already in progress");
+
+  if (frameWaited) {
+    return;
+  }
+
+  // The frame that last used this frame index signalled the number of
+  // frames submitted up to it, frames in flight ago
+  if (submittedFrames >= framesInFlight) {
+    vlknDevice.waitGraphicsTimeline(submittedFrames + 1 - framesInFlight);
+  }
+
+  // The timeline value is the number of frames that have finished
+  deletionQueue.collect(vlknDevice.getGraphicsTimelineValue());
+
+  frameWaited = true;
+}
+
 VkCommandBuffer VlknRenderer::beginFrame() {
   assert(!isFrameStarted &&
          "Cant call beginFrame while frame is already in progress");
 
-  VkResult result = vlknSwapChain->acquireNextImage(&currentImageIndex);
+  waitForFrame();
+
+  VkResult result =
+      vlknSwapChain->acquireNextImage(currentFrameIndex, &currentImageIndex);
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
     recreateSwapChain();
@@ -108,8 +171,9 @@ void VlknRenderer::endFrame() {
     throw std::runtime_error("failed to record command buffer");
   }
 
-  VkResult result =
-      vlknSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+  VkResult result = vlknSwapChain->submitCommandBuffers(
+      &commandBuffer, &currentImageIndex, currentFrameIndex,
+      submittedFrames + 1);
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
       vlknWindow.wasWindowResized()) {
@@ -119,12 +183,22 @@ void VlknRenderer::endFrame() {
     throw std::runtime_error("failed to present swap chain image");
   }
 
+  // Counted only now, so what the recreation above retires waits for this
+  // frame
   isFrameStarted = false;
-  currentFrameIndex =
-      (currentFrameIndex + 1) % VlknSwapChain::MAX_FRAMES_IN_FLIGHT;
+  frameWaited = false;
+  submittedFrames++;
+  currentFrameIndex = (currentFrameIndex + 1) % framesInFlight;
+}
+
+void VlknRenderer::deferDestruction(std::function<void()> deleter) {
+  // The frame being recorded is submitted after the object was retired
+  deletionQueue.push(isFrameStarted ? submittedFrames + 1 : submittedFrames,
+                     std::move(deleter));
 }
 
-void VlknRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+void VlknRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                            VkSubpassContents contents) {
   assert(isFrameStarted &&
          "Cant call beginSwapChainRenderPass while frame is not in progress");
   assert(commandBuffer == getCurrentCommandBuffer() &&
@@ -135,30 +209,60 @@ void VlknRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
   renderPassInfo.renderPass = vlknSwapChain->getRenderPass();
   renderPassInfo.framebuffer = vlknSwapChain->getFrameBuffer(currentImageIndex);
 
+  // The scene only covers the top left render extent of its attachments
   renderPassInfo.renderArea.offset = {0, 0};
-  renderPassInfo.renderArea.extent = vlknSwapChain->getSwapChainExtent();
+  renderPassInfo.renderArea.extent = getRenderExtent();
 
-  std::array<VkClearValue, 2> clearValues{};
+  // Nothing accumulated yet is zero colour and weight with full revealage.
+  // The G-buffer clears to zero albedo and normals. Resolve targets are not
+  // cleared.
+  std::array<VkClearValue, 7> clearValues{};
   clearValues[0].color = {{0.1f, 0.1f, 0.1f, 1.0f}};
   clearValues[1].depthStencil = {1.0f, 0};
+  clearValues[VlknSwapChain::ACCUM_ATTACHMENT].color = {
+      {0.0f, 0.0f, 0.0f, 0.0f}};
+  clearValues[VlknSwapChain::REVEALAGE_ATTACHMENT].color = {
+      {1.0f, 0.0f, 0.0f, 0.0f}};
 
-  renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+  renderPassInfo.clearValueCount = vlknSwapChain->attachmentCount();
   renderPassInfo.pClearValues = clearValues.data();
 
-  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
-                       VK_SUBPASS_CONTENTS_INLINE);
-  VkViewport viewport{};
-  viewport.x = 0;
-  viewport.y = 0;
-  viewport.width =
-      static_cast<float>(vlknSwapChain->getSwapChainExtent().width);
-  viewport.height =
-      static_cast<float>(vlknSwapChain->getSwapChainExtent().height);
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-  VkRect2D scissor{{0, 0}, vlknSwapChain->getSwapChainExtent()};
-  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+  // Only vkCmdExecuteCommands may be recorded into a subpass whose contents
+  // come from secondary command buffers
+  if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+    setViewportAndScissor(commandBuffer);
+  }
+}
+
+void VlknRenderer::setViewportAndScissor(VkCommandBuffer commandBuffer) const {
+  setViewportAndScissorTo(commandBuffer, getRenderExtent());
+}
+
+void VlknRenderer::setRenderScale(float scale) {
+  renderScale = std::clamp(scale, 0.0f, 1.0f);
+}
+
+VkExtent2D VlknRenderer::getRenderExtent() const {
+  VkExtent2D extent = vlknSwapChain->getSwapChainExtent();
+  auto scaled = [this](uint32_t size) {
+    return std::clamp(static_cast<uint32_t>(
+                          std::lround(static_cast<float>(size) * renderScale)),
+                      1u, size);
+  };
+  return {scaled(extent.width), scaled(extent.height)};
+}
+
+void VlknRenderer::nextSwapChainSubpass(VkCommandBuffer commandBuffer,
+                                        VkSubpassContents contents) {
+  assert(isFrameStarted &&
+         "Cant call nextSwapChainSubpass while frame is not in progress");
+  assert(commandBuffer == getCurrentCommandBuffer() &&
+         "Cant advance render pass on command buffer from a different frame");
+
+  // Dynamic state set for the previous subpass stays valid
+  vkCmdNextSubpass(commandBuffer, contents);
 }
 
 void VlknRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
@@ -170,4 +274,62 @@ void VlknRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
   vkCmdEndRenderPass(commandBuffer);
 }
 
+void VlknRenderer::beginPresentRenderPass(VkCommandBuffer commandBuffer) {
+  assert(isFrameStarted &&
+         "Cant call beginPresentRenderPass while frame is not in progress");
+  assert(commandBuffer == getCurrentCommandBuffer() &&
+         "Cant begin render pass on command buffer from a different frame");
+
+  const VkExtent2D extent = vlknSwapChain->getSwapChainExtent();
+
+  if (dynamicRendering) {
+    // Every pixel is written by the upscale
+    VkRenderingAttachmentInfo colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.imageView = vlknSwapChain->getImageView(currentImageIndex);
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.renderArea.offset = {0, 0};
+    renderingInfo.renderArea.extent = extent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+
+    vlknDevice.cmdBeginRendering(commandBuffer, renderingInfo);
+    setViewportAndScissorTo(commandBuffer, extent);
+    return;
+  }
+
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = vlknSwapChain->getPresentRenderPass();
+  renderPassInfo.framebuffer =
+      vlknSwapChain->getPresentFrameBuffer(currentImageIndex);
+
+  renderPassInfo.renderArea.offset = {0, 0};
+  renderPassInfo.renderArea.extent = extent;
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                       VK_SUBPASS_CONTENTS_INLINE);
+
+  setViewportAndScissorTo(commandBuffer, extent);
+}
+
+void VlknRenderer::endPresentRenderPass(VkCommandBuffer commandBuffer) {
+  assert(isFrameStarted &&
+         "Cant call endPresentRenderPass while frame is not in progress");
+  assert(commandBuffer == getCurrentCommandBuffer() &&
+         "Cant end render pass on command buffer from a different frame");
+
+  if (dynamicRendering) {
+    vlknDevice.cmdEndRendering(commandBuffer);
+  } else {
+    vkCmdEndRenderPass(commandBuffer);
+  }
+}
+
 } // namespace vlkn
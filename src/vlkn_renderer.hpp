@@ -1,11 +1,13 @@
 #pragma once
 
+#include "vlkn_deletion_queue.hpp"
 #include "vlkn_device.hpp"
 #include "vlkn_swap_chain.hpp"
 #include "vlkn_window.hpp"
 
 #include <cassert>
 #include <cstdint>
+#include <functional>
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/fwd.hpp>
@@ -18,7 +20,14 @@ namespace vlkn {
 
 class VlknRenderer {
 public:
-  VlknRenderer(VlknWindow &window, VlknDevice &device);
+  // dynamicRendering is ignored if the device does not support it.
+  // framesInFlight is clamped to the bounds of VlknSwapChain.
+  VlknRenderer(
+      VlknWindow &window, VlknDevice &device,
+      RenderPath renderPath = RenderPath::Forward,
+      VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT,
+      bool dynamicRendering = false,
+      uint32_t framesInFlight = VlknSwapChain::DEFAULT_FRAMES_IN_FLIGHT);
   ~VlknRenderer();
 
   VlknRenderer(const VlknRenderer &) = delete;
@@ -28,8 +37,60 @@ public:
     return vlknSwapChain->getRenderPass();
   }
 
+  RenderPath getRenderPath() const { return renderPath; }
+
+  // Number of frames the CPU may record ahead of the GPU, and of every
+  // resource that is written per frame
+  uint32_t getFramesInFlight() const { return framesInFlight; }
+
+  // Sample count of every attachment written by the scene, after clamping
+  VkSampleCountFlagBits getSampleCount() const {
+    return vlknSwapChain->getSampleCount();
+  }
+
+  uint32_t getLightingSubpass() const {
+    return vlknSwapChain->getLightingSubpass();
+  }
+  uint32_t getTransparentSubpass() const {
+    return vlknSwapChain->getTransparentSubpass();
+  }
+  uint32_t getCompositeSubpass() const {
+    return vlknSwapChain->getCompositeSubpass();
+  }
+
   float getAspectRatio() const { return vlknSwapChain->extentAspectRatio(); }
 
+  VkExtent2D getSwapChainExtent() const {
+    return vlknSwapChain->getSwapChainExtent();
+  }
+
+  // Fraction of the swap chain extent the scene is rendered at. The scene
+  // attachments keep the full extent, the render area and viewport of the
+  // scene render pass shrink instead, so changing the scale never recreates
+  // them.
+  void setRenderScale(float scale);
+  float getRenderScale() const { return renderScale; }
+  VkExtent2D getRenderExtent() const;
+
+  // Null when the present pass uses dynamic rendering, its pipelines are
+  // then created for the swap chain image format
+  VkRenderPass getPresentRenderPass() const {
+    return vlknSwapChain->getPresentRenderPass();
+  }
+  bool usesDynamicRendering() const { return dynamicRendering; }
+  VkFormat getSwapChainImageFormat() const {
+    return vlknSwapChain->getSwapChainImageFormat();
+  }
+  VkImageView getSceneImageView(int index) const {
+    return vlknSwapChain->getSceneImageView(index);
+  }
+  VkImage getSceneImage(int index) const {
+    return vlknSwapChain->getSceneImage(index);
+  }
+  VkImage getSwapChainImage(int index) const {
+    return vlknSwapChain->getImage(index);
+  }
+
   bool isFrameInProgress() const { return isFrameStarted; }
 
   VkCommandBuffer getCurrentCommandBuffer() const {
@@ -38,17 +99,86 @@ public:
     return commandBuffers[currentFrameIndex];
   }
 
+  VkFramebuffer getCurrentFramebuffer() const {
+    assert(isFrameStarted &&
+           "Cannot get framebuffer when frame is not in progress");
+    return vlknSwapChain->getFrameBuffer(currentImageIndex);
+  }
+
+  // Frames are numbered from one in submission order, the number is also
+  // the frame's graphics timeline value and present id
+  uint64_t getSubmittedFrameCount() const { return submittedFrames; }
+  // Only valid if the device supports present wait
+  VkResult waitForPresent(uint64_t frameNumber, uint64_t timeout) {
+    return vlknSwapChain->waitForPresent(frameNumber, timeout);
+  }
+
+  // Incremented every time the swap chain and its attachments are recreated
+  uint32_t getSwapChainGeneration() const { return swapChainGeneration; }
+
+  size_t getSwapChainImageCount() const { return vlknSwapChain->imageCount(); }
+
+  uint32_t getImageIndex() const {
+    assert(isFrameStarted &&
+           "Cannot get image index when frame is not in progress");
+    return currentImageIndex;
+  }
+
+  VkImageView getDepthImageView(int index) const {
+    return vlknSwapChain->getDepthImageView(index);
+  }
+  VkImageView getAlbedoImageView(int index) const {
+    return vlknSwapChain->getAlbedoImageView(index);
+  }
+  VkImageView getNormalImageView(int index) const {
+    return vlknSwapChain->getNormalImageView(index);
+  }
+  VkImageView getAccumImageView(int index) const {
+    return vlknSwapChain->getAccumImageView(index);
+  }
+  VkImageView getRevealageImageView(int index) const {
+    return vlknSwapChain->getRevealageImageView(index);
+  }
+
   uint32_t getFrameIndex() const {
     assert(isFrameStarted &&
            "Cannot get frame index when frame is not in progress");
     return currentFrameIndex;
   }
 
+  // Runs deleter once every frame submitted so far, and the one being
+  // recorded, has finished
+  void deferDestruction(std::function<void()> deleter);
+  template <typename T> void deferDestruction(std::unique_ptr<T> object) {
+    std::shared_ptr<T> retired = std::move(object);
+    deferDestruction([retired]() mutable { retired.reset(); });
+  }
+
+  // Blocks until the frame that last used the next frame index has
+  // finished. Called by beginFrame(), calling it earlier moves the wait in
+  // front of whatever the caller does before beginFrame().
+  void waitForFrame();
   VkCommandBuffer beginFrame();
   void endFrame();
-  void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+  void beginSwapChainRenderPass(
+      VkCommandBuffer commandBuffer,
+      VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+  void nextSwapChainSubpass(
+      VkCommandBuffer commandBuffer,
+      VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
   void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+  // Begins the pass that writes the swap chain image at native resolution,
+  // always with inline contents. Uses vkCmdBeginRendering with dynamic
+  // rendering, the image has to be a colour attachment already.
+  void beginPresentRenderPass(VkCommandBuffer commandBuffer);
+  void endPresentRenderPass(VkCommandBuffer commandBuffer);
+
+  // Dynamic state is not inherited by secondary command buffers, so each of
+  // them has to set the viewport and scissor itself. Covers the render
+  // extent.
+  void setViewportAndScissor(VkCommandBuffer commandBuffer) const;
+
 private:
   void createCommandBuffers();
   void freeCommandBuffers();
@@ -56,8 +186,20 @@ private:
 
   VlknWindow &vlknWindow;
   VlknDevice &vlknDevice;
+  RenderPath renderPath;
+  VkSampleCountFlagBits requestedSampleCount;
+  bool dynamicRendering;
+  uint32_t framesInFlight;
   std::unique_ptr<VlknSwapChain> vlknSwapChain;
   std::vector<VkCommandBuffer> commandBuffers;
+  // Retired swap chains and anything else the frames in flight may still use
+  VlknDeletionQueue deletionQueue;
+  // Also the value the graphics timeline reaches once they all finished
+  uint64_t submittedFrames{0};
+  // Whether waitForFrame() already waited for the next frame
+  bool frameWaited{false};
+  uint32_t swapChainGeneration{0};
+  float renderScale{1.0f};
 
   uint32_t currentImageIndex;
   uint32_t currentFrameIndex{0};
@@ -0,0 +1,129 @@
+// header
+#include "vlkn_resolution_controller.hpp"
+
+// local
+#include "vlkn_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+namespace vlkn {
+
+namespace {
+
+// Fraction of the budget the smoothed time has to stay under before the
+// scale climbs, and the largest step it climbs by per frame
+constexpr float RAISE_THRESHOLD = 0.85f;
+constexpr float MAX_RAISE_STEP = 0.02f;
+// Weight of the newest frame in the smoothed time
+constexpr float SMOOTHING = 0.1f;
+
+} // namespace
+
+VlknResolutionController::VlknResolutionController(
+    VlknDevice &device, std::uint32_t framesInFlight)
+    : vlknDevice(device) {
+  // Graphics queues support timestamps whenever this limit is set
+  timestampsSupported =
+      vlknDevice.properties.limits.timestampComputeAndGraphics == VK_TRUE;
+  timestampPeriod = vlknDevice.properties.limits.timestampPeriod;
+
+  if (!timestampsSupported) {
+    return;
+  }
+
+  VkQueryPoolCreateInfo queryPoolInfo{};
+  queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryPoolInfo.queryCount = 2 * framesInFlight;
+
+  if (vkCreateQueryPool(vlknDevice.device(), &queryPoolInfo, nullptr,
+                        &queryPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create timestamp query pool!");
+  }
+
+  pending.resize(framesInFlight, false);
+}
+
+VlknResolutionController::~VlknResolutionController() {
+  vkDestroyQueryPool(vlknDevice.device(), queryPool, nullptr);
+}
+
+void VlknResolutionController::setBounds(float minScale, float maxScale) {
+  this->maxScale = std::clamp(maxScale, 0.1f, 1.0f);
+  this->minScale = std::clamp(minScale, 0.1f, this->maxScale);
+  scale = std::clamp(scale, this->minScale, this->maxScale);
+}
+
+void VlknResolutionController::beginFrame(VkCommandBuffer commandBuffer,
+                                          std::uint32_t frameIndex) {
+  if (!timestampsSupported) {
+    scale = maxScale;
+    return;
+  }
+
+  const std::uint32_t firstQuery = 2 * frameIndex;
+
+  if (pending[frameIndex]) {
+    std::array<std::uint64_t, 2> timestamps{};
+    // The frame's timeline value was waited on, so the results are normally
+    // ready. If they are not, the frame is skipped rather than waited for.
+    const VkResult result = vkGetQueryPoolResults(
+        vlknDevice.device(), queryPool, firstQuery, 2, sizeof(timestamps),
+        timestamps.data(), sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT);
+
+    if (result == VK_SUCCESS && timestamps[1] >= timestamps[0]) {
+      gpuMs = static_cast<float>(timestamps[1] - timestamps[0]) *
+              timestampPeriod * 1e-6f;
+      updateScale(gpuMs);
+    }
+    pending[frameIndex] = false;
+  }
+
+  if (!enabled) {
+    scale = maxScale;
+  }
+
+  vkCmdResetQueryPool(commandBuffer, queryPool, firstQuery, 2);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      queryPool, firstQuery);
+}
+
+void VlknResolutionController::endFrame(VkCommandBuffer commandBuffer,
+                                        std::uint32_t frameIndex) {
+  if (!timestampsSupported) {
+    return;
+  }
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      queryPool, 2 * frameIndex + 1);
+  pending[frameIndex] = true;
+}
+
+void VlknResolutionController::updateScale(float milliseconds) {
+  smoothedMs = smoothedMs == 0.0f
+                   ? milliseconds
+                   : smoothedMs + (milliseconds - smoothedMs) * SMOOTHING;
+
+  if (!enabled || milliseconds <= 0.0f) {
+    return;
+  }
+
+  if (milliseconds > targetMs) {
+    // GPU time grows roughly with the pixel count, the square of the scale
+    scale *= std::sqrt(targetMs / milliseconds);
+    // The spike is not averaged in, or it would hold the scale down
+    smoothedMs = milliseconds;
+  } else if (smoothedMs < RAISE_THRESHOLD * targetMs) {
+    const float wanted = scale * std::sqrt(RAISE_THRESHOLD * targetMs /
+                                           std::max(smoothedMs, 1e-3f));
+    scale = std::min(wanted, scale + MAX_RAISE_STEP);
+  }
+
+  scale = std::clamp(scale, minScale, maxScale);
+}
+
+} // namespace vlkn
@@ -0,0 +1,79 @@
+#pragma once
+
+// local
+#include "vlkn_device.hpp"
+
+// libs
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vlkn {
+
+// Picks the render scale of the scene from its measured GPU time. Two
+// timestamps per frame in flight bracket the scene work, and their result is
+// read once the frame has been waited on, so reading never stalls.
+//
+// The scale drops at once when a frame goes over the budget, so load spikes
+// cost resolution instead of frame rate, and only climbs back slowly while
+// the smoothed time stays well under it, so it does not oscillate.
+class VlknResolutionController {
+public:
+  static constexpr float DEFAULT_MIN_SCALE = 0.5f;
+  static constexpr float DEFAULT_MAX_SCALE = 1.0f;
+  static constexpr float DEFAULT_TARGET_MS = 12.0f;
+
+  VlknResolutionController(VlknDevice &device, std::uint32_t framesInFlight);
+  ~VlknResolutionController();
+
+  VlknResolutionController(const VlknResolutionController &) = delete;
+  VlknResolutionController &
+  operator=(const VlknResolutionController &) = delete;
+
+  // Reads the timings of the frame that last used frameIndex, updates the
+  // scale and writes the start timestamp. Must be recorded outside of a
+  // render pass, after the frame has been waited on.
+  void beginFrame(VkCommandBuffer commandBuffer, std::uint32_t frameIndex);
+  // Writes the end timestamp, once the scene work has been recorded
+  void endFrame(VkCommandBuffer commandBuffer, std::uint32_t frameIndex);
+
+  // Disabled, or without timestamp support, the scale stays at the maximum
+  void setEnabled(bool enable) { enabled = enable; }
+  bool isEnabled() const { return enabled && timestampsSupported; }
+
+  // maxScale is capped at 1, the scene targets are never larger than the
+  // swap chain
+  void setBounds(float minScale, float maxScale);
+  void setTargetTime(float milliseconds) { targetMs = milliseconds; }
+
+  float getScale() const { return scale; }
+  float getMinScale() const { return minScale; }
+  float getMaxScale() const { return maxScale; }
+  float getTargetTime() const { return targetMs; }
+  // Last measured scene time in milliseconds
+  float getGpuTime() const { return gpuMs; }
+
+private:
+  void updateScale(float milliseconds);
+
+  VlknDevice &vlknDevice;
+
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+  bool timestampsSupported = false;
+  float timestampPeriod = 1.0f;
+  // Whether the queries of a frame in flight were written and not read yet
+  std::vector<bool> pending{};
+
+  bool enabled = true;
+  float minScale = DEFAULT_MIN_SCALE;
+  float maxScale = DEFAULT_MAX_SCALE;
+  float targetMs = DEFAULT_TARGET_MS;
+
+  float scale = DEFAULT_MAX_SCALE;
+  float gpuMs = 0.0f;
+  float smoothedMs = 0.0f;
+};
+
+} // namespace vlkn
@@ -0,0 +1,145 @@
+// header
+#include "vlkn_shader_module_cache.hpp"
+
+// local
+#include "vlkn_embedded_shaders.hpp"
+
+// libs
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace vlkn {
+
+VlknShaderModule::VlknShaderModule(VkDevice device, const std::uint32_t *code,
+                                   std::size_t size)
+    : device(device) {
+  VkShaderModuleCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = size;
+  createInfo.pCode = code;
+
+  if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module");
+  }
+}
+
+VlknShaderModule::~VlknShaderModule() {
+  vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+VlknShaderModuleCache::VlknShaderModuleCache(VkDevice device)
+    : device(device) {}
+
+bool VlknShaderModuleCache::Entry::matches(const std::uint32_t *otherCode,
+                                           std::size_t otherSize) const {
+  return size == otherSize &&
+         (code == otherCode || std::memcmp(code, otherCode, size) == 0);
+}
+
+std::shared_ptr<VlknShaderModule>
+VlknShaderModuleCache::acquire(const std::uint32_t *code, std::size_t size) {
+  return acquire(code, size, false);
+}
+
+std::shared_ptr<VlknShaderModule>
+VlknShaderModuleCache::acquire(const std::uint32_t *code, std::size_t size,
+                               bool embedded) {
+  const std::uint64_t key = hashCode(code, size);
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  Entry &entry = modules[key];
+
+  std::shared_ptr<VlknShaderModule> module = entry.module.lock();
+  if (module != nullptr && entry.matches(code, size)) {
+    reusedCount++;
+    return module;
+  }
+
+  // Creating under the lock keeps two threads from compiling the same
+  // module, shader module creation is cheap next to pipeline creation
+  module = std::make_shared<VlknShaderModule>(device, code, size);
+  createdCount++;
+
+  // A live module with other code under the same hash keeps its entry, the
+  // colliding shader is not shared
+  if (!entry.module.expired()) {
+    return module;
+  }
+
+  if (embedded) {
+    entry.ownedCode.clear();
+    entry.code = code;
+  } else {
+    entry.ownedCode.assign(code, code + size / sizeof(std::uint32_t));
+    entry.code = entry.ownedCode.data();
+  }
+  entry.size = size;
+  entry.module = module;
+
+  return module;
+}
+
+std::shared_ptr<VlknShaderModule>
+VlknShaderModuleCache::acquire(const std::string &path) {
+  if (const EmbeddedShader *shader = findEmbeddedShader(path)) {
+    return acquire(shader->code, shader->size, true);
+  }
+
+  std::ifstream file{path, std::ios::ate | std::ios::binary};
+
+  if (!file.is_open() || !file.good()) {
+    throw std::runtime_error("failed to open file: " + path);
+  }
+
+  const std::size_t fileSize = static_cast<std::size_t>(file.tellg());
+  if (fileSize % sizeof(std::uint32_t) != 0) {
+    throw std::runtime_error("invalid SPIR-V size: " + path);
+  }
+
+  // Words keep the code aligned for vkCreateShaderModule
+  std::vector<std::uint32_t> code(fileSize / sizeof(std::uint32_t));
+
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(code.data()), fileSize);
+  file.close();
+
+  return acquire(code.data(), fileSize);
+}
+
+std::uint32_t VlknShaderModuleCache::getCreatedCount() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return createdCount;
+}
+
+std::uint32_t VlknShaderModuleCache::getReusedCount() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return reusedCount;
+}
+
+// 64-bit FNV-1a over the words and the size
+std::uint64_t VlknShaderModuleCache::hashCode(const std::uint32_t *code,
+                                              std::size_t size) {
+  constexpr std::uint64_t prime = 0x100000001b3;
+
+  std::uint64_t hash = 0xcbf29ce484222325;
+  for (std::size_t i = 0; i < size / sizeof(std::uint32_t); i++) {
+    hash = (hash ^ code[i]) * prime;
+  }
+
+  return (hash ^ size) * prime;
+}
+
+} // namespace vlkn
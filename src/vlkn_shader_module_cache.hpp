@@ -0,0 +1,81 @@
+#pragma once
+
+// libs
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vlkn {
+
+class VlknShaderModule {
+public:
+  VlknShaderModule(VkDevice device, const std::uint32_t *code,
+                   std::size_t size);
+  ~VlknShaderModule();
+
+  VlknShaderModule(const VlknShaderModule &) = delete;
+  VlknShaderModule &operator=(const VlknShaderModule &) = delete;
+
+  VkShaderModule getShaderModule() const { return shaderModule; }
+
+private:
+  VkDevice device;
+  VkShaderModule shaderModule = VK_NULL_HANDLE;
+};
+
+// Shader modules keyed by a hash of their SPIR-V. Pipelines created at the
+// same time from the same shader share one module, which is destroyed as
+// soon as the last of them has been created; a pipeline does not need its
+// modules afterwards. A hash hit is only used if the code matches, so a
+// collision costs an uncached module rather than the wrong shader. Safe to
+// use from several threads.
+class VlknShaderModuleCache {
+public:
+  explicit VlknShaderModuleCache(VkDevice device);
+
+  VlknShaderModuleCache(const VlknShaderModuleCache &) = delete;
+  VlknShaderModuleCache &operator=(const VlknShaderModuleCache &) = delete;
+
+  // size is in bytes. The code is copied for comparing later hits.
+  std::shared_ptr<VlknShaderModule> acquire(const std::uint32_t *code,
+                                            std::size_t size);
+  // Uses the shader embedded under path, falls back to reading the file
+  std::shared_ptr<VlknShaderModule> acquire(const std::string &path);
+
+  // Modules created and acquires served by a module that was still alive
+  std::uint32_t getCreatedCount();
+  std::uint32_t getReusedCount();
+
+private:
+  struct Entry {
+    // Points into ownedCode, or at embedded code that is never freed
+    const std::uint32_t *code = nullptr;
+    std::size_t size = 0;
+    std::vector<std::uint32_t> ownedCode{};
+    std::weak_ptr<VlknShaderModule> module{};
+
+    bool matches(const std::uint32_t *otherCode, std::size_t otherSize) const;
+  };
+
+  // Embedded code is compared by pointer and not copied
+  std::shared_ptr<VlknShaderModule>
+  acquire(const std::uint32_t *code, std::size_t size, bool embedded);
+
+  static std::uint64_t hashCode(const std::uint32_t *code, std::size_t size);
+
+  VkDevice device;
+
+  std::mutex mutex{};
+  std::unordered_map<std::uint64_t, Entry> modules{};
+  std::uint32_t createdCount = 0;
+  std::uint32_t reusedCount = 0;
+};
+
+} // namespace vlkn
@@ -0,0 +1,689 @@
+// header
+#include "vlkn_shadow_atlas.hpp"
+
+// local
+#include "vlkn_components.hpp"
+#include "vlkn_swap_chain.hpp"
+#include "vlkn_utils.hpp"
+
+// libs
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace vlkn {
+
+struct ShadowPushConstants {
+  glm::mat4 faceViewProjection{1.0f};
+  glm::mat4 modelMatrix{1.0f};
+};
+
+namespace {
+
+// Cube face order +x, -x, +y, -y, +z, -z, the shaders pick a face by the
+// major axis of the light to fragment direction in the same order
+const std::array<glm::vec3, 6> FACE_DIRECTIONS = {
+    glm::vec3(1.0f, 0.0f, 0.0f),  glm::vec3(-1.0f, 0.0f, 0.0f),
+    glm::vec3(0.0f, 1.0f, 0.0f),  glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f),  glm::vec3(0.0f, 0.0f, -1.0f)};
+
+const std::array<glm::vec3, 6> FACE_UPS = {
+    glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f),  glm::vec3(0.0f, 0.0f, -1.0f),
+    glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)};
+
+} // namespace
+
+VlknShadowAtlas::VlknShadowAtlas(VlknDevice &device,
+                                 std::uint32_t framesInFlight,
+                                 bool dynamicRendering)
+    : vlknDevice(device), dynamicRendering(dynamicRendering) {
+  createAtlas();
+  createSampler();
+  if (!dynamicRendering) {
+    createRenderPass();
+    createFramebuffer();
+  }
+  createPipelineLayout();
+  createPipeline();
+
+  shadowDataBuffers.resize(framesInFlight);
+  for (auto &buffer : shadowDataBuffers) {
+    buffer = std::make_unique<VlknBuffer>(
+        vlknDevice, sizeof(ShadowData), MAX_SHADOWED_LIGHTS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    buffer->map();
+  }
+
+  // The atlas starts out as a grid of the largest tiles
+  for (std::uint32_t y = 0; y < ATLAS_SIZE; y += MAX_TILE_SIZE) {
+    for (std::uint32_t x = 0; x < ATLAS_SIZE; x += MAX_TILE_SIZE) {
+      freeTiles[0].push_back(glm::uvec2(x, y));
+    }
+  }
+}
+
+VlknShadowAtlas::~VlknShadowAtlas() {
+  vkDestroyPipelineLayout(vlknDevice.device(), pipelineLayout, nullptr);
+  vkDestroyFramebuffer(vlknDevice.device(), framebuffer, nullptr);
+  vkDestroyRenderPass(vlknDevice.device(), renderPass, nullptr);
+  vkDestroySampler(vlknDevice.device(), atlasSampler, nullptr);
+  vkDestroyImageView(vlknDevice.device(), atlasView, nullptr);
+  vkDestroyImage(vlknDevice.device(), atlasImage, nullptr);
+  vkFreeMemory(vlknDevice.device(), atlasMemory, nullptr);
+}
+
+void VlknShadowAtlas::createAtlas() {
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = ATLAS_SIZE;
+  imageInfo.extent.height = ATLAS_SIZE;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = DEPTH_FORMAT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  vlknDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                 atlasImage, atlasMemory);
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = atlasImage;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = DEPTH_FORMAT;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  if (vkCreateImageView(vlknDevice.device(), &viewInfo, nullptr,
+                        &atlasView) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow atlas image view!");
+  }
+
+  // The atlas stays in the read only layout between shadow passes, the
+  // render pass loads and stores it in place. Tiles that were never rendered
+  // have an empty rectangle, so the undefined contents are never sampled.
+  VkCommandBuffer commandBuffer = vlknDevice.beginSingleTimeCommands();
+
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = atlasImage;
+  barrier.subresourceRange = viewInfo.subresourceRange;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  vlknDevice.endSingleTimeCommands(commandBuffer);
+}
+
+void VlknShadowAtlas::createSampler() {
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+  samplerInfo.anisotropyEnable = VK_FALSE;
+  samplerInfo.maxAnisotropy = 1.0f;
+
+  samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+  // Hardware 2x2 percentage closer filtering
+  samplerInfo.compareEnable = VK_TRUE;
+  samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.mipLodBias = 0.0f;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = 0.0f;
+
+  if (vkCreateSampler(vlknDevice.device(), &samplerInfo, nullptr,
+                      &atlasSampler) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow atlas sampler!");
+  }
+}
+
+void VlknShadowAtlas::createRenderPass() {
+  VkAttachmentDescription depthAttachment{};
+  depthAttachment.format = DEPTH_FORMAT;
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  // Cached tiles have to survive, stale tiles are cleared one by one
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  // The render graph transitions the atlas between sampling and rendering
+  // and waits for the frames that sample it
+  depthAttachment.initialLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.finalLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference depthAttachmentRef{};
+  depthAttachmentRef.attachment = 0;
+  depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 0;
+  subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+  VkRenderPassCreateInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 1;
+  renderPassInfo.pAttachments = &depthAttachment;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  renderPassInfo.dependencyCount = 0;
+  renderPassInfo.pDependencies = nullptr;
+
+  if (vkCreateRenderPass(vlknDevice.device(), &renderPassInfo, nullptr,
+                         &renderPass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow render pass!");
+  }
+}
+
+void VlknShadowAtlas::createFramebuffer() {
+  VkFramebufferCreateInfo framebufferInfo{};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = renderPass;
+  framebufferInfo.attachmentCount = 1;
+  framebufferInfo.pAttachments = &atlasView;
+  framebufferInfo.width = ATLAS_SIZE;
+  framebufferInfo.height = ATLAS_SIZE;
+  framebufferInfo.layers = 1;
+
+  if (vkCreateFramebuffer(vlknDevice.device(), &framebufferInfo, nullptr,
+                          &framebuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow framebuffer!");
+  }
+}
+
+void VlknShadowAtlas::createPipelineLayout() {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(ShadowPushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 0;
+  pipelineLayoutInfo.pSetLayouts = nullptr;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(vlknDevice.device(), &pipelineLayoutInfo, nullptr,
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout");
+  }
+}
+
+void VlknShadowAtlas::createPipeline() {
+  assert(pipelineLayout != nullptr &&
+         "Cannot create pipeline before pipeline layout");
+
+  PipelineConfigInfo pipelineConfig{};
+  VlknPipeline::defaultPipelineConfigInfo(pipelineConfig);
+  // Position only, depth only
+  pipelineConfig.attributeDescriptions.resize(1);
+  pipelineConfig.colorBlendInfo.attachmentCount = 0;
+  pipelineConfig.colorBlendInfo.pAttachments = nullptr;
+  // Slope scaled bias against self shadowing of surfaces facing the light
+  pipelineConfig.rasterizationInfo.depthBiasEnable = VK_TRUE;
+  pipelineConfig.rasterizationInfo.depthBiasConstantFactor = 1.25f;
+  pipelineConfig.rasterizationInfo.depthBiasSlopeFactor = 1.75f;
+  // A null render pass builds the pipeline for dynamic rendering
+  pipelineConfig.renderPass = renderPass;
+  pipelineConfig.depthAttachmentFormat = DEPTH_FORMAT;
+  pipelineConfig.subpass = 0;
+  pipelineConfig.pipelineLayout = pipelineLayout;
+  vlknPipeline = std::make_unique<VlknPipeline>(
+      vlknDevice, "shaders/shadow.vert.spv", "shaders/depth_prepass.frag.spv",
+      pipelineConfig);
+}
+
+bool VlknShadowAtlas::allocateTile(std::uint32_t tier, glm::uvec2 &origin) {
+  if (!freeTiles[tier].empty()) {
+    origin = freeTiles[tier].back();
+    freeTiles[tier].pop_back();
+    return true;
+  }
+
+  // Split a tile of the tier above into four
+  glm::uvec2 parent{};
+  if (tier == 0 || !allocateTile(tier - 1, parent)) {
+    return false;
+  }
+
+  const std::uint32_t size = tileSize(tier);
+  freeTiles[tier].push_back(parent + glm::uvec2(size, 0));
+  freeTiles[tier].push_back(parent + glm::uvec2(0, size));
+  freeTiles[tier].push_back(parent + glm::uvec2(size, size));
+  origin = parent;
+  return true;
+}
+
+void VlknShadowAtlas::freeTile(std::uint32_t tier, glm::uvec2 origin) {
+  std::vector<glm::uvec2> &tiles = freeTiles[tier];
+
+  if (tier > 0) {
+    // Merge back into the parent once all four siblings are free
+    const std::uint32_t parentSize = tileSize(tier - 1);
+    const glm::uvec2 parent = origin - origin % parentSize;
+
+    std::array<std::size_t, 3> siblings{};
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < tiles.size() && found < 3; i++) {
+      if (tiles[i] - tiles[i] % parentSize == parent) {
+        siblings[found++] = i;
+      }
+    }
+
+    if (found == 3) {
+      // Highest index first, so the swaps do not move the other siblings
+      for (std::size_t i = 3; i-- > 0;) {
+        tiles[siblings[i]] = tiles.back();
+        tiles.pop_back();
+      }
+      freeTile(tier - 1, parent);
+      return;
+    }
+  }
+
+  tiles.push_back(origin);
+}
+
+bool VlknShadowAtlas::allocateFaces(ShadowLight &light, std::uint32_t tier) {
+  for (; tier < TILE_TIERS; tier++) {
+    std::uint32_t allocated = 0;
+    while (allocated < 6 && allocateTile(tier, light.tiles[allocated])) {
+      allocated++;
+    }
+
+    if (allocated == 6) {
+      light.tier = static_cast<std::int32_t>(tier);
+      light.rendered.fill(false);
+      light.age.fill(0);
+      return true;
+    }
+
+    // Give the partial set back and try smaller tiles
+    while (allocated-- > 0) {
+      freeTile(tier, light.tiles[allocated]);
+    }
+  }
+
+  light.tier = -1;
+  return false;
+}
+
+void VlknShadowAtlas::releaseSlot(std::uint32_t slot) {
+  ShadowLight &light = slots[slot];
+  for (const glm::uvec2 &tile : light.tiles) {
+    freeTile(static_cast<std::uint32_t>(light.tier), tile);
+  }
+
+  light = ShadowLight{};
+  shadowData[slot] = ShadowData{};
+}
+
+void VlknShadowAtlas::update(std::uint32_t frameIndex,
+                             const VlknCamera &camera, VkExtent2D extent,
+                             VlknRegistry &registry, const VlknBvh &sceneBvh,
+                             std::vector<PointLight> &lights,
+                             const std::vector<Entity> &lightEntities) {
+  assert(lights.size() == lightEntities.size() &&
+         "Every light needs its entity");
+
+  updateStamp++;
+  faceUpdates.clear();
+  faceCasters.clear();
+
+  // Influence is the radius of the light's range on screen in pixels, lights
+  // whose range is off screen cast no visible shadows
+  const Frustum frustum =
+      Frustum::fromViewProjection(camera.getProjection() * camera.getView());
+  const float pixelsPerUnit =
+      std::abs(camera.getProjection()[1][1]) * 0.5f * extent.height;
+  const glm::vec3 cameraPosition = camera.getPosition();
+
+  candidates.clear();
+  for (std::uint32_t i = 0; i < lights.size(); i++) {
+    const glm::vec3 position{lights[i].position};
+    const float range = lights[i].position.w;
+    if (!frustum.intersects(Aabb{position - range, position + range})) {
+      continue;
+    }
+
+    const float distance =
+        std::max(glm::length(position - cameraPosition), camera.getNear());
+    candidates.push_back(Candidate{i, range / distance * pixelsPerUnit});
+  }
+
+  const std::size_t shadowedCount =
+      std::min<std::size_t>(candidates.size(), MAX_SHADOWED_LIGHTS);
+  std::partial_sort(candidates.begin(), candidates.begin() + shadowedCount,
+                    candidates.end(), [](const auto &a, const auto &b) {
+                      return a.influence > b.influence;
+                    });
+  candidates.resize(shadowedCount);
+
+  // Stamp the slots that stay, then free the rest before allocating so new
+  // lights can use their tiles
+  for (const Candidate &candidate : candidates) {
+    const Entity entity = lightEntities[candidate.light];
+    if (entity.index < slotOfEntity.size()) {
+      const std::uint32_t slot = slotOfEntity[entity.index];
+      if (slot < MAX_SHADOWED_LIGHTS && slots[slot].entity == entity) {
+        slots[slot].stamp = updateStamp;
+      }
+    }
+  }
+
+  for (std::uint32_t slot = 0; slot < MAX_SHADOWED_LIGHTS; slot++) {
+    if (slots[slot].tier >= 0 && slots[slot].stamp != updateStamp) {
+      releaseSlot(slot);
+    }
+  }
+
+  for (const Candidate &candidate : candidates) {
+    const Entity entity = lightEntities[candidate.light];
+    if (entity.index >= slotOfEntity.size()) {
+      slotOfEntity.resize(entity.index + 1, MAX_SHADOWED_LIGHTS);
+    }
+
+    std::uint32_t &slot = slotOfEntity[entity.index];
+    if (slot >= MAX_SHADOWED_LIGHTS || slots[slot].entity != entity ||
+        slots[slot].tier < 0) {
+      slot = 0;
+      while (slot < MAX_SHADOWED_LIGHTS && slots[slot].tier >= 0) {
+        slot++;
+      }
+      assert(slot < MAX_SHADOWED_LIGHTS && "No free shadow slot");
+    }
+
+    ShadowLight &light = slots[slot];
+
+    // Smallest tier covering the influence. A light keeps its tiles until it
+    // needs at least twice or at most a quarter of their size, so lights near
+    // a tier boundary do not reallocate every frame.
+    const std::uint32_t pixels = static_cast<std::uint32_t>(
+        std::min(candidate.influence, static_cast<float>(MAX_TILE_SIZE)));
+    const std::uint32_t wanted =
+        std::clamp(std::bit_ceil(pixels + 1), MIN_TILE_SIZE, MAX_TILE_SIZE);
+    const std::uint32_t tier = static_cast<std::uint32_t>(
+        std::countr_zero(MAX_TILE_SIZE) - std::countr_zero(wanted));
+
+    bool reallocate = light.tier < 0;
+    if (!reallocate) {
+      const float current = static_cast<float>(
+          tileSize(static_cast<std::uint32_t>(light.tier)));
+      reallocate = (candidate.influence > 2.0f * current &&
+                     light.tier > 0) ||
+                    (candidate.influence < 0.25f * current &&
+                     light.tier + 1 < static_cast<std::int32_t>(TILE_TIERS));
+    }
+
+    if (reallocate) {
+      if (light.tier >= 0) {
+        for (const glm::uvec2 &tile : light.tiles) {
+          freeTile(static_cast<std::uint32_t>(light.tier), tile);
+        }
+      }
+      shadowData[slot] = ShadowData{};
+
+      if (!allocateFaces(light, tier)) {
+        light = ShadowLight{};
+        continue;
+      }
+    }
+
+    light.entity = entity;
+    light.stamp = updateStamp;
+    light.influence = candidate.influence;
+    lights[candidate.light].shadowIndex = static_cast<std::int32_t>(slot);
+
+    collectFaceUpdates(slot, lights[candidate.light], registry, sceneBvh);
+  }
+
+  // Faces that were never rendered first, then by influence weighted by how
+  // long the face has been stale
+  const std::size_t updateCount = std::min<std::size_t>(
+      faceUpdates.size(), MAX_FACE_UPDATES_PER_FRAME);
+  std::partial_sort(faceUpdates.begin(), faceUpdates.begin() + updateCount,
+                    faceUpdates.end(), [](const auto &a, const auto &b) {
+                      return a.priority > b.priority;
+                    });
+
+  for (std::size_t i = updateCount; i < faceUpdates.size(); i++) {
+    slots[faceUpdates[i].slot].age[faceUpdates[i].face]++;
+  }
+  faceUpdates.resize(updateCount);
+
+  for (const FaceUpdate &update : faceUpdates) {
+    ShadowLight &light = slots[update.slot];
+    const glm::uvec2 &tile = light.tiles[update.face];
+    const float size =
+        static_cast<float>(tileSize(static_cast<std::uint32_t>(light.tier)));
+
+    light.signatures[update.face] = update.signature;
+    light.rendered[update.face] = true;
+    light.age[update.face] = 0;
+
+    ShadowData &data = shadowData[update.slot];
+    data.faceMatrices[update.face] = update.viewProjection;
+    data.faceRects[update.face] =
+        glm::vec4(glm::vec2(tile), size, size) / static_cast<float>(ATLAS_SIZE);
+  }
+
+  shadowDataBuffers[frameIndex]->writeToBuffer(shadowData.data());
+  shadowDataBuffers[frameIndex]->flush();
+}
+
+void VlknShadowAtlas::collectFaceUpdates(std::uint32_t slot,
+                                         const PointLight &light,
+                                         VlknRegistry &registry,
+                                         const VlknBvh &sceneBvh) {
+  ShadowLight &shadowLight = slots[slot];
+  const glm::vec3 position{light.position};
+  const float range = std::max(light.position.w, 2.0f * SHADOW_NEAR);
+
+  lightCasters.clear();
+  sceneBvh.querySphere(position, range, [&](Entity entity) {
+    if (registry.tryGet<ModelComponent>(entity) != nullptr) {
+      lightCasters.push_back(entity);
+    }
+  });
+
+  // The traversal order changes with the tree, the signatures must not
+  std::sort(lightCasters.begin(), lightCasters.end(),
+            [](const Entity &a, const Entity &b) { return a.index < b.index; });
+
+  const glm::mat4 projection =
+      glm::perspective(glm::half_pi<float>(), 1.0f, SHADOW_NEAR, range);
+
+  for (std::uint32_t face = 0; face < 6; face++) {
+    const glm::mat4 viewProjection =
+        projection * glm::lookAt(position, position + FACE_DIRECTIONS[face],
+                                 FACE_UPS[face]);
+    const Frustum faceFrustum = Frustum::fromViewProjection(viewProjection);
+
+    std::size_t signature = 0;
+    hashCombine(signature, position.x, position.y, position.z, range,
+                shadowLight.tier);
+
+    const std::uint32_t casterOffset =
+        static_cast<std::uint32_t>(faceCasters.size());
+    for (const Entity entity : lightCasters) {
+      TransformComponent &transform = registry.get<TransformComponent>(entity);
+      const ModelComponent &modelComponent =
+          registry.get<ModelComponent>(entity);
+      if (modelComponent.model == nullptr ||
+          !faceFrustum.intersects(Aabb::transform(
+              modelComponent.model->getBoundingBox(), transform.mat4()))) {
+        continue;
+      }
+
+      hashCombine(signature, entity.index, entity.generation,
+                  transform.getVersion(), modelComponent.model->getId());
+      faceCasters.push_back(entity);
+    }
+
+    if (shadowLight.rendered[face] &&
+        shadowLight.signatures[face] == signature) {
+      faceCasters.resize(casterOffset);
+      continue;
+    }
+
+    const float priority =
+        shadowLight.rendered[face]
+            ? shadowLight.influence * (shadowLight.age[face] + 1)
+            : std::numeric_limits<float>::max();
+
+    faceUpdates.push_back(FaceUpdate{
+        .slot = slot,
+        .face = face,
+        .viewProjection = viewProjection,
+        .signature = signature,
+        .priority = priority,
+        .casterOffset = casterOffset,
+        .casterCount =
+            static_cast<std::uint32_t>(faceCasters.size()) - casterOffset,
+    });
+  }
+}
+
+void VlknShadowAtlas::record(VkCommandBuffer commandBuffer,
+                             VlknRegistry &registry) {
+  if (faceUpdates.empty()) {
+    return;
+  }
+
+  if (dynamicRendering) {
+    // Same load and store ops as the render pass, cached tiles survive
+    VkRenderingAttachmentInfo depthAttachment{};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depthAttachment.imageView = atlasView;
+    depthAttachment.imageLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.renderArea.offset = {0, 0};
+    renderingInfo.renderArea.extent = {ATLAS_SIZE, ATLAS_SIZE};
+    renderingInfo.layerCount = 1;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+
+    vlknDevice.cmdBeginRendering(commandBuffer, renderingInfo);
+  } else {
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = framebuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = {ATLAS_SIZE, ATLAS_SIZE};
+    renderPassInfo.clearValueCount = 0;
+    renderPassInfo.pClearValues = nullptr;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+  }
+
+  vlknPipeline->bind(commandBuffer);
+
+  for (const FaceUpdate &update : faceUpdates) {
+    const ShadowLight &light = slots[update.slot];
+    const glm::uvec2 &tile = light.tiles[update.face];
+    const std::uint32_t size =
+        tileSize(static_cast<std::uint32_t>(light.tier));
+
+    VkViewport viewport{};
+    viewport.x = static_cast<float>(tile.x);
+    viewport.y = static_cast<float>(tile.y);
+    viewport.width = static_cast<float>(size);
+    viewport.height = static_cast<float>(size);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{{static_cast<std::int32_t>(tile.x),
+                      static_cast<std::int32_t>(tile.y)},
+                     {size, size}};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    VkClearAttachment clearAttachment{};
+    clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    clearAttachment.clearValue.depthStencil = {1.0f, 0};
+    VkClearRect clearRect{};
+    clearRect.rect = scissor;
+    clearRect.baseArrayLayer = 0;
+    clearRect.layerCount = 1;
+    vkCmdClearAttachments(commandBuffer, 1, &clearAttachment, 1, &clearRect);
+
+    ShadowPushConstants push{};
+    push.faceViewProjection = update.viewProjection;
+
+    for (std::uint32_t i = 0; i < update.casterCount; i++) {
+      const Entity entity = faceCasters[update.casterOffset + i];
+      ModelComponent &modelComponent = registry.get<ModelComponent>(entity);
+
+      push.modelMatrix = registry.get<TransformComponent>(entity).mat4();
+      vkCmdPushConstants(commandBuffer, pipelineLayout,
+                         VK_SHADER_STAGE_VERTEX_BIT, 0,
+                         sizeof(ShadowPushConstants), &push);
+      modelComponent.model->bind(commandBuffer);
+      modelComponent.model->draw(commandBuffer);
+    }
+  }
+
+  if (dynamicRendering) {
+    vlknDevice.cmdEndRendering(commandBuffer);
+  } else {
+    vkCmdEndRenderPass(commandBuffer);
+  }
+}
+
+VkDescriptorBufferInfo
+VlknShadowAtlas::shadowDataDescriptorInfo(std::uint32_t frameIndex) {
+  return shadowDataBuffers[frameIndex]->descriptorInfo();
+}
+
+VkDescriptorImageInfo VlknShadowAtlas::atlasDescriptorInfo() const {
+  return VkDescriptorImageInfo{
+      .sampler = atlasSampler,
+      .imageView = atlasView,
+      .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+  };
+}
+
+} // namespace vlkn
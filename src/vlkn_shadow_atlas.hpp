@@ -0,0 +1,171 @@
+#pragma once
+
+// local
+#include "vlkn_buffer.hpp"
+#include "vlkn_bvh.hpp"
+#include "vlkn_camera.hpp"
+#include "vlkn_device.hpp"
+#include "vlkn_frame_info.hpp"
+#include "vlkn_pipeline.hpp"
+#include "vlkn_registry.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vlkn {
+
+// Face matrices and atlas rectangles of one shadowed point light, indexed by
+// PointLight::shadowIndex. A face with an empty rectangle has not been
+// rendered yet and is treated as unshadowed.
+struct ShadowData {
+  std::array<glm::mat4, 6> faceMatrices{};
+  // Atlas offset in xy and size in zw, normalized
+  std::array<glm::vec4, 6> faceRects{};
+};
+
+// Omnidirectional point light shadows packed into one depth atlas. Each
+// shadowed light owns six square tiles, one per cube face, whose size follows
+// the light's influence on screen. Tiles come from a quadtree allocator, so
+// freeing four sibling tiles merges them back into their parent.
+//
+// Faces are cached: a face is only re-rendered when a signature of the light
+// and of the casters inside the face frustum changes, and at most
+// MAX_FACE_UPDATES_PER_FRAME stale faces are rendered per frame. The others
+// keep the matrices they were rendered with, so their shadows lag behind
+// instead of being wrong.
+class VlknShadowAtlas {
+public:
+  static constexpr std::uint32_t ATLAS_SIZE = 4096;
+  static constexpr VkFormat DEPTH_FORMAT = VK_FORMAT_D16_UNORM;
+
+  // Tile sizes go from MAX_TILE_SIZE down to MIN_TILE_SIZE, halving per tier
+  static constexpr std::uint32_t MAX_TILE_SIZE = 512;
+  static constexpr std::uint32_t TILE_TIERS = 4;
+  static constexpr std::uint32_t MIN_TILE_SIZE =
+      MAX_TILE_SIZE >> (TILE_TIERS - 1);
+
+  static constexpr std::uint32_t MAX_SHADOWED_LIGHTS = 32;
+  static constexpr std::uint32_t MAX_FACE_UPDATES_PER_FRAME = 24;
+
+  static constexpr float SHADOW_NEAR = 0.05f;
+
+  // One shadow data buffer is kept per frame in flight. dynamicRendering
+  // renders the faces with vkCmdBeginRendering instead of a render pass, the
+  // caller has to check that the device supports it.
+  VlknShadowAtlas(VlknDevice &device, std::uint32_t framesInFlight,
+                  bool dynamicRendering = false);
+  ~VlknShadowAtlas();
+
+  VlknShadowAtlas(const VlknShadowAtlas &) = delete;
+  VlknShadowAtlas &operator=(const VlknShadowAtlas &) = delete;
+
+  // Picks the shadowed lights, sets their shadowIndex, finds the stale faces
+  // to render this frame and uploads the shadow data of frameIndex.
+  // lightEntities holds the entity of every light.
+  void update(std::uint32_t frameIndex, const VlknCamera &camera,
+              VkExtent2D extent, VlknRegistry &registry,
+              const VlknBvh &sceneBvh, std::vector<PointLight> &lights,
+              const std::vector<Entity> &lightEntities);
+
+  // Renders the faces picked by update(), must be recorded outside of any
+  // other render pass with the atlas in the depth attachment layout
+  void record(VkCommandBuffer commandBuffer, VlknRegistry &registry);
+  // Whether record() renders anything this frame
+  bool hasFaceUpdates() const { return !faceUpdates.empty(); }
+
+  // Sampled in the depth read only layout outside of record()
+  VkImage getAtlasImage() const { return atlasImage; }
+
+  VkDescriptorBufferInfo shadowDataDescriptorInfo(std::uint32_t frameIndex);
+  VkDescriptorImageInfo atlasDescriptorInfo() const;
+
+private:
+  struct ShadowLight {
+    Entity entity = NULL_ENTITY;
+    // Tile tier, or -1 if the slot is free
+    std::int32_t tier = -1;
+    std::uint32_t stamp = 0;
+    float influence = 0.0f;
+    std::array<glm::uvec2, 6> tiles{};
+    std::array<std::size_t, 6> signatures{};
+    std::array<std::uint32_t, 6> age{};
+    std::array<bool, 6> rendered{};
+  };
+
+  struct FaceUpdate {
+    std::uint32_t slot;
+    std::uint32_t face;
+    glm::mat4 viewProjection;
+    std::size_t signature;
+    float priority;
+    std::uint32_t casterOffset;
+    std::uint32_t casterCount;
+  };
+
+  static std::uint32_t tileSize(std::uint32_t tier) {
+    return MAX_TILE_SIZE >> tier;
+  }
+
+  void createAtlas();
+  void createSampler();
+  void createRenderPass();
+  void createFramebuffer();
+  void createPipelineLayout();
+  void createPipeline();
+
+  bool allocateTile(std::uint32_t tier, glm::uvec2 &origin);
+  void freeTile(std::uint32_t tier, glm::uvec2 origin);
+  // Allocates six tiles at the tier or any smaller one, returns false and
+  // leaves the slot free if the atlas is full
+  bool allocateFaces(ShadowLight &light, std::uint32_t tier);
+  void releaseSlot(std::uint32_t slot);
+
+  void collectFaceUpdates(std::uint32_t slot, const PointLight &light,
+                          VlknRegistry &registry, const VlknBvh &sceneBvh);
+
+  VlknDevice &vlknDevice;
+  bool dynamicRendering;
+
+  VkImage atlasImage = VK_NULL_HANDLE;
+  VkDeviceMemory atlasMemory = VK_NULL_HANDLE;
+  VkImageView atlasView = VK_NULL_HANDLE;
+  VkSampler atlasSampler = VK_NULL_HANDLE;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+  VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+  std::unique_ptr<VlknPipeline> vlknPipeline;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+
+  std::vector<std::unique_ptr<VlknBuffer>> shadowDataBuffers{};
+
+  // Free tile origins in texels, per tier
+  std::array<std::vector<glm::uvec2>, TILE_TIERS> freeTiles{};
+
+  std::array<ShadowLight, MAX_SHADOWED_LIGHTS> slots{};
+  std::array<ShadowData, MAX_SHADOWED_LIGHTS> shadowData{};
+  // Slot of every entity index, only valid if the slot's entity matches
+  std::vector<std::uint32_t> slotOfEntity{};
+  std::uint32_t updateStamp = 0;
+
+  struct Candidate {
+    std::uint32_t light;
+    float influence;
+  };
+  std::vector<Candidate> candidates{};
+
+  std::vector<FaceUpdate> faceUpdates{};
+  std::vector<Entity> lightCasters{};
+  std::vector<Entity> faceCasters{};
+};
+
+} // namespace vlkn
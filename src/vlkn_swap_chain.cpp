@@ -7,18 +7,166 @@
 #include <limits>
 #include <memory>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 
 namespace vlkn {
 
-VlknSwapChain::VlknSwapChain(VlknDevice &deviceRef, VkExtent2D extent)
-    : device{deviceRef}, windowExtent{extent} {
+namespace {
+
+// Accumulation and revealage targets, cleared when the transparent subpass
+// begins and only read back by the composite subpass
+void transparencyAttachments(VkSampleCountFlagBits samples,
+                             VkAttachmentDescription &accumAttachment,
+                             VkAttachmentDescription &revealageAttachment) {
+  accumAttachment = {};
+  accumAttachment.format = VlknSwapChain::ACCUM_FORMAT;
+  accumAttachment.samples = samples;
+  accumAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  accumAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  accumAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  accumAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  accumAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  accumAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  revealageAttachment = accumAttachment;
+  revealageAttachment.format = VlknSwapChain::REVEALAGE_FORMAT;
+}
+
+// Dependencies of the transparent and composite subpasses. Depth written by
+// the geometry subpass is tested against, the accumulated targets are read
+// per pixel and the composite blends over the lighting subpass' output.
+void transparencyDependencies(uint32_t geometrySubpass,
+                              uint32_t lightingSubpass,
+                              uint32_t transparentSubpass,
+                              uint32_t compositeSubpass,
+                              VkSubpassDependency *dependencies) {
+  dependencies[0].srcSubpass = geometrySubpass;
+  dependencies[0].dstSubpass = transparentSubpass;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+  dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  dependencies[1].srcSubpass = transparentSubpass;
+  dependencies[1].dstSubpass = compositeSubpass;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+  dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  dependencies[2].srcSubpass = lightingSubpass;
+  dependencies[2].dstSubpass = compositeSubpass;
+  dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[2].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[2].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                  VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+}
+
+// Attachment references shared by the transparent and composite subpasses of
+// both render passes
+const std::array<VkAttachmentReference, 2> TRANSPARENCY_WRITE_REFS = {
+    VkAttachmentReference{VlknSwapChain::ACCUM_ATTACHMENT,
+                          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+    VkAttachmentReference{VlknSwapChain::REVEALAGE_ATTACHMENT,
+                          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}};
+const std::array<VkAttachmentReference, 2> TRANSPARENCY_READ_REFS = {
+    VkAttachmentReference{VlknSwapChain::ACCUM_ATTACHMENT,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+    VkAttachmentReference{VlknSwapChain::REVEALAGE_ATTACHMENT,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}};
+// A multisampled pass resolves the transparency targets into single sampled
+// ones and reads those back, the input attachments may differ in sample
+// count from the colour attachment
+const std::array<VkAttachmentReference, 2> TRANSPARENCY_RESOLVE_REFS = {
+    VkAttachmentReference{VlknSwapChain::ACCUM_RESOLVE_ATTACHMENT,
+                          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+    VkAttachmentReference{VlknSwapChain::REVEALAGE_RESOLVE_ATTACHMENT,
+                          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}};
+const std::array<VkAttachmentReference, 2> TRANSPARENCY_RESOLVED_READ_REFS = {
+    VkAttachmentReference{VlknSwapChain::ACCUM_RESOLVE_ATTACHMENT,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+    VkAttachmentReference{VlknSwapChain::REVEALAGE_RESOLVE_ATTACHMENT,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}};
+const VkAttachmentReference COLOR_REF = {
+    0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+const VkAttachmentReference COLOR_RESOLVE_REF = {
+    VlknSwapChain::COLOR_RESOLVE_ATTACHMENT,
+    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+const VkAttachmentReference DEPTH_READ_REF = {
+    1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+// The shaded image is not touched by the transparent subpass but blended
+// over by the composite subpass after it
+const uint32_t COLOR_ATTACHMENT = 0;
+
+void transparencySubpasses(bool multisampled,
+                           VkSubpassDescription &transparentSubpass,
+                           VkSubpassDescription &compositeSubpass) {
+  transparentSubpass = {};
+  transparentSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  transparentSubpass.colorAttachmentCount =
+      static_cast<uint32_t>(TRANSPARENCY_WRITE_REFS.size());
+  transparentSubpass.pColorAttachments = TRANSPARENCY_WRITE_REFS.data();
+  transparentSubpass.pDepthStencilAttachment = &DEPTH_READ_REF;
+  transparentSubpass.preserveAttachmentCount = 1;
+  transparentSubpass.pPreserveAttachments = &COLOR_ATTACHMENT;
+
+  compositeSubpass = {};
+  compositeSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  compositeSubpass.colorAttachmentCount = 1;
+  compositeSubpass.pColorAttachments = &COLOR_REF;
+  compositeSubpass.inputAttachmentCount =
+      static_cast<uint32_t>(TRANSPARENCY_READ_REFS.size());
+  compositeSubpass.pInputAttachments = TRANSPARENCY_READ_REFS.data();
+
+  // Resolving in the subpass that last writes an attachment lets tilers
+  // resolve from tile memory instead of storing every sample
+  if (multisampled) {
+    transparentSubpass.pResolveAttachments = TRANSPARENCY_RESOLVE_REFS.data();
+    compositeSubpass.pInputAttachments =
+        TRANSPARENCY_RESOLVED_READ_REFS.data();
+    compositeSubpass.pResolveAttachments = &COLOR_RESOLVE_REF;
+  }
+}
+
+// The lighting subpass reads the G-buffer per pixel, so the deferred path
+// stays single sampled
+VkSampleCountFlagBits clampedSampleCount(VlknDevice &device,
+                                         RenderPath renderPath,
+                                         VkSampleCountFlagBits requested) {
+  if (renderPath == RenderPath::Deferred) {
+    return VK_SAMPLE_COUNT_1_BIT;
+  }
+  return device.clampSampleCount(requested);
+}
+
+} // namespace
+
+VlknSwapChain::VlknSwapChain(VlknDevice &deviceRef, VkExtent2D extent,
+                             RenderPath renderPath,
+                             VkSampleCountFlagBits sampleCount,
+                             bool dynamicRendering, uint32_t framesInFlight)
+    : device{deviceRef}, windowExtent{extent}, renderPath{renderPath},
+      sampleCount{clampedSampleCount(deviceRef, renderPath, sampleCount)},
+      dynamicRendering{dynamicRendering}, framesInFlight{framesInFlight} {
   init();
 }
 
 VlknSwapChain::VlknSwapChain(VlknDevice &deviceRef, VkExtent2D extent,
+                             RenderPath renderPath,
+                             VkSampleCountFlagBits sampleCount,
+                             bool dynamicRendering, uint32_t framesInFlight,
                              std::shared_ptr<VlknSwapChain> previous)
-    : device{deviceRef}, windowExtent{extent}, oldSwapChain(previous) {
+    : device{deviceRef}, windowExtent{extent}, renderPath{renderPath},
+      sampleCount{clampedSampleCount(deviceRef, renderPath, sampleCount)},
+      dynamicRendering{dynamicRendering}, framesInFlight{framesInFlight},
+      oldSwapChain(previous) {
   init();
 
   oldSwapChain = nullptr;
@@ -27,8 +175,27 @@ VlknSwapChain::VlknSwapChain(VlknDevice &deviceRef, VkExtent2D extent,
 void VlknSwapChain::init() {
   createSwapChain();
   createImageViews();
-  createRenderPass();
+  if (oldSwapChain != nullptr &&
+      oldSwapChain->swapChainImageFormat == swapChainImageFormat &&
+      oldSwapChain->renderPath == renderPath &&
+      oldSwapChain->sampleCount == sampleCount &&
+      oldSwapChain->dynamicRendering == dynamicRendering) {
+    takeOverRenderPasses();
+  } else {
+    if (renderPath == RenderPath::Deferred) {
+      createDeferredRenderPass();
+    } else {
+      createRenderPass();
+    }
+    if (!dynamicRendering) {
+      createPresentRenderPass();
+    }
+  }
+  createSceneResources();
+  createColorResources();
   createDepthResources();
+  createGBufferResources();
+  createTransparencyResources();
   createFramebuffers();
   createSyncObjects();
 }
@@ -44,32 +211,74 @@ VlknSwapChain::~VlknSwapChain() {
     swapChain = nullptr;
   }
 
+  for (size_t i = 0; i < sceneImages.size(); i++) {
+    vkDestroyImageView(device.device(), sceneImageViews[i], nullptr);
+    vkDestroyImage(device.device(), sceneImages[i], nullptr);
+    vkFreeMemory(device.device(), sceneImageMemorys[i], nullptr);
+  }
+
+  for (size_t i = 0; i < colorImages.size(); i++) {
+    vkDestroyImageView(device.device(), colorImageViews[i], nullptr);
+    vkDestroyImage(device.device(), colorImages[i], nullptr);
+    vkFreeMemory(device.device(), colorImageMemorys[i], nullptr);
+  }
+
   for (size_t i = 0; i < depthImages.size(); i++) {
     vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
     vkDestroyImage(device.device(), depthImages[i], nullptr);
     vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
   }
 
+  for (size_t i = 0; i < albedoImages.size(); i++) {
+    vkDestroyImageView(device.device(), albedoImageViews[i], nullptr);
+    vkDestroyImage(device.device(), albedoImages[i], nullptr);
+    vkFreeMemory(device.device(), albedoImageMemorys[i], nullptr);
+    vkDestroyImageView(device.device(), normalImageViews[i], nullptr);
+    vkDestroyImage(device.device(), normalImages[i], nullptr);
+    vkFreeMemory(device.device(), normalImageMemorys[i], nullptr);
+  }
+
+  for (size_t i = 0; i < accumImages.size(); i++) {
+    vkDestroyImageView(device.device(), accumImageViews[i], nullptr);
+    vkDestroyImage(device.device(), accumImages[i], nullptr);
+    vkFreeMemory(device.device(), accumImageMemorys[i], nullptr);
+    vkDestroyImageView(device.device(), revealageImageViews[i], nullptr);
+    vkDestroyImage(device.device(), revealageImages[i], nullptr);
+    vkFreeMemory(device.device(), revealageImageMemorys[i], nullptr);
+  }
+
+  for (size_t i = 0; i < accumResolveImages.size(); i++) {
+    vkDestroyImageView(device.device(), accumResolveImageViews[i], nullptr);
+    vkDestroyImage(device.device(), accumResolveImages[i], nullptr);
+    vkFreeMemory(device.device(), accumResolveImageMemorys[i], nullptr);
+    vkDestroyImageView(device.device(), revealageResolveImageViews[i],
+                       nullptr);
+    vkDestroyImage(device.device(), revealageResolveImages[i], nullptr);
+    vkFreeMemory(device.device(), revealageResolveImageMemorys[i], nullptr);
+  }
+
   for (auto framebuffer : swapChainFramebuffers) {
     vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
   }
+  for (auto framebuffer : presentFramebuffers) {
+    vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
+  }
 
   vkDestroyRenderPass(device.device(), renderPass, nullptr);
+  vkDestroyRenderPass(device.device(), presentRenderPass, nullptr);
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  // Empty if a newer swap chain took the semaphores over
+  for (size_t i = 0; i < imageAvailableSemaphores.size(); i++) {
     vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-    vkDestroyFence(device.device(), inFlightFences[i], nullptr);
   }
 }
 
-VkResult VlknSwapChain::acquireNextImage(uint32_t *imageIndex) {
-  vkWaitForFences(device.device(), 1, &inFlightFences[currentFrame], VK_TRUE,
-                  std::numeric_limits<uint64_t>::max());
-
+VkResult VlknSwapChain::acquireNextImage(uint32_t frameIndex,
+                                         uint32_t *imageIndex) {
   VkResult result = vkAcquireNextImageKHR(
       device.device(), swapChain, std::numeric_limits<uint64_t>::max(),
-      imageAvailableSemaphores[currentFrame],
+      imageAvailableSemaphores[frameIndex],
 
       VK_NULL_HANDLE, imageIndex);
 
@@ -77,17 +286,18 @@ VkResult VlknSwapChain::acquireNextImage(uint32_t *imageIndex) {
 }
 
 VkResult VlknSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers,
-                                             uint32_t *imageIndex) {
-  if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-    vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE,
-                    UINT64_MAX);
+                                             uint32_t *imageIndex,
+                                             uint32_t frameIndex,
+                                             uint64_t timelineValue) {
+  if (imagesInFlight[*imageIndex] != 0) {
+    device.waitGraphicsTimeline(imagesInFlight[*imageIndex]);
   }
-  imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
+  imagesInFlight[*imageIndex] = timelineValue;
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
+  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[frameIndex]};
   VkPipelineStageFlags waitStages[] = {
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
   submitInfo.waitSemaphoreCount = 1;
@@ -97,13 +307,25 @@ VkResult VlknSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers,
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = buffers;
 
-  VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-  submitInfo.signalSemaphoreCount = 1;
+  // Presenting waits on the binary semaphore, the CPU on the timeline
+  VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[frameIndex],
+                                    device.graphicsTimeline()};
+  submitInfo.signalSemaphoreCount = 2;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
-  vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-  if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo,
-                    inFlightFences[currentFrame]) != VK_SUCCESS) {
+  // Values of binary semaphores are ignored
+  uint64_t waitValues[] = {0};
+  uint64_t signalValues[] = {0, timelineValue};
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.waitSemaphoreValueCount = 1;
+  timelineInfo.pWaitSemaphoreValues = waitValues;
+  timelineInfo.signalSemaphoreValueCount = 2;
+  timelineInfo.pSignalSemaphoreValues = signalValues;
+  submitInfo.pNext = &timelineInfo;
+
+  if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) !=
+      VK_SUCCESS) {
     throw std::runtime_error("failed to submit draw command buffer!");
   }
 
@@ -111,7 +333,7 @@ VkResult VlknSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers,
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
   presentInfo.waitSemaphoreCount = 1;
-  presentInfo.pWaitSemaphores = signalSemaphores;
+  presentInfo.pWaitSemaphores = &renderFinishedSemaphores[frameIndex];
 
   VkSwapchainKHR swapChains[] = {swapChain};
   presentInfo.swapchainCount = 1;
@@ -119,13 +341,32 @@ VkResult VlknSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers,
 
   presentInfo.pImageIndices = imageIndex;
 
-  auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+  // The frame's timeline value doubles as its present id
+  VkPresentIdKHR presentId{};
+  presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+  presentId.swapchainCount = 1;
+  presentId.pPresentIds = &timelineValue;
+  if (device.supportsPresentWait()) {
+    presentInfo.pNext = &presentId;
+    if (firstPresentId == 0) {
+      firstPresentId = timelineValue;
+    }
+  }
 
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
   return result;
 }
 
+VkResult VlknSwapChain::waitForPresent(uint64_t presentId, uint64_t timeout) {
+  // Ids presented to an older swap chain can not be waited for on this one,
+  // they are treated as presented
+  if (firstPresentId == 0 || presentId < firstPresentId) {
+    return VK_SUCCESS;
+  }
+  return device.waitForPresent(swapChain, presentId, timeout);
+}
+
 void VlknSwapChain::createSwapChain() {
   SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
@@ -213,14 +454,14 @@ void VlknSwapChain::createImageViews() {
 void VlknSwapChain::createRenderPass() {
   VkAttachmentDescription depthAttachment{};
   depthAttachment.format = findDepthFormat();
-  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.samples = sampleCount;
   depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
   depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
   depthAttachment.finalLayout =
-      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
   VkAttachmentReference depthAttachmentRef{};
   depthAttachmentRef.attachment = 1;
@@ -228,57 +469,264 @@ void VlknSwapChain::createRenderPass() {
 
   VkAttachmentDescription colorAttachment = {};
   colorAttachment.format = getSwapChainImageFormat();
-  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachment.samples = sampleCount;
   colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
   colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
   VkAttachmentReference colorAttachmentRef = {};
   colorAttachmentRef.attachment = 0;
   colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+  VkAttachmentDescription accumAttachment{};
+  VkAttachmentDescription revealageAttachment{};
+  transparencyAttachments(sampleCount, accumAttachment, revealageAttachment);
+
+  std::vector<VkAttachmentDescription> attachments = {
+      colorAttachment, depthAttachment, accumAttachment, revealageAttachment};
+
+  // The samples are only needed until they are resolved, the scene image
+  // and the resolved transparency targets are written whole by the resolve
+  if (isMultisampled()) {
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+    VkAttachmentDescription colorResolveAttachment = colorAttachment;
+    colorResolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorResolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+    VkAttachmentDescription accumResolveAttachment{};
+    VkAttachmentDescription revealageResolveAttachment{};
+    transparencyAttachments(VK_SAMPLE_COUNT_1_BIT, accumResolveAttachment,
+                            revealageResolveAttachment);
+    accumResolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    revealageResolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+    attachments.push_back(colorResolveAttachment);
+    attachments.push_back(accumResolveAttachment);
+    attachments.push_back(revealageResolveAttachment);
+  }
+
+  std::array<VkSubpassDescription, 3> subpasses{};
+  subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[0].colorAttachmentCount = 1;
+  subpasses[0].pColorAttachments = &colorAttachmentRef;
+  subpasses[0].pDepthStencilAttachment = &depthAttachmentRef;
+  transparencySubpasses(isMultisampled(), subpasses[1], subpasses[2]);
+
+  std::array<VkSubpassDependency, 4> dependencies{};
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  transparencyDependencies(GEOMETRY_SUBPASS, getLightingSubpass(),
+                           getTransparentSubpass(), getCompositeSubpass(),
+                           &dependencies[1]);
+
+  VkRenderPassCreateInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+  renderPassInfo.pAttachments = attachments.data();
+  renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+  renderPassInfo.pSubpasses = subpasses.data();
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
+
+  if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr,
+                         &renderPass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create render pass!");
+  }
+}
+
+void VlknSwapChain::createDeferredRenderPass() {
+  VkAttachmentDescription colorAttachment = {};
+  colorAttachment.format = getSwapChainImageFormat();
+  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentDescription depthAttachment{};
+  depthAttachment.format = findDepthFormat();
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depthAttachment.finalLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  // The G-buffer lives only as long as the render pass
+  VkAttachmentDescription gBufferAttachment = {};
+  gBufferAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  gBufferAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  gBufferAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  gBufferAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  gBufferAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  gBufferAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  gBufferAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkAttachmentDescription albedoAttachment = gBufferAttachment;
+  albedoAttachment.format = ALBEDO_FORMAT;
+  VkAttachmentDescription normalAttachment = gBufferAttachment;
+  normalAttachment.format = NORMAL_FORMAT;
+
+  VkAttachmentDescription accumAttachment{};
+  VkAttachmentDescription revealageAttachment{};
+  transparencyAttachments(VK_SAMPLE_COUNT_1_BIT, accumAttachment,
+                          revealageAttachment);
+
+  // Geometry subpass
+  std::array<VkAttachmentReference, 2> gBufferWriteRefs = {
+      VkAttachmentReference{4, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+      VkAttachmentReference{5, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}};
+  VkAttachmentReference depthWriteRef = {
+      1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  // Lighting subpass, depth is read as an input attachment
+  std::array<VkAttachmentReference, 3> gBufferReadRefs = {
+      VkAttachmentReference{4, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+      VkAttachmentReference{5, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+      VkAttachmentReference{1,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL}};
+
+  std::array<VkSubpassDescription, 4> subpasses{};
+  subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[0].colorAttachmentCount =
+      static_cast<uint32_t>(gBufferWriteRefs.size());
+  subpasses[0].pColorAttachments = gBufferWriteRefs.data();
+  subpasses[0].pDepthStencilAttachment = &depthWriteRef;
+
+  subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[1].colorAttachmentCount = 1;
+  subpasses[1].pColorAttachments = &COLOR_REF;
+  subpasses[1].inputAttachmentCount =
+      static_cast<uint32_t>(gBufferReadRefs.size());
+  subpasses[1].pInputAttachments = gBufferReadRefs.data();
+  subpasses[1].pDepthStencilAttachment = &DEPTH_READ_REF;
+  transparencySubpasses(false, subpasses[2], subpasses[3]);
+
+  std::array<VkSubpassDependency, 5> dependencies{};
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  // Each pixel only reads its own G-buffer texel, so the dependency can stay
+  // within a tile
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = 1;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                  VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+  transparencyDependencies(GEOMETRY_SUBPASS, getLightingSubpass(),
+                           getTransparentSubpass(), getCompositeSubpass(),
+                           &dependencies[2]);
+
+  std::array<VkAttachmentDescription, 6> attachments = {
+      colorAttachment,     depthAttachment,  accumAttachment,
+      revealageAttachment, albedoAttachment, normalAttachment};
+  VkRenderPassCreateInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+  renderPassInfo.pAttachments = attachments.data();
+  renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+  renderPassInfo.pSubpasses = subpasses.data();
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
+
+  if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr,
+                         &renderPass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create render pass!");
+  }
+}
+
+// Render passes built from the same formats are identical, so the old ones
+// are kept instead of creating compatible copies. Systems create pipelines
+// with the render pass of the first swap chain long after it was replaced,
+// e.g. shading variants built on first use.
+void VlknSwapChain::takeOverRenderPasses() {
+  renderPass = oldSwapChain->renderPass;
+  presentRenderPass = oldSwapChain->presentRenderPass;
+  oldSwapChain->renderPass = VK_NULL_HANDLE;
+  oldSwapChain->presentRenderPass = VK_NULL_HANDLE;
+}
+
+void VlknSwapChain::createPresentRenderPass() {
+  // Every pixel is written by the upscale. The render graph transitions the
+  // image after the acquire and for presenting, so the pass keeps it as a
+  // colour attachment. Starting from the undefined layout would add a
+  // transition of the pass' own behind an implicit top of pipe dependency,
+  // which does not wait for the acquire.
+  VkAttachmentDescription colorAttachment = {};
+  colorAttachment.format = getSwapChainImageFormat();
+  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
   VkSubpassDescription subpass = {};
   subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
   subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colorAttachmentRef;
-  subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-  VkSubpassDependency dependency = {};
-  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.srcAccessMask = 0;
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  dependency.dstSubpass = 0;
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
-                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-  std::array<VkAttachmentDescription, 2> attachments = {colorAttachment,
-                                                        depthAttachment};
+  subpass.pColorAttachments = &COLOR_REF;
+
   VkRenderPassCreateInfo renderPassInfo = {};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-  renderPassInfo.pAttachments = attachments.data();
+  renderPassInfo.attachmentCount = 1;
+  renderPassInfo.pAttachments = &colorAttachment;
   renderPassInfo.subpassCount = 1;
   renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
+  renderPassInfo.dependencyCount = 0;
+  renderPassInfo.pDependencies = nullptr;
 
   if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr,
-                         &renderPass) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create render pass!");
+                         &presentRenderPass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create present render pass!");
   }
 }
 
 void VlknSwapChain::createFramebuffers() {
   swapChainFramebuffers.resize(imageCount());
+  presentFramebuffers.resize(dynamicRendering ? 0 : imageCount());
   for (size_t i = 0; i < imageCount(); i++) {
-    std::array<VkImageView, 2> attachments = {swapChainImageViews[i],
-                                              depthImageViews[i]};
+    std::vector<VkImageView> attachments = {
+        isMultisampled() ? colorImageViews[i] : sceneImageViews[i],
+        depthImageViews[i], accumImageViews[i], revealageImageViews[i]};
+    if (renderPath == RenderPath::Deferred) {
+      attachments.push_back(albedoImageViews[i]);
+      attachments.push_back(normalImageViews[i]);
+    } else if (isMultisampled()) {
+      attachments.push_back(sceneImageViews[i]);
+      attachments.push_back(accumResolveImageViews[i]);
+      attachments.push_back(revealageResolveImageViews[i]);
+    }
 
     VkExtent2D swapChainExtent = getSwapChainExtent();
     VkFramebufferCreateInfo framebufferInfo = {};
@@ -294,76 +742,233 @@ void VlknSwapChain::createFramebuffers() {
                             &swapChainFramebuffers[i]) != VK_SUCCESS) {
       throw std::runtime_error("failed to create framebuffer!");
     }
+
+    if (dynamicRendering) {
+      continue;
+    }
+
+    framebufferInfo.renderPass = presentRenderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &swapChainImageViews[i];
+
+    if (vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr,
+                            &presentFramebuffers[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create framebuffer!");
+    }
+  }
+}
+
+void VlknSwapChain::createSceneResources() {
+  // Written by the render pass, or by the resolve when multisampled, and
+  // sampled by the upscale
+  const VkImageUsageFlags usage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+  sceneImages.resize(imageCount());
+  sceneImageMemorys.resize(imageCount());
+  sceneImageViews.resize(imageCount());
+
+  for (size_t i = 0; i < sceneImages.size(); i++) {
+    createAttachmentImage(swapChainImageFormat, usage, VK_SAMPLE_COUNT_1_BIT,
+                          VK_IMAGE_ASPECT_COLOR_BIT, sceneImages[i],
+                          sceneImageMemorys[i], sceneImageViews[i]);
+  }
+}
+
+void VlknSwapChain::createColorResources() {
+  if (!isMultisampled()) {
+    return;
+  }
+
+  // Resolved within the render pass, so the samples never have to leave
+  // tile memory
+  const VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+  colorImages.resize(imageCount());
+  colorImageMemorys.resize(imageCount());
+  colorImageViews.resize(imageCount());
+
+  for (size_t i = 0; i < colorImages.size(); i++) {
+    createAttachmentImage(swapChainImageFormat, usage, sampleCount,
+                          VK_IMAGE_ASPECT_COLOR_BIT, colorImages[i],
+                          colorImageMemorys[i], colorImageViews[i]);
   }
 }
 
 void VlknSwapChain::createDepthResources() {
   VkFormat depthFormat = findDepthFormat();
   swapChainDepthFormat = depthFormat;
-  VkExtent2D swapChainExtent = getSwapChainExtent();
+
+  // Depth is never stored. The deferred lighting subpass reconstructs
+  // positions from it.
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                            VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+  if (renderPath == RenderPath::Deferred) {
+    usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+  }
 
   depthImages.resize(imageCount());
   depthImageMemorys.resize(imageCount());
   depthImageViews.resize(imageCount());
 
   for (size_t i = 0; i < depthImages.size(); i++) {
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = swapChainExtent.width;
-    imageInfo.extent.height = swapChainExtent.height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = depthFormat;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.flags = 0;
-
-    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                               depthImages[i], depthImageMemorys[i]);
+    createAttachmentImage(depthFormat, usage, sampleCount,
+                          VK_IMAGE_ASPECT_DEPTH_BIT, depthImages[i],
+                          depthImageMemorys[i], depthImageViews[i]);
+  }
+}
 
-    VkImageViewCreateInfo viewInfo{};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = depthImages[i];
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = depthFormat;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
+void VlknSwapChain::createGBufferResources() {
+  if (renderPath != RenderPath::Deferred) {
+    return;
+  }
 
-    if (vkCreateImageView(device.device(), &viewInfo, nullptr,
-                          &depthImageViews[i]) != VK_SUCCESS) {
-      throw std::runtime_error("failed to create texture image view!");
-    }
+  // Only read within the render pass, so tilers never have to write the
+  // G-buffer out to memory
+  const VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+  albedoImages.resize(imageCount());
+  albedoImageMemorys.resize(imageCount());
+  albedoImageViews.resize(imageCount());
+  normalImages.resize(imageCount());
+  normalImageMemorys.resize(imageCount());
+  normalImageViews.resize(imageCount());
+
+  for (size_t i = 0; i < albedoImages.size(); i++) {
+    createAttachmentImage(ALBEDO_FORMAT, usage, VK_SAMPLE_COUNT_1_BIT,
+                          VK_IMAGE_ASPECT_COLOR_BIT, albedoImages[i],
+                          albedoImageMemorys[i], albedoImageViews[i]);
+    createAttachmentImage(NORMAL_FORMAT, usage, VK_SAMPLE_COUNT_1_BIT,
+                          VK_IMAGE_ASPECT_COLOR_BIT, normalImages[i],
+                          normalImageMemorys[i], normalImageViews[i]);
+  }
+}
+
+void VlknSwapChain::createTransparencyResources() {
+  const VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+  accumImages.resize(imageCount());
+  accumImageMemorys.resize(imageCount());
+  accumImageViews.resize(imageCount());
+  revealageImages.resize(imageCount());
+  revealageImageMemorys.resize(imageCount());
+  revealageImageViews.resize(imageCount());
+
+  for (size_t i = 0; i < accumImages.size(); i++) {
+    createAttachmentImage(ACCUM_FORMAT, usage, sampleCount,
+                          VK_IMAGE_ASPECT_COLOR_BIT, accumImages[i],
+                          accumImageMemorys[i], accumImageViews[i]);
+    createAttachmentImage(REVEALAGE_FORMAT, usage, sampleCount,
+                          VK_IMAGE_ASPECT_COLOR_BIT, revealageImages[i],
+                          revealageImageMemorys[i], revealageImageViews[i]);
+  }
+
+  if (!isMultisampled()) {
+    return;
+  }
+
+  accumResolveImages.resize(imageCount());
+  accumResolveImageMemorys.resize(imageCount());
+  accumResolveImageViews.resize(imageCount());
+  revealageResolveImages.resize(imageCount());
+  revealageResolveImageMemorys.resize(imageCount());
+  revealageResolveImageViews.resize(imageCount());
+
+  for (size_t i = 0; i < accumResolveImages.size(); i++) {
+    createAttachmentImage(ACCUM_FORMAT, usage, VK_SAMPLE_COUNT_1_BIT,
+                          VK_IMAGE_ASPECT_COLOR_BIT, accumResolveImages[i],
+                          accumResolveImageMemorys[i],
+                          accumResolveImageViews[i]);
+    createAttachmentImage(REVEALAGE_FORMAT, usage, VK_SAMPLE_COUNT_1_BIT,
+                          VK_IMAGE_ASPECT_COLOR_BIT, revealageResolveImages[i],
+                          revealageResolveImageMemorys[i],
+                          revealageResolveImageViews[i]);
+  }
+}
+
+void VlknSwapChain::createAttachmentImage(VkFormat format,
+                                          VkImageUsageFlags usage,
+                                          VkSampleCountFlagBits samples,
+                                          VkImageAspectFlags aspect,
+                                          VkImage &image,
+                                          VkDeviceMemory &imageMemory,
+                                          VkImageView &imageView) {
+  VkExtent2D swapChainExtent = getSwapChainExtent();
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = swapChainExtent.width;
+  imageInfo.extent.height = swapChainExtent.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = usage;
+  imageInfo.samples = samples;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.flags = 0;
+
+  // Lazily allocated memory may never be backed on tile based GPUs
+  VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  if ((usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) &&
+      device.hasMemoryType(VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+    properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+  }
+
+  device.createImageWithInfo(imageInfo, properties, image, imageMemory);
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = format;
+  viewInfo.subresourceRange.aspectMask = aspect;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  if (vkCreateImageView(device.device(), &viewInfo, nullptr, &imageView) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture image view!");
   }
 }
 
 void VlknSwapChain::createSyncObjects() {
-  imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+  // Nothing has used the new images yet
+  imagesInFlight.resize(imageCount(), 0);
+
+  // The frames in flight keep their semaphores across recreation, frames
+  // still running on the old swap chain may wait on or signal them
+  if (oldSwapChain != nullptr) {
+    imageAvailableSemaphores =
+        std::move(oldSwapChain->imageAvailableSemaphores);
+    renderFinishedSemaphores =
+        std::move(oldSwapChain->renderFinishedSemaphores);
+    oldSwapChain->imageAvailableSemaphores.clear();
+    oldSwapChain->renderFinishedSemaphores.clear();
+    return;
+  }
+
+  imageAvailableSemaphores.resize(framesInFlight);
+  renderFinishedSemaphores.resize(framesInFlight);
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  VkFenceCreateInfo fenceInfo = {};
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < framesInFlight; i++) {
     if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr,
                           &imageAvailableSemaphores[i]) != VK_SUCCESS ||
         vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr,
-                          &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-        vkCreateFence(device.device(), &fenceInfo, nullptr,
-                      &inFlightFences[i]) != VK_SUCCESS) {
+                          &renderFinishedSemaphores[i]) != VK_SUCCESS) {
       throw std::runtime_error(
           "failed to create synchronization objects for a frame!");
     }
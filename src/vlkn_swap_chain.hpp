@@ -9,12 +9,78 @@
 
 namespace vlkn {
 
+// Forward shades every fragment in a single subpass. Deferred writes albedo,
+// normals and depth in a geometry subpass and shades each pixel once in a
+// lighting subpass that reads them back as input attachments, so tile based
+// GPUs can keep the G-buffer in tile memory.
+//
+// Both paths end with the same two subpasses: a transparent subpass that
+// accumulates weighted blended order independent transparency, and a
+// composite subpass that blends the result over the shaded image.
+//
+// The forward path can be multisampled. Colour, depth and the transparency
+// targets are then transient multisampled images, the transparency targets
+// are resolved at the end of the transparent subpass and the colour into the
+// scene image at the end of the composite subpass.
+//
+// The scene is not rendered into the swap chain image but into an offscreen
+// scene image, and only into the render area at its top left corner, so the
+// scene resolution can change without recreating any attachment. A separate
+// present render pass upscales it into the swap chain image and draws the
+// overlay at native resolution.
+//
+// The scene render pass leaves the scene image as a colour attachment and
+// the present render pass leaves the swap chain image as one, the frame's
+// render graph transitions them for sampling and presenting.
+enum class RenderPath {
+  Forward,
+  Deferred,
+};
+
 class VlknSwapChain {
 public:
-  static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+  // Bounds of the frames in flight a renderer may be configured with. More
+  // frames keep the GPU busier at the cost of input latency.
+  static constexpr uint32_t MIN_FRAMES_IN_FLIGHT = 1;
+  static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+  static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+  static constexpr uint32_t GEOMETRY_SUBPASS = 0;
+  static constexpr VkFormat ALBEDO_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+  static constexpr VkFormat NORMAL_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+  // Weighted premultiplied colour in rgb and weighted alpha in a
+  static constexpr VkFormat ACCUM_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+  // Product of (1 - alpha) of every transparent fragment
+  static constexpr VkFormat REVEALAGE_FORMAT = VK_FORMAT_R16_SFLOAT;
 
-  VlknSwapChain(VlknDevice &deviceRef, VkExtent2D windowExtent);
+  // The transparency targets follow the colour and depth attachments on
+  // both paths, the G-buffer follows them on the deferred path
+  static constexpr uint32_t ACCUM_ATTACHMENT = 2;
+  static constexpr uint32_t REVEALAGE_ATTACHMENT = 3;
+  // Single sampled resolve targets of a multisampled forward pass, in place
+  // of the G-buffer of the deferred path. The colour resolves into the scene
+  // image.
+  static constexpr uint32_t COLOR_RESOLVE_ATTACHMENT = 4;
+  static constexpr uint32_t ACCUM_RESOLVE_ATTACHMENT = 5;
+  static constexpr uint32_t REVEALAGE_RESOLVE_ATTACHMENT = 6;
+
+  // sampleCount is clamped to what the device supports, and to one sample on
+  // the deferred path. With dynamicRendering the swap chain image is written
+  // with vkCmdBeginRendering and no present render pass or framebuffers are
+  // created. One acquire and one render finished semaphore are created per
+  // frame in flight.
+  //
+  // Built from a previous swap chain, it takes over the semaphores of the
+  // frames in flight, so destroying the previous one never destroys what the
+  // next frames wait on. With unchanged formats it takes over the render
+  // passes as well, so pipelines created with them at any time stay valid
+  // for as long as the swap chains are recreated from each other.
+  VlknSwapChain(VlknDevice &deviceRef, VkExtent2D windowExtent,
+                RenderPath renderPath, VkSampleCountFlagBits sampleCount,
+                bool dynamicRendering, uint32_t framesInFlight);
   VlknSwapChain(VlknDevice &deviceRef, VkExtent2D windowExtent,
+                RenderPath renderPath, VkSampleCountFlagBits sampleCount,
+                bool dynamicRendering, uint32_t framesInFlight,
                 std::shared_ptr<VlknSwapChain> previous);
   ~VlknSwapChain();
 
@@ -25,34 +91,98 @@ public:
     return swapChainFramebuffers[index];
   }
   VkRenderPass getRenderPass() { return renderPass; }
+  // Null with dynamic rendering
+  VkFramebuffer getPresentFrameBuffer(int index) {
+    return dynamicRendering ? VK_NULL_HANDLE : presentFramebuffers[index];
+  }
+  VkRenderPass getPresentRenderPass() { return presentRenderPass; }
+  bool usesDynamicRendering() const { return dynamicRendering; }
+  // Shaded scene, sampled by the present render pass
+  VkImage getSceneImage(int index) { return sceneImages[index]; }
+  VkImageView getSceneImageView(int index) { return sceneImageViews[index]; }
+  VkImage getImage(int index) { return swapChainImages[index]; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+  VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
+  VkImageView getAlbedoImageView(int index) { return albedoImageViews[index]; }
+  VkImageView getNormalImageView(int index) { return normalImageViews[index]; }
+  // Views of the transparency targets as read by the composite subpass,
+  // which are the resolve targets when multisampled
+  VkImageView getAccumImageView(int index) {
+    return isMultisampled() ? accumResolveImageViews[index]
+                            : accumImageViews[index];
+  }
+  VkImageView getRevealageImageView(int index) {
+    return isMultisampled() ? revealageResolveImageViews[index]
+                            : revealageImageViews[index];
+  }
   size_t imageCount() { return swapChainImages.size(); }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
   VkExtent2D getSwapChainExtent() { return swapChainExtent; }
   uint32_t width() { return swapChainExtent.width; }
   uint32_t height() { return swapChainExtent.height; }
 
+  RenderPath getRenderPath() const { return renderPath; }
+  VkSampleCountFlagBits getSampleCount() const { return sampleCount; }
+  bool isMultisampled() const { return sampleCount != VK_SAMPLE_COUNT_1_BIT; }
+  uint32_t attachmentCount() const {
+    if (renderPath == RenderPath::Deferred) {
+      return 6;
+    }
+    return isMultisampled() ? 7 : 4;
+  }
+  // Subpass that shades opaque geometry into the scene image
+  uint32_t getLightingSubpass() const {
+    return renderPath == RenderPath::Deferred ? 1 : GEOMETRY_SUBPASS;
+  }
+  // Subpass that accumulates transparent geometry, depth is read only
+  uint32_t getTransparentSubpass() const { return getLightingSubpass() + 1; }
+  // Subpass that blends the transparency over the scene image
+  uint32_t getCompositeSubpass() const { return getLightingSubpass() + 2; }
+
   float extentAspectRatio() {
     return static_cast<float>(swapChainExtent.width) /
            static_cast<float>(swapChainExtent.height);
   }
   VkFormat findDepthFormat();
 
-  VkResult acquireNextImage(uint32_t *imageIndex);
+  // The caller has to wait until the frame that last used frameIndex has
+  // finished
+  VkResult acquireNextImage(uint32_t frameIndex, uint32_t *imageIndex);
+  // Signals timelineValue on the device's graphics timeline once the buffers
+  // have executed, after waiting for the previous frame drawing to the image
   VkResult submitCommandBuffers(const VkCommandBuffer *buffers,
-                                uint32_t *imageIndex);
+                                uint32_t *imageIndex, uint32_t frameIndex,
+                                uint64_t timelineValue);
+  // Waits until the frame that signalled presentId on the graphics timeline
+  // has been presented. Only valid if the device supports present wait.
+  VkResult waitForPresent(uint64_t presentId, uint64_t timeout);
 
   bool compareSwapFormats(const VlknSwapChain &swapChain) const {
     return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
-           swapChain.swapChainImageFormat == swapChainImageFormat;
+           swapChain.swapChainImageFormat == swapChainImageFormat &&
+           swapChain.renderPath == renderPath &&
+           swapChain.sampleCount == sampleCount &&
+           swapChain.dynamicRendering == dynamicRendering;
   }
 
 private:
   void init();
   void createSwapChain();
   void createImageViews();
+  void createSceneResources();
+  void createColorResources();
   void createDepthResources();
+  void createGBufferResources();
+  void createTransparencyResources();
+  void createAttachmentImage(VkFormat format, VkImageUsageFlags usage,
+                             VkSampleCountFlagBits samples,
+                             VkImageAspectFlags aspect, VkImage &image,
+                             VkDeviceMemory &imageMemory,
+                             VkImageView &imageView);
   void createRenderPass();
+  void createDeferredRenderPass();
+  void createPresentRenderPass();
+  void takeOverRenderPasses();
   void createFramebuffers();
   void createSyncObjects();
 
@@ -67,25 +197,60 @@ private:
   VkExtent2D swapChainExtent;
 
   std::vector<VkFramebuffer> swapChainFramebuffers;
-  VkRenderPass renderPass;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+  std::vector<VkFramebuffer> presentFramebuffers;
+  VkRenderPass presentRenderPass = VK_NULL_HANDLE;
 
+  std::vector<VkImage> sceneImages;
+  std::vector<VkDeviceMemory> sceneImageMemorys;
+  std::vector<VkImageView> sceneImageViews;
+  // Multisampled colour, resolved into the scene image
+  std::vector<VkImage> colorImages;
+  std::vector<VkDeviceMemory> colorImageMemorys;
+  std::vector<VkImageView> colorImageViews;
   std::vector<VkImage> depthImages;
   std::vector<VkDeviceMemory> depthImageMemorys;
   std::vector<VkImageView> depthImageViews;
+  // G-buffer of the deferred path, never stored to memory
+  std::vector<VkImage> albedoImages;
+  std::vector<VkDeviceMemory> albedoImageMemorys;
+  std::vector<VkImageView> albedoImageViews;
+  std::vector<VkImage> normalImages;
+  std::vector<VkDeviceMemory> normalImageMemorys;
+  std::vector<VkImageView> normalImageViews;
+  // Transparency targets, never stored to memory either
+  std::vector<VkImage> accumImages;
+  std::vector<VkDeviceMemory> accumImageMemorys;
+  std::vector<VkImageView> accumImageViews;
+  std::vector<VkImage> revealageImages;
+  std::vector<VkDeviceMemory> revealageImageMemorys;
+  std::vector<VkImageView> revealageImageViews;
+  std::vector<VkImage> accumResolveImages;
+  std::vector<VkDeviceMemory> accumResolveImageMemorys;
+  std::vector<VkImageView> accumResolveImageViews;
+  std::vector<VkImage> revealageResolveImages;
+  std::vector<VkDeviceMemory> revealageResolveImageMemorys;
+  std::vector<VkImageView> revealageResolveImageViews;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
 
   VlknDevice &device;
   VkExtent2D windowExtent;
+  RenderPath renderPath;
+  VkSampleCountFlagBits sampleCount;
+  bool dynamicRendering;
+  uint32_t framesInFlight;
 
   VkSwapchainKHR swapChain;
   std::shared_ptr<VlknSwapChain> oldSwapChain;
 
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
-  std::vector<VkFence> inFlightFences;
-  std::vector<VkFence> imagesInFlight;
-  size_t currentFrame = 0;
+  // Graphics timeline value of the last frame that drew to each image, 0 if
+  // none did
+  std::vector<uint64_t> imagesInFlight;
+  // Id of the first present to this swap chain, 0 before it
+  uint64_t firstPresentId = 0;
 };
 
 } // namespace vlkn
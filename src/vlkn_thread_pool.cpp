@@ -0,0 +1,85 @@
+// header
+#include "vlkn_thread_pool.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+
+namespace vlkn {
+
+VlknThreadPool::VlknThreadPool(std::uint32_t threadCount) {
+  workers.reserve(threadCount);
+  for (std::uint32_t i = 0; i < threadCount; i++) {
+    workers.emplace_back(&VlknThreadPool::workerLoop, this);
+  }
+}
+
+VlknThreadPool::~VlknThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{queueMutex};
+    stopping = true;
+  }
+  queueCondition.notify_all();
+
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+std::uint32_t VlknThreadPool::defaultThreadCount() {
+  // Leave one core for the main thread, which also works in parallelFor
+  std::uint32_t hardwareThreads = std::thread::hardware_concurrency();
+  return std::max(hardwareThreads, 2u) - 1;
+}
+
+void VlknThreadPool::parallelFor(
+    std::uint32_t count, const std::function<void(std::uint32_t)> &task) {
+  if (count == 0) {
+    return;
+  }
+
+  // Indices are handed out dynamically so uneven work balances itself
+  std::atomic<std::uint32_t> nextIndex{0};
+  auto runTasks = [&]() {
+    for (std::uint32_t i = nextIndex++; i < count; i = nextIndex++) {
+      task(i);
+    }
+  };
+
+  std::uint32_t helperCount = std::min(getThreadCount(), count - 1);
+
+  std::vector<std::future<void>> helpers;
+  helpers.reserve(helperCount);
+  for (std::uint32_t i = 0; i < helperCount; i++) {
+    helpers.push_back(submit(runTasks));
+  }
+
+  runTasks();
+
+  for (auto &helper : helpers) {
+    helper.get();
+  }
+}
+
+void VlknThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock{queueMutex};
+      queueCondition.wait(lock,
+                          [this]() { return stopping || !tasks.empty(); });
+
+      if (stopping && tasks.empty()) {
+        return;
+      }
+
+      task = std::move(tasks.front());
+      tasks.pop();
+    }
+
+    task();
+  }
+}
+
+} // namespace vlkn
@@ -0,0 +1,63 @@
+#pragma once
+
+// std
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace vlkn {
+
+class VlknThreadPool {
+public:
+  VlknThreadPool(std::uint32_t threadCount = defaultThreadCount());
+  ~VlknThreadPool();
+
+  VlknThreadPool(const VlknThreadPool &) = delete;
+  VlknThreadPool &operator=(const VlknThreadPool &) = delete;
+
+  static std::uint32_t defaultThreadCount();
+
+  std::uint32_t getThreadCount() const {
+    return static_cast<std::uint32_t>(workers.size());
+  }
+
+  template <typename F> auto submit(F &&task) {
+    using Result = std::invoke_result_t<std::decay_t<F>>;
+
+    auto packagedTask = std::make_shared<std::packaged_task<Result()>>(
+        std::forward<F>(task));
+    std::future<Result> result = packagedTask->get_future();
+
+    {
+      std::lock_guard<std::mutex> lock{queueMutex};
+      tasks.emplace([packagedTask]() { (*packagedTask)(); });
+    }
+    queueCondition.notify_one();
+
+    return result;
+  }
+
+  // Runs task(i) for every i in [0, count) and blocks until all are done.
+  // The calling thread takes part in the work, so this must not be called
+  // from inside a pool task.
+  void parallelFor(std::uint32_t count,
+                   const std::function<void(std::uint32_t)> &task);
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> tasks;
+  std::mutex queueMutex;
+  std::condition_variable queueCondition;
+  bool stopping = false;
+};
+
+} // namespace vlkn
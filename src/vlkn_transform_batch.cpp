@@ -0,0 +1,152 @@
+// header
+#include "vlkn_transform_batch.hpp"
+
+// libs
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// std
+#include <algorithm>
+
+namespace vlkn {
+
+void VlknTransformBatch::add(TransformComponent &transform) {
+  if (transform.isDirty() && !transform.hasParent()) {
+    transforms.push_back(&transform);
+  }
+}
+
+void VlknTransformBatch::update(VlknRegistry &registry) {
+  for (TransformComponent &transform :
+       registry.getComponents<TransformComponent>()) {
+    add(transform);
+  }
+
+  update();
+}
+
+void VlknTransformBatch::update() {
+#if defined(__SSE2__)
+  gather();
+
+  for (std::uint32_t first = 0; first < transforms.size(); first += LANES) {
+    computeLanes(first);
+  }
+#else
+  for (TransformComponent *transform : transforms) {
+    transform->updateMatrices();
+  }
+#endif
+
+  transforms.clear();
+}
+
+#if defined(__SSE2__)
+
+void VlknTransformBatch::gather() {
+  const std::uint32_t count = static_cast<std::uint32_t>(transforms.size());
+  paddedCount = (count + LANES - 1) / LANES * LANES;
+
+  // Padding lanes hold the identity transform so the inverse scale stays
+  // finite
+  inputs.assign(INPUT_COUNT * paddedCount, 0.0f);
+  std::fill_n(inputs.begin() + SX * paddedCount, 3 * paddedCount, 1.0f);
+  std::fill_n(inputs.begin() + QW * paddedCount, paddedCount, 1.0f);
+
+  float *stream = inputs.data();
+  for (std::uint32_t i = 0; i < count; i++) {
+    const TransformComponent &transform = *transforms[i];
+
+    stream[TX * paddedCount + i] = transform.translation.x;
+    stream[TY * paddedCount + i] = transform.translation.y;
+    stream[TZ * paddedCount + i] = transform.translation.z;
+    stream[SX * paddedCount + i] = transform.scale.x;
+    stream[SY * paddedCount + i] = transform.scale.y;
+    stream[SZ * paddedCount + i] = transform.scale.z;
+    stream[QX * paddedCount + i] = transform.rotation.x;
+    stream[QY * paddedCount + i] = transform.rotation.y;
+    stream[QZ * paddedCount + i] = transform.rotation.z;
+    stream[QW * paddedCount + i] = transform.rotation.w;
+  }
+}
+
+void VlknTransformBatch::computeLanes(std::uint32_t first) {
+  const float *stream = inputs.data() + first;
+  auto load = [&](Input input) {
+    return _mm_loadu_ps(stream + input * paddedCount);
+  };
+
+  const __m128 tx = load(TX), ty = load(TY), tz = load(TZ);
+  const __m128 sx = load(SX), sy = load(SY), sz = load(SZ);
+  const __m128 qx = load(QX), qy = load(QY), qz = load(QZ), qw = load(QW);
+
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+
+  const __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy);
+  const __m128 zz = _mm_mul_ps(qz, qz), xy = _mm_mul_ps(qx, qy);
+  const __m128 xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+  const __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy);
+  const __m128 wz = _mm_mul_ps(qw, qz);
+
+  // Rotation matrix of a unit quaternion, r[column][row] as in glm
+  __m128 r[3][3];
+  r[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+  r[0][1] = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+  r[0][2] = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+  r[1][0] = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+  r[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+  r[1][2] = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+  r[2][0] = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+  r[2][1] = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+  r[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+  const __m128 s[3] = {sx, sy, sz};
+  const __m128 inverseScale[3] = {_mm_div_ps(one, sx), _mm_div_ps(one, sy),
+                                  _mm_div_ps(one, sz)};
+
+  // Same math as TransformComponent::updateMatrices, four lanes at a time
+  alignas(16) float world[4][3][LANES];
+  alignas(16) float normal[3][3][LANES];
+
+  for (int row = 0; row < 3; row++) {
+    for (int column = 0; column < 3; column++) {
+      _mm_store_ps(world[column][row], _mm_mul_ps(s[row], r[column][row]));
+      _mm_store_ps(normal[column][row],
+                   _mm_mul_ps(inverseScale[row], r[column][row]));
+    }
+
+    const __m128 rotatedTranslation =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0][row], tx),
+                              _mm_mul_ps(r[1][row], ty)),
+                   _mm_mul_ps(r[2][row], tz));
+    _mm_store_ps(world[3][row], _mm_mul_ps(s[row], rotatedTranslation));
+  }
+
+  const std::uint32_t laneCount = std::min<std::uint32_t>(
+      LANES, static_cast<std::uint32_t>(transforms.size()) - first);
+
+  for (std::uint32_t lane = 0; lane < laneCount; lane++) {
+    TransformComponent &transform = *transforms[first + lane];
+
+    for (int column = 0; column < 4; column++) {
+      transform.worldMatrix[column] =
+          glm::vec4(world[column][0][lane], world[column][1][lane],
+                    world[column][2][lane], column == 3 ? 1.0f : 0.0f);
+    }
+
+    for (int column = 0; column < 3; column++) {
+      transform.normalMat[column] =
+          glm::vec3(normal[column][0][lane], normal[column][1][lane],
+                    normal[column][2][lane]);
+    }
+
+    transform.version++;
+    transform.dirty = false;
+  }
+}
+
+#endif
+
+} // namespace vlkn
@@ -0,0 +1,61 @@
+#pragma once
+
+// local
+#include "vlkn_components.hpp"
+#include "vlkn_registry.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace vlkn {
+
+// Refreshes the cached matrices of dirty transforms in bulk. Inputs are
+// gathered into structure of arrays form so four transforms are computed per
+// SSE instruction, then the results are scattered back to the components.
+class VlknTransformBatch {
+public:
+  static constexpr std::uint32_t LANES = 4;
+
+  VlknTransformBatch() = default;
+
+  VlknTransformBatch(const VlknTransformBatch &) = delete;
+  VlknTransformBatch &operator=(const VlknTransformBatch &) = delete;
+
+  // Queues the transform if it is a dirty root. Parented transforms are left
+  // to VlknTransformHierarchy. It must stay alive until update().
+  void add(TransformComponent &transform);
+
+  // Updates every queued transform and clears the queue
+  void update();
+
+  // Queues and updates every transform in the registry
+  void update(VlknRegistry &registry);
+
+private:
+  enum Input : std::uint32_t {
+    TX,
+    TY,
+    TZ,
+    SX,
+    SY,
+    SZ,
+    QX,
+    QY,
+    QZ,
+    QW,
+    INPUT_COUNT,
+  };
+
+  void gather();
+  void computeLanes(std::uint32_t first);
+
+  std::vector<TransformComponent *> transforms{};
+
+  // INPUT_COUNT streams of paddedCount floats each
+  std::vector<float> inputs{};
+  std::uint32_t paddedCount = 0;
+};
+
+} // namespace vlkn
@@ -0,0 +1,162 @@
+// header
+#include "vlkn_transform_hierarchy.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+namespace vlkn {
+
+void VlknTransformHierarchy::setParent(VlknRegistry &registry, Entity child,
+                                       Entity parent) {
+  assert(registry.has<TransformComponent>(child) &&
+         "Child entity needs a transform");
+  assert((parent == NULL_ENTITY || registry.has<TransformComponent>(parent)) &&
+         "Parent entity needs a transform");
+  assert(child != parent && "Entity cannot be its own parent");
+  assert((parent == NULL_ENTITY || !isDescendant(parent, child)) &&
+         "Parenting would create a cycle");
+
+  if (child.index >= links.size()) {
+    links.resize(child.index + 1);
+  }
+
+  links[child.index] = Link{child, parent};
+  linksChanged = true;
+
+  if (parent == NULL_ENTITY) {
+    registry.get<TransformComponent>(child).clearParent();
+  }
+}
+
+Entity VlknTransformHierarchy::getParent(Entity child) const {
+  if (child.index >= links.size() || links[child.index].child != child) {
+    return NULL_ENTITY;
+  }
+  return links[child.index].parent;
+}
+
+bool VlknTransformHierarchy::isDescendant(Entity entity,
+                                          Entity ancestor) const {
+  for (Entity parent = getParent(entity); parent != NULL_ENTITY;
+       parent = getParent(parent)) {
+    if (parent == ancestor) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void VlknTransformHierarchy::update(VlknRegistry &registry) {
+  if (linksChanged || hasDeadNodes(registry)) {
+    rebuildNodes(registry);
+    linksChanged = false;
+  }
+
+  const std::size_t nodeCount = nodeEntities.size();
+
+  nodeTransforms.resize(nodeCount);
+  for (std::size_t i = 0; i < nodeCount; i++) {
+    nodeTransforms[i] = &registry.get<TransformComponent>(nodeEntities[i]);
+  }
+
+  // Parents are always visited first, so their world matrices are final by
+  // the time their children read them
+  for (std::size_t i = 0; i < nodeCount; i++) {
+    TransformComponent &transform = *nodeTransforms[i];
+
+    if (nodeParents[i] != NO_PARENT) {
+      TransformComponent &parent = *nodeTransforms[nodeParents[i]];
+
+      if (parent.getVersion() != nodeParentVersions[i]) {
+        transform.setParentMatrices(parent.mat4(), parent.normalMatrix());
+        nodeParentVersions[i] = parent.getVersion();
+      }
+    }
+
+    if (transform.isDirty()) {
+      transform.updateMatrices();
+    }
+  }
+}
+
+bool VlknTransformHierarchy::hasDeadNodes(const VlknRegistry &registry) const {
+  return std::any_of(nodeEntities.begin(), nodeEntities.end(),
+                     [&](Entity entity) { return !registry.isAlive(entity); });
+}
+
+void VlknTransformHierarchy::rebuildNodes(VlknRegistry &registry) {
+  // Drop links whose child is gone, roots whose parent is gone become
+  // unparented
+  for (Link &link : links) {
+    if (link.parent == NULL_ENTITY) {
+      continue;
+    }
+
+    if (!registry.isAlive(link.child)) {
+      link = Link{};
+    } else if (!registry.isAlive(link.parent)) {
+      registry.get<TransformComponent>(link.child).clearParent();
+      link = Link{};
+    }
+  }
+
+  // Depth of every linked entity, roots of the hierarchy have depth zero
+  constexpr std::uint32_t UNKNOWN = Entity::INVALID_INDEX;
+  std::vector<std::uint32_t> depths(links.size(), UNKNOWN);
+  std::vector<Entity> entities{};
+  std::uint32_t maxDepth = 0;
+
+  auto depthOf = [&](auto &self, Entity entity) -> std::uint32_t {
+    if (entity.index >= depths.size()) {
+      depths.resize(entity.index + 1, UNKNOWN);
+    }
+    if (depths[entity.index] != UNKNOWN) {
+      return depths[entity.index];
+    }
+
+    Entity parent = getParent(entity);
+    std::uint32_t depth = parent == NULL_ENTITY ? 0 : self(self, parent) + 1;
+
+    depths[entity.index] = depth;
+    entities.push_back(entity);
+    maxDepth = std::max(maxDepth, depth);
+    return depth;
+  };
+
+  for (const Link &link : links) {
+    if (link.parent != NULL_ENTITY) {
+      depthOf(depthOf, link.child);
+    }
+  }
+
+  // Counting sort by depth
+  std::vector<std::uint32_t> offsets(maxDepth + 2, 0);
+  for (Entity entity : entities) {
+    offsets[depths[entity.index] + 1]++;
+  }
+  for (std::uint32_t depth = 1; depth < offsets.size(); depth++) {
+    offsets[depth] += offsets[depth - 1];
+  }
+
+  nodeEntities.assign(entities.size(), NULL_ENTITY);
+  std::vector<std::uint32_t> nodeOfEntity(depths.size(), NO_PARENT);
+  for (Entity entity : entities) {
+    std::uint32_t node = offsets[depths[entity.index]]++;
+    nodeEntities[node] = entity;
+    nodeOfEntity[entity.index] = node;
+  }
+
+  nodeParents.resize(nodeEntities.size());
+  for (std::size_t i = 0; i < nodeEntities.size(); i++) {
+    Entity parent = getParent(nodeEntities[i]);
+    nodeParents[i] =
+        parent == NULL_ENTITY ? NO_PARENT : nodeOfEntity[parent.index];
+  }
+
+  // Versions start at zero and a computed transform is at least one, so
+  // every child picks up its parent's matrices on the next pass
+  nodeParentVersions.assign(nodeEntities.size(), 0);
+}
+
+} // namespace vlkn
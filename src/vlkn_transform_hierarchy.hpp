@@ -0,0 +1,60 @@
+#pragma once
+
+// local
+#include "vlkn_components.hpp"
+#include "vlkn_registry.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vlkn {
+
+// Parent/child links between entity transforms. Linked entities are kept in
+// flat arrays sorted by depth, so every parent comes before its children and
+// world matrices propagate in one linear pass. A node is recomputed only when
+// its own transform is dirty or its parent's world matrix changed since the
+// last pass, so moving one root only touches that root's subtree.
+class VlknTransformHierarchy {
+public:
+  static constexpr std::uint32_t NO_PARENT = Entity::INVALID_INDEX;
+
+  VlknTransformHierarchy() = default;
+
+  VlknTransformHierarchy(const VlknTransformHierarchy &) = delete;
+  VlknTransformHierarchy &operator=(const VlknTransformHierarchy &) = delete;
+
+  // Attaches child to parent, or detaches it when parent is NULL_ENTITY.
+  // Both entities need a TransformComponent and parent must not be a
+  // descendant of child.
+  void setParent(VlknRegistry &registry, Entity child, Entity parent);
+
+  Entity getParent(Entity child) const;
+
+  // Rebuilds the node order if links changed or linked entities were
+  // destroyed, then propagates world matrices from the roots down
+  void update(VlknRegistry &registry);
+
+private:
+  struct Link {
+    Entity child = NULL_ENTITY;
+    Entity parent = NULL_ENTITY;
+  };
+
+  bool isDescendant(Entity entity, Entity ancestor) const;
+  bool hasDeadNodes(const VlknRegistry &registry) const;
+  void rebuildNodes(VlknRegistry &registry);
+
+  // Indexed by child entity index, parent is NULL_ENTITY for unlinked ones
+  std::vector<Link> links{};
+  bool linksChanged = false;
+
+  // Depth sorted nodes, parents always precede their children
+  std::vector<Entity> nodeEntities{};
+  std::vector<std::uint32_t> nodeParents{};
+  // Parent version the node's world matrix was last derived from
+  std::vector<std::uint32_t> nodeParentVersions{};
+  std::vector<TransformComponent *> nodeTransforms{};
+};
+
+} // namespace vlkn